@@ -0,0 +1,83 @@
+//------------------------------------------------------------------------------
+// @file bench_jpeg.cc
+//------------------------------------------------------------------------------
+// JPEG decode 속도 측정. STBI_JPEG_FAST_HUFFMAN 유무로 두 번 build 하여
+// 비교한다. (make bench)
+// image.jpeg 를 4000x3000 으로 확대하고 noise 를 더해 q75, q95 로 encode 한 뒤
+// 단일 thread 로 decode 한다. 두 build 의 checksum 은 같아야 한다.
+//------------------------------------------------------------------------------
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_STATIC
+#include "stb_image.h"
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#define STB_IMAGE_WRITE_STATIC
+#include "stb_image_write.h"
+
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#define STB_IMAGE_RESIZE_STATIC
+#include "stb_image_resize.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+static void write_func(void* context, void* data, int size) {
+  auto* buffer = static_cast<std::vector<uint8_t>*>(context);
+  auto* p = static_cast<uint8_t*>(data);
+  buffer->insert(buffer->end(), p, p + size);
+}
+
+int main() {
+  const int h = 3000, w = 4000, c = 3;
+  int in_w, in_h, in_c;
+  uint8_t* org = stbi_load("./image.jpeg", &in_w, &in_h, &in_c, c);
+  if (!org) {
+    std::cout << "can't load ./image.jpeg" << std::endl;
+    return 1;
+  }
+  std::vector<uint8_t> pixels(static_cast<size_t>(h) * w * c);
+  stbir_resize_uint8(org, in_w, in_h, 0, pixels.data(), w, h, 0, c);
+  stbi_image_free(org);
+  // 확대한 이미지는 고주파 성분이 거의 없으므로 사진의 질감 대신 noise 를 더한다.
+  uint32_t seed = 1;
+  for (auto& v : pixels) {
+    seed = seed * 1664525u + 1013904223u;
+    v = static_cast<uint8_t>(std::min(255, std::max(0, v + int(seed >> 28) - 8)));
+  }
+
+#ifdef STBI_JPEG_FAST_HUFFMAN
+  std::cout << "fast huffman" << std::endl;
+#else
+  std::cout << "base huffman" << std::endl;
+#endif
+  for (int quality : {75, 95}) {
+    std::vector<uint8_t> jpg;
+    stbi_write_jpg_to_func(write_func, &jpg, w, h, c, pixels.data(), quality);
+
+    double best = 1e9;
+    uint64_t checksum = 0;
+    for (int i=0; i<5; i++) {
+      int x, y, n;
+      auto t0 = std::chrono::steady_clock::now();
+      uint8_t* out = stbi_load_from_memory(jpg.data(), static_cast<int>(jpg.size()),
+                                           &x, &y, &n, c);
+      auto t1 = std::chrono::steady_clock::now();
+      if (!out) {
+        std::cout << "decode failed: " << stbi_failure_reason() << std::endl;
+        return 1;
+      }
+      best = std::min(best, std::chrono::duration<double, std::milli>(t1 - t0).count());
+      checksum = 1469598103934665603ull;
+      for (size_t k=0; k<static_cast<size_t>(x) * y * c; k++)
+        checksum = (checksum ^ out[k]) * 1099511628211ull;
+      stbi_image_free(out);
+    }
+    std::cout << "q" << quality << " " << jpg.size() / 1024 << "KB: "
+              << best << " ms (" << jpg.size() / best / 1000.0 << " MB/s)"
+              << " checksum " << std::hex << checksum << std::dec << std::endl;
+  }
+  return 0;
+}
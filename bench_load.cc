@@ -0,0 +1,115 @@
+//------------------------------------------------------------------------------
+// @file bench_load.cc
+//------------------------------------------------------------------------------
+// 입력 경로별 load 속도 측정. (make bench)
+// 같은 JPEG, PNG 파일을 memory, 파일 이름 (mmap), fread, std::istream,
+// file descriptor 로 load 하고, stream 과 fd 는 read buffer 크기를 바꿔가며
+// 비교한다.
+// 128 byte 는 stb_image 의 기본 buffer 크기이다.
+//------------------------------------------------------------------------------
+#include "image.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace sas;
+
+static double best_ms(const std::function<bool()>& fn) {
+  double best = 1e9;
+  for (int i=0; i<5; i++) {
+    auto t0 = std::chrono::steady_clock::now();
+    if (!fn())
+      return -1.0;
+    auto t1 = std::chrono::steady_clock::now();
+    best = std::min(best, std::chrono::duration<double, std::milli>(t1 - t0).count());
+  }
+  return best;
+}
+
+static void report(const std::string& name, double ms) {
+  std::cout << "  " << name << ": ";
+  if (ms < 0)
+    std::cout << "failed" << std::endl;
+  else
+    std::cout << ms << " ms" << std::endl;
+}
+
+int main() {
+  const int h = 3000, w = 4000;
+  Image src("./image.jpeg");
+  if (src.empty()) {
+    std::cout << "can't load ./image.jpeg" << std::endl;
+    return 1;
+  }
+  src.resize(h, w);
+  // 확대한 이미지는 고주파 성분이 거의 없으므로 사진의 질감 대신 noise 를 더한다.
+  uint32_t seed = 1;
+  for (size_t i=0; i<src.size(); i++) {
+    seed = seed * 1664525u + 1013904223u;
+    int v = src.get()[i] + int(seed >> 29) - 4;
+    src.get()[i] = static_cast<uint8_t>(std::min(255, std::max(0, v)));
+  }
+
+  for (std::string path : {"bench_load.jpg", "bench_load.png"}) {
+    bool saved = path.back() == 'g' && path[path.size() - 2] == 'p'
+        ? src.saveJpg(path) : src.savePng(path);
+    if (!saved) {
+      std::cout << "can't save " << path << std::endl;
+      return 1;
+    }
+    std::ifstream file(path, std::ios::binary);
+    std::vector<uint8_t> raw((std::istreambuf_iterator<char>(file)),
+                             std::istreambuf_iterator<char>());
+    std::cout << path << " " << raw.size() / 1024 << "KB" << std::endl;
+
+    report("memory", best_ms([&] {
+      Image img;
+      return img.load(raw);
+    }));
+    report("file", best_ms([&] {
+      Image img;
+      return img.load(path);
+    }));
+    // 파일 전체를 fread 한 뒤 memory 에서 decode. (mmap 을 쓰기 전의 방식)
+    report("fread", best_ms([&] {
+      std::unique_ptr<FILE, decltype(&fclose)> f(fopen(path.c_str(), "rb"),
+                                                 &fclose);
+      if (!f)
+        return false;
+      std::vector<uint8_t> buf(raw.size());
+      if (fread(buf.data(), 1, buf.size(), f.get()) != buf.size())
+        return false;
+      Image img;
+      return img.load(buf);
+    }));
+    for (size_t buffer : {size_t(128), size_t(64 * 1024), size_t(1024 * 1024)}) {
+      report("istream " + std::to_string(buffer) + "B", best_ms([&] {
+        std::ifstream stream(path, std::ios::binary);
+        Image img;
+        return img.load(stream, 3, nullptr, buffer);
+      }));
+      report("fd " + std::to_string(buffer) + "B", best_ms([&] {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        Image img;
+        bool ok = fd >= 0 && img.loadFd(fd, 3, nullptr, buffer);
+        if (fd >= 0)
+          ::close(fd);
+        return ok;
+      }));
+    }
+    std::remove(path.c_str());
+  }
+  return 0;
+}
@@ -0,0 +1,56 @@
+//------------------------------------------------------------------------------
+// @file cancel.cc
+//------------------------------------------------------------------------------
+#include "cancel.h"
+#include <limits>
+
+namespace sas {
+
+static const int64_t kNoDeadline = std::numeric_limits<int64_t>::max();
+
+//------------------------------------------------------------------------------
+// Clock 의 시각을 ns 정수로 변환한다.
+//------------------------------------------------------------------------------
+static int64_t to_ns(CancelToken::Clock::time_point t) {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+      t.time_since_epoch()).count();
+}
+
+CancelToken::CancelToken() : cancelled_{false}, deadline_{kNoDeadline} {
+}
+
+CancelToken::CancelToken(Clock::duration timeout)
+    : cancelled_{false}, deadline_{to_ns(Clock::now() + timeout)} {
+}
+
+void CancelToken::cancel() {
+  cancelled_.store(true);
+}
+
+void CancelToken::setDeadline(Clock::time_point deadline) {
+  deadline_.store(to_ns(deadline));
+}
+
+void CancelToken::setTimeout(Clock::duration timeout) {
+  setDeadline(Clock::now() + timeout);
+}
+
+void CancelToken::reset() {
+  deadline_.store(kNoDeadline);
+  cancelled_.store(false);
+}
+
+//------------------------------------------------------------------------------
+// deadline 이 지난 것을 한 번 확인하면 이후에는 시각을 읽지 않는다.
+//------------------------------------------------------------------------------
+bool CancelToken::cancelled() const {
+  if (cancelled_.load(std::memory_order_relaxed))
+    return true;
+  auto deadline = deadline_.load(std::memory_order_relaxed);
+  if (deadline == kNoDeadline || to_ns(Clock::now()) < deadline)
+    return false;
+  cancelled_.store(true, std::memory_order_relaxed);
+  return true;
+}
+
+}  // namespace sas
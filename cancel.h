@@ -0,0 +1,51 @@
+//------------------------------------------------------------------------------
+// @file util/cancel.h
+//------------------------------------------------------------------------------
+#ifndef SAS_CATEGORY_UTIL_CANCEL_H_
+#define SAS_CATEGORY_UTIL_CANCEL_H_
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace sas {
+
+//------------------------------------------------------------------------------
+// @class CancelToken
+//------------------------------------------------------------------------------
+// resize, decode, encode 처럼 오래 걸리는 작업의 중단 요청.
+// 다른 thread 에서 cancel() 하거나 deadline 이 지나면, 작업은 다음 row
+// (JPEG decode 는 MCU row) 경계에서 멈추고 사용하던 buffer 를 해제한 뒤
+// false 를 반환한다. 여러 작업과 thread 가 같은 token 을 공유할 수 있다.
+//------------------------------------------------------------------------------
+class CancelToken {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+ private:
+  mutable std::atomic<bool> cancelled_;
+  std::atomic<int64_t> deadline_;  // Clock 기준 ns. 없으면 INT64_MAX.
+
+ public:
+  CancelToken();
+  // 지금부터 timeout 이 지나면 취소된다.
+  explicit CancelToken(Clock::duration timeout);
+  CancelToken(const CancelToken&) = delete;
+  CancelToken& operator=(const CancelToken&) = delete;
+
+  void cancel();
+  void setDeadline(Clock::time_point deadline);
+  void setTimeout(Clock::duration timeout);
+  // 취소 상태와 deadline 을 지운다.
+  void reset();
+
+  // cancel() 되었거나 deadline 이 지났으면 true.
+  bool cancelled() const;
+};
+
+// token 이 nullptr 이면 false.
+inline bool isCancelled(const CancelToken* token) {
+  return token && token->cancelled();
+}
+
+}  // namespace sas
+#endif  // SAS_CATEGORY_UTIL_CANCEL_H_
@@ -2,11 +2,74 @@
 // @file image.cc
 //------------------------------------------------------------------------------
 #include "image.h"
+#include "thread_pool.h"
 #include <cassert>
 #include <vector>
 #include <sstream>
 #include <algorithm>
 #include <limits>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <atomic>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/vfs.h>
+#endif
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+//------------------------------------------------------------------------------
+// stb 의 decode/encode loop 가 확인하는 현재 thread 의 CancelToken.
+// Image::load / save 동안만 설정된다. (StbCancelScope)
+//------------------------------------------------------------------------------
+namespace sas {
+static thread_local const CancelToken* stb_cancel = nullptr;
+static bool stb_cancelled() {
+  return isCancelled(stb_cancel);
+}
+
+static const char* stb_failure_reason();
+static void stb_set_failure_reason(const char* reason);
+
+//------------------------------------------------------------------------------
+// stb_image 의 병렬 구간 (JPEG restart interval decode, 출력 row 변환) 을
+// ThreadPool 에서 실행한다. 호출 thread 의 CancelToken 을 worker 에도 설정한다.
+// stb 의 failure reason 은 thread 별이므로 task 에서 생긴 reason 을 호출
+// thread 로 옮긴다.
+//------------------------------------------------------------------------------
+static void stb_parallel_for(int n, void (*fn)(void*, int), void* user) {
+  const CancelToken* cancel = stb_cancel;
+  std::atomic<const char*> failure{nullptr};
+  ThreadPool::instance().parallelFor(n, [&](int i) {
+    const CancelToken* prev = stb_cancel;
+    const char* prev_reason = stb_failure_reason();
+    stb_cancel = cancel;
+    stb_set_failure_reason(nullptr);
+    fn(user, i);
+    const char* reason = stb_failure_reason();
+    if (reason)
+      failure.store(reason);
+    stb_set_failure_reason(prev_reason);
+    stb_cancel = prev;
+  });
+  if (failure.load())
+    stb_set_failure_reason(failure.load());
+}
+}  // namespace sas
+#define STBI_CANCELLED() ::sas::stb_cancelled()
+#define STBIW_CANCELLED() ::sas::stb_cancelled()
+#define STBI_PARALLEL_FOR(n, fn, user) ::sas::stb_parallel_for(n, fn, user)
 
 //------------------------------------------------------------------------------
 // stb module. (don't use this in header but source)
@@ -16,11 +79,6 @@
 #define STB_IMAGE_INLINE
 #include "stb_image.h"
 
-#define STB_IMAGE_RESIZE_IMPLEMENTATION
-#define STB_IMAGE_RESIZE_STATIC
-#define STB_IMAGE_RESIZE_INLINE
-#include "stb_image_resize.h"
-
 #define STB_IMAGE_WRITE_IMPLEMENTATION
 #define STB_IMAGE_WRITE_STATIC
 #define STB_IMAGE_WRITE_INLINE
@@ -28,29 +86,42 @@
 
 namespace sas {
 
+//------------------------------------------------------------------------------
+// 현재 thread 의 stb failure reason.
+//------------------------------------------------------------------------------
+static const char* stb_failure_reason() {
+  return stbi__g_failure_reason;
+}
+
+static void stb_set_failure_reason(const char* reason) {
+  stbi__g_failure_reason = reason;
+}
+
 //------------------------------------------------------------------------------
 // invalid 한 base 이미지 객체를 생성한다.
 //------------------------------------------------------------------------------
-Image::Image() : h_{0}, w_{0}, c_{0}, pdata_(nullptr) {
+Image::Image() : h_{0}, w_{0}, c_{0}, pdata_(nullptr), capacity_{0} {
 }
 
 //------------------------------------------------------------------------------
 // (h, w, c) 크기의 이미지를 생성한다. 빈 이미지가 생성된다.
 //------------------------------------------------------------------------------
 Image::Image(int h, int w, int c)
-    : h_{h}, w_{w}, c_{c}, pdata_(nullptr) {
+    : h_{h}, w_{w}, c_{c}, pdata_(nullptr), capacity_{0} {
   assert((h_>0) && (w_>0) && (c_>0));
   assert(size() > 0);
   pdata_.reset(new uint8_t[size()], std::default_delete<uint8_t[]>());
+  capacity_ = size();
 }
 
 //------------------------------------------------------------------------------
 // (h, w, c) 데이터에 초기값을 pxl 로 설정하여 생성.
 //------------------------------------------------------------------------------
 Image::Image(int h, int w, int c, uint8_t pxl)
-    : h_{h}, w_{w}, c_{c}, pdata_(nullptr) {
+    : h_{h}, w_{w}, c_{c}, pdata_(nullptr), capacity_{0} {
   assert((h_>0) && (w_>0) && (c_>0));
   pdata_.reset(new uint8_t[size()], std::default_delete<uint8_t[]>());
+  capacity_ = size();
   for (decltype(size()) i=0; i<size(); i++)
     pdata_.get()[i] = pxl;
 }
@@ -59,10 +130,11 @@ Image::Image(int h, int w, int c, uint8_t pxl)
 // 데이터를 복사하여 생성.
 //------------------------------------------------------------------------------
 Image::Image(int h, int w, int c, const std::vector<uint8_t>& data)
-    : h_{h}, w_{w}, c_{c}, pdata_(nullptr) {
+    : h_{h}, w_{w}, c_{c}, pdata_(nullptr), capacity_{0} {
   assert((h_>0) && (w_>0) && (c_>0));
   assert(size() == data.size());
   pdata_.reset(new uint8_t[size()], std::default_delete<uint8_t[]>());
+  capacity_ = size();
   // data copy
   for (decltype(size()) i=0; i<size(); i++)
     pdata_.get()[i] = data[i];
@@ -72,10 +144,11 @@ Image::Image(int h, int w, int c, const std::vector<uint8_t>& data)
 // 데이터를 복사하여 생성.
 //------------------------------------------------------------------------------
 Image::Image(int h, int w, int c, const uint8_t* pdata)
-    : h_{h}, w_{w}, c_{c}, pdata_(nullptr){
+    : h_{h}, w_{w}, c_{c}, pdata_(nullptr), capacity_{0} {
   assert((h_>0) && (w_>0) && (c_>0));
   assert(pdata);
   pdata_.reset(new uint8_t[size()], std::default_delete<uint8_t[]>());
+  capacity_ = size();
   // data copy (주의깊게 사용할 필요 있음. overflow 문제)
   for (decltype(size()) i=0; i<size(); i++)
     pdata_.get()[i] = pdata[i];
@@ -85,7 +158,7 @@ Image::Image(int h, int w, int c, const uint8_t* pdata)
 // 데이터를 share 하여 생성.
 //------------------------------------------------------------------------------
 Image::Image(int h, int w, int c, std::shared_ptr<uint8_t> pdata)
-    : h_{h}, w_{w}, c_{c}, pdata_(pdata) {
+    : h_{h}, w_{w}, c_{c}, pdata_(pdata), capacity_{size()} {
   assert((h_>0) && (w_>0) && (c_>0));
   assert(pdata);
 }
@@ -94,7 +167,7 @@ Image::Image(int h, int w, int c, std::shared_ptr<uint8_t> pdata)
 // 파일에서 이미지 로드.
 //------------------------------------------------------------------------------
 Image::Image(const std::string& filename)
-    : h_{0}, w_{0}, c_{0}, pdata_(nullptr) {
+    : h_{0}, w_{0}, c_{0}, pdata_(nullptr), capacity_{0} {
   load(filename);
 }
 
@@ -102,9 +175,11 @@ Image::Image(const std::string& filename)
 // 복사 생성자.
 //------------------------------------------------------------------------------
 Image::Image(const Image& image)
-    : h_{image.h_}, w_{image.w_}, c_{image.c_}, pdata_(nullptr) {
+    : h_{image.h_}, w_{image.w_}, c_{image.c_}, pdata_(nullptr),
+      capacity_{0} {
   if (!image.empty()) {
     pdata_.reset(new uint8_t[size()], std::default_delete<uint8_t[]>());
+    capacity_ = size();
     for (decltype(size()) i=0; i<size(); i++)
       pdata_.get()[i] = image.pdata_.get()[i];
   }
@@ -113,7 +188,8 @@ Image::Image(const Image& image)
 //------------------------------------------------------------------------------
 // 이동 생성자.
 //------------------------------------------------------------------------------
-Image::Image(Image&& image) : h_{0}, w_{0}, c_{0}, pdata_(nullptr) {
+Image::Image(Image&& image)
+    : h_{0}, w_{0}, c_{0}, pdata_(nullptr), capacity_{0} {
   swap(image);
   image.clear();
 }
@@ -134,6 +210,7 @@ Image& Image::operator=(const Image& image) {
     c_ = image.c_;
     if (!image.empty()) {
       pdata_.reset(new uint8_t[size()], std::default_delete<uint8_t[]>());
+      capacity_ = size();
       for (decltype(size()) i=0; i<size(); i++)
         pdata_.get()[i] = image.pdata_.get()[i];
     }
@@ -201,6 +278,7 @@ size_t Image::size() const {
 void Image::clear() {
   w_ = h_ = c_ = 0;
   pdata_.reset();
+  capacity_ = 0;
 }
 
 //------------------------------------------------------------------------------
@@ -281,6 +359,7 @@ void Image::swap(Image& image) {
   std::swap(w_, image.w_);
   std::swap(c_, image.c_);
   pdata_.swap(image.pdata_);
+  std::swap(capacity_, image.capacity_);
 }
 
 //------------------------------------------------------------------------------
@@ -303,22 +382,27 @@ bool Image::isSameSize(const Image& image) const {
 //------------------------------------------------------------------------------
 // 새로운 크기로 이미지를 변환한다.
 //------------------------------------------------------------------------------
-void Image::resize(int new_h, int new_w) {
+bool Image::resize(int new_h, int new_w, const ResizeOptions& options,
+                   const CancelToken* cancel) {
   assert(new_h > 0);
   assert(new_w > 0);
   if ((new_h == h_) && (new_w == w_))
-    return;
+    return true;
   Image image(new_h, new_w, c_);
 
-  ::stbir_resize_uint8(pdata_.get(), w_, h_, w_*c_,
-                       image.pdata_.get(), new_w, new_h, new_w*c_, c_);
+  if (!resizeUint8(pdata_.get(), h_, w_, w_*c_,
+                   image.pdata_.get(), new_h, new_w, new_w*c_, c_,
+                   options, cancel))
+    return false;
   swap(image);
+  return true;
 }
 
 //------------------------------------------------------------------------------
 // 현재 이미지를 target 이미지에 resize 하여 전송. target 크기는 고정.
 //------------------------------------------------------------------------------
-bool Image::resizeTo(Image* target) const {
+bool Image::resizeTo(Image* target, const ResizeOptions& options,
+                     const CancelToken* cancel) const {
   if ((!target) || target->empty()) {
     return false;
   }
@@ -329,45 +413,53 @@ bool Image::resizeTo(Image* target) const {
   if (c != c_)
     return false;
   assert(target->pdata_);
-  ::stbir_resize_uint8(pdata_.get(), w_, h_, w_*c_,
-                       target->pdata_.get(), w, h, w*c, c);
-  return true;
+  return resizeUint8(pdata_.get(), h_, w_, w_*c_,
+                     target->pdata_.get(), h, w, w*c, c, options, cancel);
 }
 
 //------------------------------------------------------------------------------
 // height 크기를 변경. (resize)
 //------------------------------------------------------------------------------
-void Image::resizeHeight(int new_h) {
+bool Image::resizeHeight(int new_h, const ResizeOptions& options,
+                         const CancelToken* cancel) {
   assert(new_h > 0);
   if (new_h == h_)
-    return;
+    return true;
   if (empty())
-    return;
+    return false;
   Image image(new_h, w_, c_);
-  stbir_resize_uint8(pdata_.get(), w_, h_, w_*c_,
-                     image.pdata_.get(), w_, new_h, w_*c_, c_);
+  if (!resizeUint8(pdata_.get(), h_, w_, w_*c_,
+                   image.pdata_.get(), new_h, w_, w_*c_, c_, options, cancel))
+    return false;
   swap(image);
+  return true;
 }
 
 //------------------------------------------------------------------------------
 // width 크기를 변경. (resize)
 //------------------------------------------------------------------------------
-void Image::resizeWidth(int new_w) {
+bool Image::resizeWidth(int new_w, const ResizeOptions& options,
+                        const CancelToken* cancel) {
   assert(new_w > 0);
   if (new_w == w_)
-    return;
+    return true;
   if (empty())
-    return;
+    return false;
   Image image(h_, new_w, c_);
-  stbir_resize_uint8(pdata_.get(), w_, h_, w_*c_,
-                     image.pdata_.get(), new_w, h_, new_w*c_, c_);
+  if (!resizeUint8(pdata_.get(), h_, w_, w_*c_,
+                   image.pdata_.get(), h_, new_w, new_w*c_, c_,
+                   options, cancel))
+    return false;
   swap(image);
+  return true;
 }
 
 //------------------------------------------------------------------------------
 // h와 hw중 작은 쪽을 기준으로 new_size 크기로 변경한다. (비율 고정)
 //------------------------------------------------------------------------------
-void Image::resizeOnSmallerSide(int new_size) {
+bool Image::resizeOnSmallerSide(int new_size,
+                                const ResizeOptions& options,
+                                const CancelToken* cancel) {
   auto w = w_;
   auto h = h_;
   if (w < h) {
@@ -379,14 +471,16 @@ void Image::resizeOnSmallerSide(int new_size) {
     h = new_size;
   }
   if (h == h_ && w == w_)
-    return;
-  resize(h, w);
+    return true;
+  return resize(h, w, options, cancel);
 }
 
 //------------------------------------------------------------------------------
 // w와 h 중 큰 쪽을 기준으로 new_size 크기로 변경한다. (비율 고정)
 //------------------------------------------------------------------------------
-void Image::resizeOnLargerSide(int new_size) {
+bool Image::resizeOnLargerSide(int new_size,
+                               const ResizeOptions& options,
+                               const CancelToken* cancel) {
   auto h = h_;
   auto w = w_;
   if (w < h) {
@@ -398,8 +492,328 @@ void Image::resizeOnLargerSide(int new_size) {
     w = new_size;
   }
   if (h == h_ && w == w_)
-    return;
-  resize(h, w);
+    return true;
+  return resize(h, w, options, cancel);
+}
+
+//------------------------------------------------------------------------------
+// pyramid level 을 나누는 row band 의 최소 크기. 작은 level 은 한 번에 처리한다.
+//------------------------------------------------------------------------------
+static const int kReduceBandRows = 16;
+
+//------------------------------------------------------------------------------
+// 2x2 box 축소의 한 줄 처리. r0, r1 은 입력의 연속된 두 row 이며
+// 출력 한 pixel 은 입력 2x2 pixel 의 반올림 평균이다.
+// 입력 width 가 1 인 경우를 위해 입력 column 은 in_w-1 에서 clamp 한다.
+//------------------------------------------------------------------------------
+static void reduce_box_row(const uint8_t* r0, const uint8_t* r1, uint8_t* out,
+                           int in_w, int out_w, int c) {
+  int x = 0;
+#ifdef __SSE2__
+  const __m128i two = _mm_set1_epi16(2);
+  const __m128i zero = _mm_setzero_si128();
+  if (c == 1) {
+    // 16 byte 입력 -> 8 byte 출력. 짝수/홀수 byte 를 16bit lane 에서 분리.
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    for (; x + 8 <= out_w && 2 * x + 16 <= in_w; x += 8) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r0 + 2*x));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + 2*x));
+      __m128i s = _mm_add_epi16(_mm_and_si128(a, mask), _mm_srli_epi16(a, 8));
+      s = _mm_add_epi16(s, _mm_and_si128(b, mask));
+      s = _mm_add_epi16(s, _mm_srli_epi16(b, 8));
+      s = _mm_srli_epi16(_mm_add_epi16(s, two), 2);
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x),
+                       _mm_packus_epi16(s, zero));
+    }
+  }
+#ifdef __SSSE3__
+  else if (c == 3) {
+    // 24 byte (8 pixel) 입력 -> 12 byte (4 pixel) 출력.
+    // 출력 한 값의 두 입력 byte 를 이웃하게 모은 뒤 pmaddubsw 로 더한다.
+    // a 는 입력 byte 0 ~ 15, b 는 8 ~ 23 이다.
+    const __m128i lo_a = _mm_setr_epi8(0, 3, 1, 4, 2, 5, 6, 9, 7, 10, 8, 11,
+                                       12, 15, 13, -1);
+    const __m128i lo_b = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1,
+                                       -1, -1, -1, -1, -1, -1, -1, 8);
+    const __m128i hi_b = _mm_setr_epi8(6, 9, 10, 13, 11, 14, 12, 15,
+                                       -1, -1, -1, -1, -1, -1, -1, -1);
+    const __m128i ones = _mm_set1_epi8(1);
+    for (; x + 4 <= out_w && 2 * x + 8 <= in_w; x += 4) {
+      __m128i lo = two, hi = two;
+      for (const uint8_t* r : {r0, r1}) {
+        __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + 6*x));
+        __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r + 6*x + 8));
+        __m128i pairs = _mm_or_si128(_mm_shuffle_epi8(a, lo_a),
+                                     _mm_shuffle_epi8(b, lo_b));
+        lo = _mm_add_epi16(lo, _mm_maddubs_epi16(pairs, ones));
+        hi = _mm_add_epi16(hi, _mm_maddubs_epi16(_mm_shuffle_epi8(b, hi_b),
+                                                 ones));
+      }
+      __m128i v = _mm_packus_epi16(_mm_srli_epi16(lo, 2), _mm_srli_epi16(hi, 2));
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 3*x), v);
+      int32_t tail = _mm_cvtsi128_si32(_mm_srli_si128(v, 8));
+      std::memcpy(out + 3*x + 8, &tail, sizeof(tail));
+    }
+  }
+#endif
+  else if (c == 4) {
+    // 16 byte (4 pixel) 입력 -> 8 byte (2 pixel) 출력.
+    for (; x + 2 <= out_w && 2 * x + 4 <= in_w; x += 2) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r0 + 8*x));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + 8*x));
+      __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero),
+                                 _mm_unpacklo_epi8(b, zero));  // p0, p1
+      __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero),
+                                 _mm_unpackhi_epi8(b, zero));  // p2, p3
+      __m128i s = _mm_add_epi16(_mm_unpacklo_epi64(lo, hi),
+                                _mm_unpackhi_epi64(lo, hi));   // p0+p1, p2+p3
+      s = _mm_srli_epi16(_mm_add_epi16(s, two), 2);
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(out + 4*x),
+                       _mm_packus_epi16(s, zero));
+    }
+  }
+#endif
+  for (; x < out_w; x++) {
+    auto x0 = 2 * x * c;
+    auto x1 = std::min(2 * x + 1, in_w - 1) * c;
+    for (int z=0; z<c; z++) {
+      int v = r0[x0+z] + r0[x1+z] + r1[x0+z] + r1[x1+z];
+      out[x*c+z] = static_cast<uint8_t>((v + 2) >> 2);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// 입력 (in_h, in_w, c) 이미지를 2x box 축소하여 출력 row [y0, y1) 을 기록.
+//------------------------------------------------------------------------------
+static void reduce_box(const uint8_t* in, int in_h, int in_w,
+                       uint8_t* out, int out_w, int c, int y0, int y1) {
+  auto in_stride = static_cast<size_t>(in_w) * c;
+  auto out_stride = static_cast<size_t>(out_w) * c;
+  for (int y=y0; y<y1; y++) {
+    auto r0 = in + (2 * y) * in_stride;
+    auto r1 = in + std::min(2 * y + 1, in_h - 1) * in_stride;
+    reduce_box_row(r0, r1, out + y * out_stride, in_w, out_w, c);
+  }
+}
+
+//------------------------------------------------------------------------------
+// [1 3 3 1] 세로 방향 가중합. col[i] = r[0][i] + 3 (r[1][i] + r[2][i]) + r[3][i]
+//------------------------------------------------------------------------------
+static void reduce_gaussian_col(const uint8_t* const* r, uint16_t* col,
+                                size_t n) {
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= n; i += 16) {
+    __m128i v[4];
+    for (int k=0; k<4; k++)
+      v[k] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r[k] + i));
+    for (int half=0; half<2; half++) {
+      auto widen = [&](__m128i a) {
+        return half ? _mm_unpackhi_epi8(a, zero) : _mm_unpacklo_epi8(a, zero);
+      };
+      __m128i mid = _mm_add_epi16(widen(v[1]), widen(v[2]));
+      __m128i sum = _mm_add_epi16(widen(v[0]), widen(v[3]));
+      sum = _mm_add_epi16(sum, _mm_add_epi16(mid, _mm_add_epi16(mid, mid)));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(col + i + 8 * half), sum);
+    }
+  }
+#endif
+  for (; i < n; i++)
+    col[i] = static_cast<uint16_t>(r[0][i] + 3 * (r[1][i] + r[2][i]) + r[3][i]);
+}
+
+//------------------------------------------------------------------------------
+// col 의 pixel 2x 를 ev[x] 로, pixel 2x+1 을 od[x+1] 로 나눈다. (x < pairs)
+// 이렇게 나누면 가로 방향 [1 3 3 1] 이 같은 위치의 lane 끼리의 연산이 된다.
+// ev, od 는 pixel 두 개 만큼 여유가 있어야 한다.
+//------------------------------------------------------------------------------
+static void split_pixel_pairs(const uint16_t* col, int pairs, int c,
+                              uint16_t* ev, uint16_t* od) {
+  int x = 0;
+#ifdef __SSE2__
+  if (c == 1) {
+    const __m128i mask = _mm_set1_epi32(0xFFFF);
+    for (; x + 8 <= pairs; x += 8) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(col + 2*x));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(col + 2*x + 8));
+      // 값은 255 * 8 이하이므로 signed pack 으로 충분하다.
+      __m128i e = _mm_packs_epi32(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+      __m128i o = _mm_packs_epi32(_mm_srli_epi32(a, 16), _mm_srli_epi32(b, 16));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(ev + x), e);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(od + x + 1), o);
+    }
+  }
+#ifdef __SSSE3__
+  else if (c == 3) {
+    // pixel 4 개 (12 lane) 씩. a 는 lane 0 ~ 7, b 는 lane 4 ~ 11 이다.
+    // 저장하는 8 lane 중 마지막 2 lane 은 다음 pixel 자리이며 나중에 다시 쓴다.
+    const __m128i ev_a = _mm_setr_epi8(0, 1, 2, 3, 4, 5, -1, -1, -1, -1, -1, -1,
+                                       -1, -1, -1, -1);
+    const __m128i ev_b = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 4, 5, 6, 7, 8, 9,
+                                       -1, -1, -1, -1);
+    const __m128i od_a = _mm_setr_epi8(6, 7, 8, 9, 10, 11, -1, -1, -1, -1, -1, -1,
+                                       -1, -1, -1, -1);
+    const __m128i od_b = _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 10, 11, 12, 13,
+                                       14, 15, -1, -1, -1, -1);
+    for (; x + 2 <= pairs; x += 2) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(col + 6*x));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(col + 6*x + 4));
+      __m128i e = _mm_or_si128(_mm_shuffle_epi8(a, ev_a), _mm_shuffle_epi8(b, ev_b));
+      __m128i o = _mm_or_si128(_mm_shuffle_epi8(a, od_a), _mm_shuffle_epi8(b, od_b));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(ev + 3*x), e);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(od + 3*x + 3), o);
+    }
+  }
+#endif
+  else if (c == 4) {
+    for (; x + 2 <= pairs; x += 2) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(col + 8*x));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(col + 8*x + 8));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(ev + 4*x),
+                       _mm_unpacklo_epi64(a, b));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(od + 4*x + 4),
+                       _mm_unpackhi_epi64(a, b));
+    }
+  }
+#endif
+  for (; x < pairs; x++) {
+    for (int z=0; z<c; z++) {
+      ev[x*c+z] = col[2*x*c+z];
+      od[(x+1)*c+z] = col[(2*x+1)*c+z];
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// 가로 방향 [1 3 3 1] 과 반올림. 출력 pixel x 의 입력 pixel 2x-1, 2x, 2x+1, 2x+2
+// 는 od[x], ev[x], od[x+1], ev[x+1] 이다.
+//------------------------------------------------------------------------------
+static void reduce_gaussian_row(const uint16_t* ev, const uint16_t* od,
+                                uint8_t* out, size_t n, int c) {
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i round = _mm_set1_epi16(32);
+  for (; i + 8 <= n; i += 8) {
+    __m128i e0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ev + i));
+    __m128i e1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ev + i + c));
+    __m128i o0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(od + i));
+    __m128i o1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(od + i + c));
+    // 최대 255 * 64 이므로 16bit 에서 넘치지 않는다.
+    __m128i mid = _mm_add_epi16(e0, o1);
+    __m128i sum = _mm_add_epi16(_mm_add_epi16(o0, e1), round);
+    sum = _mm_add_epi16(sum, _mm_add_epi16(mid, _mm_add_epi16(mid, mid)));
+    sum = _mm_srli_epi16(sum, 6);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i),
+                     _mm_packus_epi16(sum, sum));
+  }
+#endif
+  for (; i < n; i++) {
+    int v = od[i] + 3 * (ev[i] + od[i+c]) + ev[i+c];
+    out[i] = static_cast<uint8_t>((v + 32) >> 6);
+  }
+}
+
+//------------------------------------------------------------------------------
+// 입력 이미지를 [1 3 3 1]/8 필터로 2x 축소하여 출력 row [y0, y1) 을 기록.
+// 출력 (y, x) 는 입력 2y-1 ~ 2y+2, 2x-1 ~ 2x+2 범위의 가중 평균이다.
+// (경계는 clamp)
+//------------------------------------------------------------------------------
+static void reduce_gaussian(const uint8_t* in, int in_h, int in_w,
+                            uint8_t* out, int out_w, int c, int y0, int y1) {
+  auto in_stride = static_cast<size_t>(in_w) * c;
+  auto out_stride = static_cast<size_t>(out_w) * c;
+  int pairs = in_w / 2;
+  std::vector<uint16_t> col(in_stride);  // 세로 방향 가중합. (최대 255*8)
+  std::vector<uint16_t> ev(out_stride + 2 * c);
+  std::vector<uint16_t> od(out_stride + 2 * c);
+  for (int y=y0; y<y1; y++) {
+    const uint8_t* rows[4];
+    for (int i=0; i<4; i++) {
+      auto r = std::min(std::max(2 * y - 1 + i, 0), in_h - 1);
+      rows[i] = in + r * in_stride;
+    }
+    reduce_gaussian_col(rows, col.data(), in_stride);
+    split_pixel_pairs(col.data(), pairs, c, ev.data(), od.data());
+    // 경계 pixel. 왼쪽의 pixel -1 과 오른쪽에서 입력을 넘는 pixel 을 clamp.
+    for (int z=0; z<c; z++)
+      od[z] = col[z];
+    for (int x=pairs; x<=out_w; x++) {
+      auto px = std::min(2 * x, in_w - 1) * c;
+      auto po = std::min(2 * x + 1, in_w - 1) * c;
+      for (int z=0; z<c; z++) {
+        ev[x*c+z] = col[px+z];
+        od[(x+1)*c+z] = col[po+z];
+      }
+    }
+    reduce_gaussian_row(ev.data(), od.data(), out + y * out_stride,
+                        out_stride, c);
+  }
+}
+
+//------------------------------------------------------------------------------
+// 2x 축소를 반복하여 levels 개의 mip-chain 을 생성한다.
+// 각 level 은 바로 이전 level 에서 만들어지므로 원본은 한 번만 읽는다.
+//------------------------------------------------------------------------------
+std::vector<Image> Image::buildPyramid(int levels, PyramidFilter filter) const {
+  std::vector<Image> pyramid;
+  if (empty() || levels <= 0)
+    return pyramid;
+
+  // level 별 크기와 전체 메모리 크기 계산.
+  std::vector<int> hs, ws;
+  std::vector<size_t> offsets;
+  size_t total = 0;
+  auto h = h_;
+  auto w = w_;
+  for (int i=0; i<levels; i++) {
+    if (h == 1 && w == 1)
+      break;
+    h = std::max(1, h / 2);
+    w = std::max(1, w / 2);
+    hs.push_back(h);
+    ws.push_back(w);
+    offsets.push_back(total);
+    total += static_cast<size_t>(h) * w * c_;
+  }
+  if (total == 0)
+    return pyramid;
+
+  std::shared_ptr<uint8_t> block(new uint8_t[total],
+                                 std::default_delete<uint8_t[]>());
+  // Image 의 복사는 deep copy 이므로 재할당이 일어나지 않도록 미리 확보.
+  pyramid.reserve(hs.size());
+  auto& pool = ThreadPool::instance();
+  const uint8_t* src = pdata_.get();
+  auto src_h = h_;
+  auto src_w = w_;
+  for (size_t i=0; i<hs.size(); i++) {
+    // block 의 일부를 가리키면서 block 의 소유권을 공유한다.
+    std::shared_ptr<uint8_t> level(block, block.get() + offsets[i]);
+    // level 안에서는 출력 row band 로 나누어 병렬 처리한다.
+    const int out_h = hs[i];
+    const int out_w = ws[i];
+    const int c = c_;
+    uint8_t* dst = level.get();
+    int bands = std::min(pool.concurrency(), out_h / kReduceBandRows);
+    bands = std::max(1, bands);
+    int band_h = (out_h + bands - 1) / bands;
+    bands = (out_h + band_h - 1) / band_h;
+    pool.parallelFor(bands, [&](int b) {
+      int y0 = b * band_h;
+      int y1 = std::min(out_h, y0 + band_h);
+      if (filter == PyramidFilter::kGaussian)
+        reduce_gaussian(src, src_h, src_w, dst, out_w, c, y0, y1);
+      else
+        reduce_box(src, src_h, src_w, dst, out_w, c, y0, y1);
+    });
+    pyramid.push_back(Image(hs[i], ws[i], c_, level));
+    src = level.get();
+    src_h = hs[i];
+    src_w = ws[i];
+  }
+  return pyramid;
 }
 
 //------------------------------------------------------------------------------
@@ -427,6 +841,367 @@ std::vector<Image> Image::layers() const {
   return images;
 }
 
+//------------------------------------------------------------------------------
+// separable convolution 의 고정소수점 정밀도.
+// kernel 계수는 최대 Q14, 가로 pass 결과는 최대 pixel * 64 (Q6) 의 int16 으로
+// 저장하고 세로 pass 는 int32 로 누적하여 마지막에 uint8 로 변환한다.
+// 계수나 절대값 합이 큰 kernel (sharpen 등) 은 int16, int32 에 들어가도록
+// kernel 마다 bit 수를 줄인다. 최소 bit 수로도 넘치는 kernel 은 float 로 계산한다.
+//------------------------------------------------------------------------------
+static const int kConvMaxCoefBits = 14;
+static const int kConvMinCoefBits = 8;
+static const int kConvMaxInterBits = 6;
+// 가로 pass 결과 buffer 를 L2 안에 두기 위한 band 당 크기.
+static const size_t kConvBandBytes = 256 * 1024;
+
+//------------------------------------------------------------------------------
+// kernel 한 개의 tap. off1 >= 0 이면 대칭 tap 으로 두 입력을 더해 곱한다.
+//------------------------------------------------------------------------------
+struct ConvTap {
+  int off0;
+  int off1;
+  int16_t coef;
+};
+
+//------------------------------------------------------------------------------
+// float kernel 을 Q(coef_bits) tap 목록으로 변환.
+// 계수가 int16 에, 입력 (최대 input_max) 과의 곱의 합이 int32 에 들어가는
+// 가장 큰 coef_bits (kConvMinCoefBits ~ kConvMaxCoefBits) 를 고른다.
+// 그런 coef_bits 가 없으면 false.
+// 반올림으로 합이 틀어지지 않도록 중심 계수에서 오차를 보정한다.
+// 대칭 kernel (gaussian 등) 은 대칭 tap 을 합쳐 곱셈 수를 절반으로 줄이는데,
+// 두 입력의 합이 int16 범위를 넘지 않도록 입력 최대값(input_max)을 확인한다.
+// abs_sum 에는 Q 계수 절대값의 합을, error 에는 입력 범위 1 당 계수 반올림으로
+// 생길 수 있는 최대 오차를 돌려준다.
+//------------------------------------------------------------------------------
+static bool make_conv_taps(const std::vector<float>& kernel, int input_max,
+                           std::vector<ConvTap>* taps, int* coef_bits,
+                           int* abs_sum, double* error) {
+  taps->clear();
+  if (kernel.empty())
+    return false;
+  double sum = 0.0;
+  for (auto k : kernel)
+    sum += k;
+
+  int n = static_cast<int>(kernel.size());
+  int center = n / 2;
+  std::vector<int64_t> q(n);
+  int64_t q_abs_sum = 0;
+  int bits = kConvMaxCoefBits;
+  for (;; bits--) {
+    if (bits < kConvMinCoefBits)
+      return false;
+    int64_t qsum = 0;
+    for (int i=0; i<n; i++) {
+      q[i] = std::llround(kernel[i] * static_cast<double>(1 << bits));
+      qsum += q[i];
+    }
+    q[center] += std::llround(sum * (1 << bits)) - qsum;
+    bool fits = true;
+    q_abs_sum = 0;
+    for (int i=0; i<n; i++) {
+      fits = fits && q[i] >= std::numeric_limits<int16_t>::min() &&
+             q[i] <= std::numeric_limits<int16_t>::max();
+      q_abs_sum += q[i] < 0 ? -q[i] : q[i];
+    }
+    // 반올림 값을 더해도 넘치지 않도록 절반까지만 사용한다.
+    if (fits && q_abs_sum * input_max <= std::numeric_limits<int32_t>::max() / 2)
+      break;
+  }
+  *coef_bits = bits;
+  *abs_sum = static_cast<int>(q_abs_sum);
+  // 오차의 합이 d 이면 입력 범위 안에서 오차는 |d| + (|오차| 의 합) / 2 이하이다.
+  double diff = 0.0, abs_diff = 0.0;
+  for (int i=0; i<n; i++) {
+    double e = static_cast<double>(q[i]) / (1 << bits) - kernel[i];
+    diff += e;
+    abs_diff += std::fabs(e);
+  }
+  *error = std::fabs(diff) + abs_diff / 2;
+
+  bool symmetric = (n % 2 == 1) &&
+                   (2 * input_max <= std::numeric_limits<int16_t>::max());
+  for (int i=0; i<n; i++) {
+    if (q[i] != q[n-1-i])
+      symmetric = false;
+  }
+
+  for (int i=0; i<n; i++) {
+    if (q[i] == 0)
+      continue;
+    if (symmetric && i > center)
+      break;
+    ConvTap tap;
+    tap.off0 = i;
+    tap.off1 = (symmetric && i != center) ? n - 1 - i : -1;
+    tap.coef = static_cast<int16_t>(q[i]);
+    taps->push_back(tap);
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// 고정소수점으로 충분히 정확하게 계산할 수 없는 kernel 의 separable
+// convolution. (float)
+//------------------------------------------------------------------------------
+static void convolve_float(const uint8_t* src, uint8_t* dst, int h, int w,
+                           int c, const std::vector<float>& kernel_h,
+                           const std::vector<float>& kernel_w,
+                           EdgeMode edge) {
+  const int top = static_cast<int>(kernel_h.size()) / 2;
+  const int left = static_cast<int>(kernel_w.size()) / 2;
+  const size_t stride = static_cast<size_t>(w) * c;
+  std::vector<float> inter(static_cast<size_t>(h) * stride);
+  ThreadPool::instance().parallelFor(h, [&](int y) {
+    float* out = &inter[y * stride];
+    for (int x=0; x<w; x++) {
+      for (int z=0; z<c; z++) {
+        float v = 0.0f;
+        for (size_t i=0; i<kernel_w.size(); i++) {
+          int sx = edgeIndex(edge, x - left + static_cast<int>(i), w);
+          if (sx >= 0)
+            v += kernel_w[i] * src[y * stride + sx * c + z];
+        }
+        out[x*c+z] = v;
+      }
+    }
+  });
+  ThreadPool::instance().parallelFor(h, [&](int y) {
+    uint8_t* out = dst + y * stride;
+    for (size_t j=0; j<stride; j++) {
+      float v = 0.0f;
+      for (size_t i=0; i<kernel_h.size(); i++) {
+        int sy = edgeIndex(edge, y - top + static_cast<int>(i), h);
+        if (sy >= 0)
+          v += kernel_h[i] * inter[sy * stride + j];
+      }
+      out[j] = static_cast<uint8_t>(std::min(std::max(std::lround(v), 0L), 255L));
+    }
+  });
+}
+
+//------------------------------------------------------------------------------
+// acc[i] += a[i] * ca + b[i] * cb. 대칭 tap 이면 a = a0 + a1 (b 도 동일).
+// SSE2 에서는 a, b 를 interleave 하여 pmaddwd 한 번에 두 tap 을 처리한다.
+//------------------------------------------------------------------------------
+static void conv_mac(int32_t* acc, size_t n,
+                     const int16_t* a0, const int16_t* a1, int16_t ca,
+                     const int16_t* b0, const int16_t* b1, int16_t cb) {
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i coef = _mm_set1_epi32(
+      static_cast<int32_t>((static_cast<uint32_t>(static_cast<uint16_t>(cb)) << 16) |
+                           static_cast<uint16_t>(ca)));
+  for (; i + 8 <= n; i += 8) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a0 + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b0 + i));
+    if (a1)
+      a = _mm_add_epi16(a, _mm_loadu_si128(reinterpret_cast<const __m128i*>(a1 + i)));
+    if (b1)
+      b = _mm_add_epi16(b, _mm_loadu_si128(reinterpret_cast<const __m128i*>(b1 + i)));
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(a, b), coef);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(a, b), coef);
+    __m128i* p = reinterpret_cast<__m128i*>(acc + i);
+    _mm_storeu_si128(p, _mm_add_epi32(_mm_loadu_si128(p), lo));
+    _mm_storeu_si128(p + 1, _mm_add_epi32(_mm_loadu_si128(p + 1), hi));
+  }
+#endif
+  for (; i < n; i++) {
+    int32_t a = a0[i] + (a1 ? a1[i] : 0);
+    int32_t b = b0[i] + (b1 ? b1[i] : 0);
+    acc[i] += a * ca + b * cb;
+  }
+}
+
+//------------------------------------------------------------------------------
+// tap 목록을 두 개씩 묶어 acc 에 누적. rows(off) 는 tap offset 의 입력 pointer.
+//------------------------------------------------------------------------------
+template <typename RowFn>
+static void conv_accumulate(int32_t* acc, size_t n,
+                            const std::vector<ConvTap>& taps, RowFn rows) {
+  std::fill(acc, acc + n, 0);
+  for (size_t t=0; t<taps.size(); t+=2) {
+    const ConvTap& a = taps[t];
+    const int16_t* a0 = rows(a.off0);
+    const int16_t* a1 = (a.off1 >= 0) ? rows(a.off1) : nullptr;
+    if (t + 1 < taps.size()) {
+      const ConvTap& b = taps[t+1];
+      const int16_t* b1 = (b.off1 >= 0) ? rows(b.off1) : nullptr;
+      conv_mac(acc, n, a0, a1, a.coef, rows(b.off0), b1, b.coef);
+    }
+    else {
+      conv_mac(acc, n, a0, a1, a.coef, a0, nullptr, 0);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// separable convolution. 출력 row 를 band 로 나누어 병렬로 처리한다.
+// band 마다 필요한 입력 row 를 가로 방향으로 먼저 filtering 하여 int16 buffer
+// (L2 크기 이내) 에 두고, 세로 방향 filtering 으로 출력 row 를 만든다.
+//------------------------------------------------------------------------------
+bool Image::convolve(const std::vector<float>& kernel_h,
+                     const std::vector<float>& kernel_w, EdgeMode edge) {
+  if (empty())
+    return false;
+  if (kernel_h.empty() || kernel_w.empty())
+    return false;
+  // 가로 pass 의 입력은 pixel 값, 세로 pass 의 입력은 가로 pass 의 결과이다.
+  // 가로 pass 결과 (pixel * 2^inter_bits) 가 int16 에 들어가도록 inter_bits 를
+  // 정한다.
+  // 오차 (계수 반올림, 가로 pass 결과의 반올림이 세로 kernel 로 커지는 것) 가
+  // 0.5 를 넘을 수 있으면 float 로 계산한다. (결과가 float 와 1 이내)
+  std::vector<ConvTap> taps_h, taps_w;
+  int bits_w = 0, bits_h = 0, abs_sum_w = 0, abs_sum_h = 0;
+  double error_w = 0.0, error_h = 0.0;
+  int inter_bits = kConvMaxInterBits;
+  bool fixed = make_conv_taps(kernel_w, 255, &taps_w, &bits_w, &abs_sum_w,
+                              &error_w);
+  while (fixed && inter_bits >= 0 &&
+         ((255 * abs_sum_w) >> (bits_w - inter_bits)) + 1 >
+             std::numeric_limits<int16_t>::max())
+    inter_bits--;
+  fixed = fixed && inter_bits >= 0;
+  int inter_max = fixed ? ((255 * abs_sum_w) >> (bits_w - inter_bits)) + 1 : 0;
+  fixed = fixed && make_conv_taps(kernel_h, inter_max, &taps_h, &bits_h,
+                                  &abs_sum_h, &error_h);
+  if (fixed) {
+    double gain_w = 0.0, gain_h = 0.0;
+    for (auto k : kernel_w)
+      gain_w += std::fabs(k);
+    for (auto k : kernel_h)
+      gain_h += std::fabs(k);
+    double error = gain_h * (255.0 * error_w + 0.5 / (1 << inter_bits)) +
+                   255.0 * gain_w * error_h;
+    fixed = error <= 0.5;
+  }
+  if (!fixed) {
+    Image image(h_, w_, c_);
+    convolve_float(pdata_.get(), image.pdata_.get(), h_, w_, c_, kernel_h,
+                   kernel_w, edge);
+    swap(image);
+    return true;
+  }
+  const int horz_shift = bits_w - inter_bits;
+  const int vert_shift = bits_h + inter_bits;
+
+  const int top = static_cast<int>(kernel_h.size()) / 2;
+  const int left = static_cast<int>(kernel_w.size()) / 2;
+  const int span_h = static_cast<int>(kernel_h.size()) - 1;
+  const int span_w = static_cast<int>(kernel_w.size()) - 1;
+  const size_t stride = static_cast<size_t>(w_) * c_;
+
+  auto& pool = ThreadPool::instance();
+  int band_h = static_cast<int>(kConvBandBytes / (stride * sizeof(int16_t)));
+  band_h = std::max(8, band_h - span_h);
+  band_h = std::min(band_h, (h_ + pool.concurrency() - 1) / pool.concurrency());
+  band_h = std::max(1, band_h);
+  int num_bands = (h_ + band_h - 1) / band_h;
+
+  Image image(h_, w_, c_);
+  const uint8_t* src = pdata_.get();
+  uint8_t* dst = image.pdata_.get();
+  const int h = h_;
+  const int w = w_;
+  const int c = c_;
+
+  pool.parallelFor(num_bands, [&](int b) {
+    int y0 = b * band_h;
+    int y1 = std::min(h, y0 + band_h);
+    int rows = y1 - y0 + span_h;
+
+    std::vector<int16_t> pad((w + span_w) * c);
+    std::vector<int16_t> inter(rows * stride);
+    std::vector<int32_t> acc(stride);
+
+    // 1) 가로 pass. inter 의 r 번째 row 는 입력 row (y0 - top + r) 이다.
+    for (int r=0; r<rows; r++) {
+      int16_t* out = &inter[r * stride];
+      int sy = edgeIndex(edge, y0 - top + r, h);
+      if (sy < 0) {
+        std::fill(out, out + stride, 0);
+        continue;
+      }
+      const uint8_t* in = src + sy * stride;
+      for (int x=0; x<w+span_w; x++) {
+        int sx = edgeIndex(edge, x - left, w);
+        for (int z=0; z<c; z++)
+          pad[x*c+z] = (sx < 0) ? 0 : in[sx*c+z];
+      }
+      conv_accumulate(acc.data(), stride, taps_w,
+                      [&](int off) { return &pad[off * c]; });
+      for (size_t i=0; i<stride; i++) {
+        int v = (acc[i] + (1 << (horz_shift - 1))) >> horz_shift;
+        out[i] = static_cast<int16_t>(v);
+      }
+    }
+
+    // 2) 세로 pass.
+    for (int y=y0; y<y1; y++) {
+      int base = y - y0;
+      conv_accumulate(acc.data(), stride, taps_h,
+                      [&](int off) { return &inter[(base + off) * stride]; });
+      uint8_t* out = dst + y * stride;
+      for (size_t i=0; i<stride; i++) {
+        int v = (acc[i] + (1 << (vert_shift - 1))) >> vert_shift;
+        out[i] = static_cast<uint8_t>(std::min(std::max(v, 0), 255));
+      }
+    }
+  });
+  swap(image);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// gaussian blur. kernel 반경은 3 sigma 이다.
+//------------------------------------------------------------------------------
+bool Image::gaussianBlur(float sigma, EdgeMode edge) {
+  if (sigma <= 0.0f)
+    return false;
+  int radius = std::max(1, static_cast<int>(std::ceil(sigma * 3.0f)));
+  std::vector<float> kernel(2 * radius + 1);
+  float sum = 0.0f;
+  for (int i=-radius; i<=radius; i++) {
+    kernel[i+radius] = std::exp(-(i * i) / (2.0f * sigma * sigma));
+    sum += kernel[i+radius];
+  }
+  for (auto& k : kernel)
+    k /= sum;
+  return convolve(kernel, kernel, edge);
+}
+
+//------------------------------------------------------------------------------
+// unsharp mask. blur 와의 차이를 amount 배 만큼 더한다. (amount 는 Q8 정수 연산)
+//------------------------------------------------------------------------------
+bool Image::unsharpMask(float sigma, float amount, int threshold,
+                        EdgeMode edge) {
+  if (empty())
+    return false;
+  Image blurred(*this);
+  if (!blurred.gaussianBlur(sigma, edge))
+    return false;
+
+  const int scale = static_cast<int>(std::lround(amount * 256.0f));
+  const size_t total = size();
+  const size_t chunk = 64 * 1024;
+  int num_chunks = static_cast<int>((total + chunk - 1) / chunk);
+  uint8_t* p = pdata_.get();
+  const uint8_t* q = blurred.pdata_.get();
+  ThreadPool::instance().parallelFor(num_chunks, [&](int i) {
+    size_t begin = i * chunk;
+    size_t end = std::min(total, begin + chunk);
+    for (size_t k=begin; k<end; k++) {
+      int diff = p[k] - q[k];
+      if (std::abs(diff) < threshold)
+        continue;
+      int v = p[k] + ((diff * scale + 128) >> 8);
+      p[k] = static_cast<uint8_t>(std::min(std::max(v, 0), 255));
+    }
+  });
+  return true;
+}
+
 //------------------------------------------------------------------------------
 // 입력된 image를 현재 이미지 (x, y) 지점을 시작으로 하여 데이터 복사.
 // 현재 이미지에다가 image 를 도장 찍는다고 생각하면 쉽다.
@@ -445,6 +1220,61 @@ void Image::stamp(const Image& img, int x, int y) {
   }
 }
 
+//------------------------------------------------------------------------------
+// 여러 이미지를 grid 형태로 배치한 하나의 이미지(contact sheet)를 생성한다.
+// canvas 는 한 번만 할당하고, cell 들은 서로 겹치지 않으므로 각 thread 가
+// lock 없이 자신이 맡은 cell 영역에 resize 결과를 직접 기록한다.
+//------------------------------------------------------------------------------
+Image Image::compose(const GridSpec& spec, const std::vector<Image>& images) {
+  if (spec.rows <= 0 || spec.cols <= 0)
+    return Image();
+  if (spec.cell_h <= 0 || spec.cell_w <= 0)
+    return Image();
+  if (spec.padding < 0 || spec.channel <= 0)
+    return Image();
+
+  auto pad = spec.padding;
+  auto h = spec.rows * spec.cell_h + (spec.rows + 1) * pad;
+  auto w = spec.cols * spec.cell_w + (spec.cols + 1) * pad;
+  Image canvas(h, w, spec.channel, spec.background);
+
+  auto num_cells = std::min(static_cast<int>(images.size()),
+                            spec.rows * spec.cols);
+  ThreadPool::instance().parallelFor(num_cells, [&](int i) {
+    const Image& img = images[i];
+    if (img.empty())
+      return;
+
+    // cell 안에서 이미지가 차지할 크기.
+    auto rh = spec.cell_h;
+    auto rw = spec.cell_w;
+    if (spec.keep_ratio) {
+      auto ih = static_cast<int64_t>(img.h());
+      auto iw = static_cast<int64_t>(img.w());
+      if (iw * spec.cell_h > ih * spec.cell_w)
+        rh = std::max(1, static_cast<int>(ih * spec.cell_w / iw));
+      else
+        rw = std::max(1, static_cast<int>(iw * spec.cell_h / ih));
+    }
+    auto x = pad + (i / spec.cols) * (spec.cell_h + pad) + (spec.cell_h - rh) / 2;
+    auto y = pad + (i % spec.cols) * (spec.cell_w + pad) + (spec.cell_w - rw) / 2;
+
+    if (img.c() == canvas.c_) {
+      // canvas 의 row stride 를 그대로 사용하여 cell 영역에 바로 resize.
+      auto dst = canvas.pdata_.get() + canvas.offset(x, y, 0);
+      resizeUint8(img.pdata_.get(), img.h_, img.w_, img.w_*img.c_,
+                  dst, rh, rw, canvas.w_*canvas.c_, canvas.c_, spec.resize);
+    }
+    else {
+      // channel 수가 다르면 resize 후 stamp 와 같은 규칙으로 복사.
+      Image tile(rh, rw, img.c());
+      img.resizeTo(&tile, spec.resize);
+      canvas.stamp(tile, x, y);
+    }
+  });
+  return canvas;
+}
+
 //------------------------------------------------------------------------------
 // 이미지 border 를 추가. 색상은 pixel 값으로 추가한다. (모든 채널에 적용)
 //------------------------------------------------------------------------------
@@ -557,133 +1387,804 @@ float Image::aspectRatio() const {
 }
 
 //------------------------------------------------------------------------------
-// 이미지를 binary 로 변경하는 함수로 내부에서만 사용함.
+// 범위 안에서 stb 호출이 cancel 을 확인하도록 설정한다.
+//------------------------------------------------------------------------------
+struct StbCancelScope {
+  const CancelToken* prev;
+
+  explicit StbCancelScope(const CancelToken* cancel) : prev(stb_cancel) {
+    stb_cancel = cancel;
+  }
+  ~StbCancelScope() { stb_cancel = prev; }
+};
+
+//------------------------------------------------------------------------------
+// 범위 안에서 stb_image 의 decode 설정을 options 로 바꾼다.
+// 현재 thread 에만 적용되며 (stb 의 *_thread 설정), 끝나면 이전 설정으로
+// 되돌린다. 시작할 때 failure reason 을 지운다.
+//------------------------------------------------------------------------------
+struct StbLoadOptionsScope {
+  int flip, flip_set;
+  int unpremultiply, unpremultiply_set;
+  int iphone, iphone_set;
+
+  explicit StbLoadOptionsScope(const LoadOptions& options)
+      : flip(stbi__vertically_flip_on_load_local),
+        flip_set(stbi__vertically_flip_on_load_set),
+        unpremultiply(stbi__unpremultiply_on_load_local),
+        unpremultiply_set(stbi__unpremultiply_on_load_set),
+        iphone(stbi__de_iphone_flag_local),
+        iphone_set(stbi__de_iphone_flag_set) {
+    ::stbi_set_flip_vertically_on_load_thread(options.flip_vertically);
+    ::stbi_set_unpremultiply_on_load_thread(options.unpremultiply);
+    ::stbi_convert_iphone_png_to_rgb_thread(options.convert_iphone_png);
+    stb_set_failure_reason(nullptr);
+  }
+  ~StbLoadOptionsScope() {
+    stbi__vertically_flip_on_load_local = flip;
+    stbi__vertically_flip_on_load_set = flip_set;
+    stbi__unpremultiply_on_load_local = unpremultiply;
+    stbi__unpremultiply_on_load_set = unpremultiply_set;
+    stbi__de_iphone_flag_local = iphone;
+    stbi__de_iphone_flag_set = iphone_set;
+  }
+};
+
+//------------------------------------------------------------------------------
+// 범위 안에서 stb_image_write 의 encode 설정을 options 로 바꾼다.
+// (StbLoadOptionsScope 와 같은 방식)
+//------------------------------------------------------------------------------
+struct StbSaveOptionsScope {
+  int flip, flip_set;
+  int level, level_set;
+  int filter, filter_set;
+  int restart, restart_set;
+
+  explicit StbSaveOptionsScope(const SaveOptions& options)
+      : flip(stbiw__flip_local), flip_set(stbiw__flip_set),
+        level(stbiw__png_level_local), level_set(stbiw__png_level_set),
+        filter(stbiw__png_filter_local), filter_set(stbiw__png_filter_set),
+        restart(stbiw__jpg_restart_local),
+        restart_set(stbiw__jpg_restart_set) {
+    ::stbi_flip_vertically_on_write_thread(options.flip_vertically);
+    ::stbi_write_png_compression_level_thread(options.png_compression_level);
+    ::stbi_write_force_png_filter_thread(options.png_filter);
+    ::stbi_write_jpg_restart_interval_thread(options.jpg_restart_interval);
+  }
+  ~StbSaveOptionsScope() {
+    stbiw__flip_local = flip;
+    stbiw__flip_set = flip_set;
+    stbiw__png_level_local = level;
+    stbiw__png_level_set = level_set;
+    stbiw__png_filter_local = filter;
+    stbiw__png_filter_set = filter_set;
+    stbiw__jpg_restart_local = restart;
+    stbiw__jpg_restart_set = restart_set;
+  }
+};
+
+//------------------------------------------------------------------------------
+// 현재 thread 에서 마지막 load 가 실패한 이유. 이유가 없으면 빈 문자열.
+//------------------------------------------------------------------------------
+const char* Image::lastError() {
+  const char* reason = stb_failure_reason();
+  return reason ? reason : "";
+}
+
+//------------------------------------------------------------------------------
+// encode 결과를 vector 뒤에 붙이는 stb callback.
+//------------------------------------------------------------------------------
+static void write_vector(void* context, void* data, int size) {
+  assert(context);
+  assert(data);
+  auto tgt = static_cast<std::vector<uint8_t>*>(context);
+  auto src = static_cast<uint8_t*>(data);
+  tgt->insert(tgt->end(), src, src + size);
+}
+
+//------------------------------------------------------------------------------
+// encode 결과를 크기가 정해진 buffer 에 쓰는 stb callback.
+// 넘치는 부분은 쓰지 않고 overflow 로 표시한다.
 //------------------------------------------------------------------------------
-static void write_func(void* context, void* data, int size) {
+struct BufferWriter {
+  uint8_t* data;
+  size_t size;
+  size_t pos;
+  bool overflow;
+
+  BufferWriter(uint8_t* buffer, int buf_size)
+      : data{buffer}, size{static_cast<size_t>(std::max(buf_size, 0))},
+        pos{0}, overflow{false} {}
+};
+
+static void write_buffer(void* context, void* data, int size) {
   assert(context);
   assert(data);
-  auto tgt = reinterpret_cast<uint8_t*>(context);
-  auto src = reinterpret_cast<uint8_t*>(data);
-  for (auto i=0; i<size; i++) {
-    tgt[i] = src[i];
+  auto tgt = static_cast<BufferWriter*>(context);
+  auto n = static_cast<size_t>(size);
+  if (tgt->overflow || n > tgt->size - tgt->pos) {
+    tgt->overflow = true;
+    return;
   }
+  std::copy_n(static_cast<uint8_t*>(data), n, tgt->data + tgt->pos);
+  tgt->pos += n;
 }
 
 //------------------------------------------------------------------------------
 // png 포맷으로 이미지 저장. (특정 파일에 저장한다.)
 //------------------------------------------------------------------------------
-bool Image::savePng(const std::string& filename) const {
+bool Image::savePng(const std::string& filename,
+                    const CancelToken* cancel) const {
+  return savePng(filename, SaveOptions(), cancel);
+}
+
+//------------------------------------------------------------------------------
+// png 포맷으로 이미지 저장. (buffer에 저장)
+//------------------------------------------------------------------------------
+bool Image::savePng(std::vector<uint8_t>* buffer,
+                    const CancelToken* cancel) const {
+  return savePng(buffer, SaveOptions(), cancel);
+}
+
+//------------------------------------------------------------------------------
+// png 포맷으로 이미지 저장. (raw buffer에 저장)
+//------------------------------------------------------------------------------
+bool Image::savePng(uint8_t* buffer, int buf_size,
+                    const CancelToken* cancel) const {
+  return savePng(buffer, buf_size, SaveOptions(), cancel);
+}
+
+bool Image::saveJpg(const std::string& filename,
+                    const CancelToken* cancel) const {
+  return saveJpg(filename, SaveOptions(), cancel);
+}
+bool Image::saveJpg(std::vector<uint8_t>* buffer,
+                    const CancelToken* cancel) const {
+  return saveJpg(buffer, SaveOptions(), cancel);
+}
+bool Image::saveJpg(uint8_t* buffer, int buf_size,
+                    const CancelToken* cancel) const {
+  return saveJpg(buffer, buf_size, SaveOptions(), cancel);
+}
+
+//------------------------------------------------------------------------------
+// options 의 설정으로 png 포맷 저장. (특정 파일에 저장한다.)
+//------------------------------------------------------------------------------
+bool Image::savePng(const std::string& filename, const SaveOptions& options,
+                    const CancelToken* cancel) const {
   auto f = filename.c_str();
+  StbCancelScope scope(cancel);
+  StbSaveOptionsScope options_scope(options);
   return ::stbi_write_png(f, w_, h_, c_, pdata_.get(), w_*c_);
 }
 
 //------------------------------------------------------------------------------
-// png 포맷으로 이미지 저장. (buffer에 저장)
+// options 의 설정으로 png 포맷 저장. (buffer 에 저장, 크기는 결과에 맞춘다)
 //------------------------------------------------------------------------------
-bool Image::savePng(std::vector<uint8_t>* buffer) const {
+bool Image::savePng(std::vector<uint8_t>* buffer, const SaveOptions& options,
+                    const CancelToken* cancel) const {
   assert(buffer);
   if ((!buffer) || empty())
     return false;
-  buffer->resize(size());
-  return ::stbi_write_png_to_func(write_func, buffer->data(),
+  StbCancelScope scope(cancel);
+  StbSaveOptionsScope options_scope(options);
+  buffer->clear();
+  return ::stbi_write_png_to_func(write_vector, buffer,
                                   w_, h_, c_, pdata_.get(), w_*c_);
 }
 
 //------------------------------------------------------------------------------
-// png 포맷으로 이미지 저장. (raw buffer에 저장)
+// options 의 설정으로 png 포맷 저장. (raw buffer 에 저장)
 //------------------------------------------------------------------------------
-bool Image::savePng(uint8_t* buffer, int buf_size) const {
+bool Image::savePng(uint8_t* buffer, int buf_size, const SaveOptions& options,
+                    const CancelToken* cancel) const {
   assert(buffer);
-  if (buf_size < static_cast<int>(size()))
+  if ((!buffer) || empty())
     return false;
-  return ::stbi_write_png_to_func(write_func, buffer,
-                                  w_, h_, c_, pdata_.get(), w_*c_);
+  StbCancelScope scope(cancel);
+  StbSaveOptionsScope options_scope(options);
+  BufferWriter writer(buffer, buf_size);
+  return ::stbi_write_png_to_func(write_buffer, &writer,
+                                  w_, h_, c_, pdata_.get(), w_*c_) &&
+         !writer.overflow;
 }
 
-bool Image::saveJpg(const std::string& filename) const {
+//------------------------------------------------------------------------------
+// options 의 설정으로 jpg 포맷 저장. (특정 파일에 저장한다.)
+//------------------------------------------------------------------------------
+bool Image::saveJpg(const std::string& filename, const SaveOptions& options,
+                    const CancelToken* cancel) const {
   auto f = filename.c_str();
-  static const int quality = 100;
-  return ::stbi_write_jpg(f, w_, h_, c_, pdata_.get(), quality);
+  StbCancelScope scope(cancel);
+  StbSaveOptionsScope options_scope(options);
+  if (::stbi_write_jpg(f, w_, h_, c_, pdata_.get(), options.jpg_quality))
+    return true;
+  // JPEG 은 encode 하면서 파일에 쓰므로 중단된 파일을 지운다.
+  if (isCancelled(cancel))
+    std::remove(f);
+  return false;
 }
-bool Image::saveJpg(std::vector<uint8_t>* buffer) const {
-  static const int quality = 100;
+
+//------------------------------------------------------------------------------
+// options 의 설정으로 jpg 포맷 저장. (buffer 에 저장, 크기는 결과에 맞춘다)
+//------------------------------------------------------------------------------
+bool Image::saveJpg(std::vector<uint8_t>* buffer, const SaveOptions& options,
+                    const CancelToken* cancel) const {
   assert(buffer);
   if ((!buffer) || empty())
     return false;
-  buffer->resize(size());
-  return ::stbi_write_jpg_to_func(write_func, buffer->data(),
-                                  w_, h_, c_, pdata_.get(), quality);
+  StbCancelScope scope(cancel);
+  StbSaveOptionsScope options_scope(options);
+  buffer->clear();
+  return ::stbi_write_jpg_to_func(write_vector, buffer,
+                                  w_, h_, c_, pdata_.get(),
+                                  options.jpg_quality);
 }
-bool Image::saveJpg(uint8_t* buffer, int buf_size) const {
-  static const int quality = 100;
-  if (buf_size < static_cast<int>(size()))
+
+//------------------------------------------------------------------------------
+// options 의 설정으로 jpg 포맷 저장. (raw buffer 에 저장)
+//------------------------------------------------------------------------------
+bool Image::saveJpg(uint8_t* buffer, int buf_size, const SaveOptions& options,
+                    const CancelToken* cancel) const {
+  assert(buffer);
+  if ((!buffer) || empty())
     return false;
-  return ::stbi_write_jpg_to_func(write_func, buffer,
-                                  w_, h_, c_, pdata_.get(), quality);
+  StbCancelScope scope(cancel);
+  StbSaveOptionsScope options_scope(options);
+  BufferWriter writer(buffer, buf_size);
+  return ::stbi_write_jpg_to_func(write_buffer, &writer,
+                                  w_, h_, c_, pdata_.get(),
+                                  options.jpg_quality) &&
+         !writer.overflow;
 }
 
 
 //------------------------------------------------------------------------------
 // 이미지를 파일에서 load
 //------------------------------------------------------------------------------
-bool Image::load(const std::string& filename, int num_channel) {
-  auto f = filename.c_str();
-  int h, w, c;
-  uint8_t* mem = ::stbi_load(f, &w, &h, &c, num_channel);
-  if (!mem)   return false;
-  if (h <= 0) return false;
-  if (w <= 0) return false;
-  if (c <= 0) return false;
+bool Image::load(const std::string& filename, int num_channel,
+                 const CancelToken* cancel) {
+  return load(filename, 0, 0, num_channel, cancel);
+}
 
-  if (num_channel != c) {
-    c = num_channel;
+//------------------------------------------------------------------------------
+// 이미지를 vector 데이터에서 로드. data는 binary 포멧임.
+//------------------------------------------------------------------------------
+bool Image::load(const std::vector<uint8_t>& raw, int num_channel,
+                 const CancelToken* cancel) {
+  return load(raw, 0, 0, num_channel, cancel);
+}
+
+//------------------------------------------------------------------------------
+// 이미지를 raw pointer 데이터에서 로드. data는 binary 포멧임.
+//------------------------------------------------------------------------------
+bool Image::load(const uint8_t* raw, size_t size, int num_channel,
+                 const CancelToken* cancel) {
+  return load(raw, size, 0, 0, num_channel, cancel);
+}
+
+//------------------------------------------------------------------------------
+// 파일 load 의 읽기 방식. 이 크기 이상의 일반 파일은 mmap 하고, 작은 파일은
+// read buffer 에 읽는다. (mmap, page fault 비용이 복사보다 크다)
+// read buffer 는 thread 별로 재사용하되, 너무 큰 buffer 는 유지하지 않는다.
+//------------------------------------------------------------------------------
+static const size_t kMmapMinBytes = 256 * 1024;
+static const size_t kReadPoolMaxBytes = 64 * 1024 * 1024;
+static thread_local std::vector<uint8_t> read_pool;
+
+//------------------------------------------------------------------------------
+// network, FUSE 파일 시스템은 page fault 마다 원격 요청이 생길 수 있으므로
+// mmap 하지 않는다.
+//------------------------------------------------------------------------------
+static bool mmap_is_slow(int fd) {
+#ifdef __linux__
+  struct statfs fs;
+  if (::fstatfs(fd, &fs) != 0)
+    return true;
+  switch (static_cast<unsigned long>(fs.f_type)) {
+    case 0x6969:      // NFS
+    case 0x517B:      // SMB
+    case 0xFF534D42:  // CIFS
+    case 0xFE534D42:  // SMB2
+    case 0x65735546:  // FUSE
+      return true;
   }
-  std::shared_ptr<uint8_t> data(mem, std::default_delete<uint8_t[]>());
-  Image image(h, w, c, data);
-  swap(image);
+#endif
+  return false;
+}
+
+//------------------------------------------------------------------------------
+// fd 의 내용을 모두 out 에 읽는다. 일반 파일은 크기만큼 pread 하고,
+// pipe 등 크기를 모르는 입력은 끝까지 read 한다.
+//------------------------------------------------------------------------------
+static bool read_fd(int fd, const struct stat& st, std::vector<uint8_t>* out) {
+  size_t done = 0;
+  if (S_ISREG(st.st_mode)) {
+    out->resize(static_cast<size_t>(st.st_size));
+    while (done < out->size()) {
+      ssize_t n = ::pread(fd, out->data() + done, out->size() - done,
+                          static_cast<off_t>(done));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)  // 읽는 중에 파일이 줄어든 경우 포함.
+        return false;
+      done += static_cast<size_t>(n);
+    }
+    return true;
+  }
+  const size_t chunk = Image::kReadBufferSize;
+  for (;;) {
+    if (out->size() < done + chunk)
+      out->resize(done + std::max(done, chunk));
+    ssize_t n = ::read(fd, out->data() + done, out->size() - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n < 0)
+      return false;
+    if (n == 0)
+      break;
+    done += static_cast<size_t>(n);
+  }
+  out->resize(done);
   return true;
 }
 
 //------------------------------------------------------------------------------
-// 이미지를 vector 데이터에서 로드. data는 binary 포멧임.
+// load 할 파일의 내용. 큰 일반 파일은 mmap (MADV_SEQUENTIAL) 하여 decoder 가
+// page cache 를 바로 읽고, 그 외에는 thread 의 read buffer 에 읽는다.
+// (stb 의 병렬 JPEG decode 는 memory 입력에서만 동작한다)
 //------------------------------------------------------------------------------
-bool Image::load(const std::vector<uint8_t>& raw, int num_channel) {
+struct FileData {
+  const uint8_t* data;
+  size_t size;
+  void* map;                    // mmap 한 경우의 mapping.
+  std::vector<uint8_t> buffer;  // 읽은 경우 read_pool 에서 가져온 buffer.
+
+  FileData() : data{nullptr}, size{0}, map{nullptr} {}
+  ~FileData() {
+    if (map) {
+      ::munmap(map, size);
+    } else if (buffer.capacity() <= kReadPoolMaxBytes &&
+               buffer.capacity() > read_pool.capacity()) {
+      read_pool.swap(buffer);
+    }
+  }
+
+  bool open(const std::string& filename) {
+    int fd = ::open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+      return false;
+    std::unique_ptr<int, void(*)(int*)> closer(&fd, [](int* p) {
+      ::close(*p);
+    });
+    struct stat st;
+    if (::fstat(fd, &st) != 0)
+      return false;
+    size_t file_size = static_cast<size_t>(st.st_size);
+    if (S_ISREG(st.st_mode) && file_size >= kMmapMinBytes &&
+        !mmap_is_slow(fd)) {
+      void* p = ::mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p != MAP_FAILED) {
+        ::madvise(p, file_size, MADV_SEQUENTIAL);
+        map = p;
+        data = static_cast<const uint8_t*>(p);
+        size = file_size;
+        return true;
+      }
+    }
+    // 중첩된 load 가 같은 buffer 를 쓰지 않도록 pool 에서 꺼내 쓴다.
+    buffer.swap(read_pool);
+    if (!read_fd(fd, st, &buffer) || buffer.empty())
+      return false;
+    data = buffer.data();
+    size = buffer.size();
+    return true;
+  }
+};
+
+//------------------------------------------------------------------------------
+// 이미지를 파일에서 (min_h, min_w) 이상의 크기로 load.
+//------------------------------------------------------------------------------
+bool Image::load(const std::string& filename, int min_h, int min_w,
+                 int num_channel, const CancelToken* cancel) {
+  LoadOptions options(num_channel);
+  options.min_h = min_h;
+  options.min_w = min_w;
+  return load(filename, options, cancel);
+}
+
+//------------------------------------------------------------------------------
+// 이미지를 vector 데이터에서 (min_h, min_w) 이상의 크기로 load.
+//------------------------------------------------------------------------------
+bool Image::load(const std::vector<uint8_t>& raw, int min_h, int min_w,
+                 int num_channel, const CancelToken* cancel) {
+  assert(!(raw.empty()));
+  return load(raw.data(), raw.size(), min_h, min_w, num_channel, cancel);
+}
+
+//------------------------------------------------------------------------------
+// 이미지를 raw pointer 데이터에서 (min_h, min_w) 이상의 크기로 load.
+//------------------------------------------------------------------------------
+bool Image::load(const uint8_t* raw, size_t size, int min_h, int min_w,
+                 int num_channel, const CancelToken* cancel) {
+  LoadOptions options(num_channel);
+  options.min_h = min_h;
+  options.min_w = min_w;
+  return load(raw, size, options, cancel);
+}
+
+//------------------------------------------------------------------------------
+// 이미지를 파일에서 options 의 설정으로 load.
+// 파일 전체를 memory 에 mapping 하거나 읽은 뒤 decode 한다. (FileData)
+//------------------------------------------------------------------------------
+bool Image::load(const std::string& filename, const LoadOptions& options,
+                 const CancelToken* cancel) {
+  FileData file;
+  if (!file.open(filename))
+    return stbi__err("can't fopen", "Unable to open file");
+  return load(file.data, file.size, options, cancel);
+}
+
+//------------------------------------------------------------------------------
+// 이미지를 vector 데이터에서 options 의 설정으로 load.
+//------------------------------------------------------------------------------
+bool Image::load(const std::vector<uint8_t>& raw, const LoadOptions& options,
+                 const CancelToken* cancel) {
   assert(!(raw.empty()));
+  return load(raw.data(), raw.size(), options, cancel);
+}
+
+//------------------------------------------------------------------------------
+// 이미지를 raw pointer 데이터에서 options 의 설정으로 load.
+//------------------------------------------------------------------------------
+bool Image::load(const uint8_t* raw, size_t size, const LoadOptions& options,
+                 const CancelToken* cancel) {
+  assert(raw);
+  // stb 는 입력 크기를 int 로 받는다.
+  if (size > static_cast<size_t>(std::numeric_limits<int>::max()))
+    return stbi__err("too large", "Input larger than 2GB");
   int h, w, c;
-  uint8_t* mem = ::stbi_load_from_memory(raw.data(), raw.size(),
-                                         &w, &h, &c, num_channel);
+  int num_channel = options.num_channel;
+  StbCancelScope scope(cancel);
+  StbLoadOptionsScope options_scope(options);
+  int sz = static_cast<int>(size);
+  auto mem = ::stbi_load_from_memory_scaled(raw, sz,  &w, &h, &c, num_channel,
+                                            options.min_w, options.min_h);
   if (!mem) return false;
   if (h <= 0) return false;
   if (w <= 0) return false;
   if (c <= 0) return false;
   if (num_channel != c)
     c = num_channel;
-  std::shared_ptr<uint8_t> p(mem, std::default_delete<uint8_t[]>());
+  // stb 가 malloc 한 memory 이므로 stbi_image_free 로 해제한다.
+  std::shared_ptr<uint8_t> p(mem, ::stbi_image_free);
   Image image(h, w, c, p);
   swap(image);
   return true;
 }
 
 //------------------------------------------------------------------------------
-// 이미지를 raw pointer 데이터에서 로드. data는 binary 포멧임.
+// std::istream 을 읽는 stb callback.
 //------------------------------------------------------------------------------
-bool Image::load(const uint8_t* raw, size_t size, int num_channel) {
-  assert(raw);
-  int h, w, c;
-  int sz = static_cast<int>(size);
-  auto mem = ::stbi_load_from_memory(raw, sz,  &w, &h, &c, num_channel);
+static int stream_read(void* user, char* data, int size) {
+  auto stream = static_cast<std::istream*>(user);
+  stream->read(data, size);
+  return static_cast<int>(stream->gcount());
+}
+
+static void stream_skip(void* user, int n) {
+  static_cast<std::istream*>(user)->ignore(n);
+}
+
+static int stream_eof(void* user) {
+  return static_cast<std::istream*>(user)->eof();
+}
+
+//------------------------------------------------------------------------------
+// file descriptor 를 읽는 stb callback. stb 는 size 보다 적게 읽으면 입력의
+// 끝으로 보므로 pipe 등에서 짧게 읽히면 끝까지 반복한다.
+//------------------------------------------------------------------------------
+struct FdReader {
+  int fd;
+  bool eof;
+};
+
+static int fd_read(void* user, char* data, int size) {
+  auto reader = static_cast<FdReader*>(user);
+  int total = 0;
+  while (total < size && !reader->eof) {
+    ssize_t n = ::read(reader->fd, data + total, size - total);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      reader->eof = true;
+    else
+      total += static_cast<int>(n);
+  }
+  return total;
+}
+
+static void fd_skip(void* user, int n) {
+  auto reader = static_cast<FdReader*>(user);
+  if (::lseek(reader->fd, n, SEEK_CUR) >= 0)
+    return;
+  // pipe 처럼 seek 할 수 없으면 읽어서 버린다.
+  char buf[4096];
+  while (n > 0 && !reader->eof)
+    n -= fd_read(user, buf, std::min(n, static_cast<int>(sizeof(buf))));
+}
+
+static int fd_eof(void* user) {
+  return static_cast<FdReader*>(user)->eof;
+}
+
+//------------------------------------------------------------------------------
+// stb callback 으로 읽으면서 decode 한다. read_buffer byte 의 buffer 를 통해
+// 읽으며 (128 byte 미만이면 stb 의 기본 buffer), 결과는 stbi_image_free 로
+// 해제한다.
+//------------------------------------------------------------------------------
+static uint8_t* load_callbacks(const stbi_io_callbacks& callbacks, void* user,
+                               size_t read_buffer, int* h, int* w,
+                               int num_channel) {
+  int buflen = static_cast<int>(std::min(
+      read_buffer, static_cast<size_t>(std::numeric_limits<int>::max())));
+  std::vector<uint8_t> buffer(std::max(buflen, 1));
+  int c;
+  return ::stbi_load_from_callbacks_buffered(&callbacks, user, buffer.data(),
+                                             buflen, w, h, &c, num_channel);
+}
+
+//------------------------------------------------------------------------------
+// 이미지를 stream 에서 load.
+//------------------------------------------------------------------------------
+bool Image::load(std::istream& stream, int num_channel,
+                 const CancelToken* cancel, size_t read_buffer) {
+  static const stbi_io_callbacks callbacks = {
+    stream_read, stream_skip, stream_eof
+  };
+  int h, w;
+  StbCancelScope scope(cancel);
+  StbLoadOptionsScope options_scope((LoadOptions(num_channel)));
+  auto mem = load_callbacks(callbacks, &stream, read_buffer, &h, &w,
+                            num_channel);
   if (!mem) return false;
-  if (h <= 0) return false;
-  if (w <= 0) return false;
-  if (c <= 0) return false;
-  if (num_channel != c)
-    c = num_channel;
-  std::shared_ptr<uint8_t> p(mem, std::default_delete<uint8_t[]>());
-  Image image(h, w, c, p);
+  std::shared_ptr<uint8_t> p(mem, ::stbi_image_free);
+  if (h <= 0 || w <= 0) return false;
+  Image image(h, w, num_channel, p);
+  swap(image);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// 이미지를 file descriptor 에서 load. fd 는 닫지 않는다.
+//------------------------------------------------------------------------------
+bool Image::loadFd(int fd, int num_channel, const CancelToken* cancel,
+                   size_t read_buffer) {
+  static const stbi_io_callbacks callbacks = {
+    fd_read, fd_skip, fd_eof
+  };
+  FdReader reader = {fd, false};
+  int h, w;
+  StbCancelScope scope(cancel);
+  StbLoadOptionsScope options_scope((LoadOptions(num_channel)));
+  auto mem = load_callbacks(callbacks, &reader, read_buffer, &h, &w,
+                            num_channel);
+  if (!mem) return false;
+  std::shared_ptr<uint8_t> p(mem, ::stbi_image_free);
+  if (h <= 0 || w <= 0) return false;
+  Image image(h, w, num_channel, p);
   swap(image);
   return true;
 }
 
+//------------------------------------------------------------------------------
+// 이미지를 파일에서 load. 이미지의 buffer 를 재사용한다.
+//------------------------------------------------------------------------------
+bool Image::loadInto(const std::string& filename, int num_channel,
+                     const CancelToken* cancel) {
+  FileData file;
+  if (!file.open(filename))
+    return stbi__err("can't fopen", "Unable to open file");
+  return loadInto(file.data, file.size, num_channel, cancel);
+}
+
+//------------------------------------------------------------------------------
+// 이미지를 vector 데이터에서 load. 이미지의 buffer 를 재사용한다.
+//------------------------------------------------------------------------------
+bool Image::loadInto(const std::vector<uint8_t>& raw, int num_channel,
+                     const CancelToken* cancel) {
+  return loadInto(raw.data(), raw.size(), num_channel, cancel);
+}
+
+//------------------------------------------------------------------------------
+// 이미지를 raw pointer 데이터에서 load. 이미지의 buffer 를 재사용한다.
+// header 에서 크기를 먼저 읽어 buffer 가 충분한지 확인한다.
+//------------------------------------------------------------------------------
+bool Image::loadInto(const uint8_t* raw, size_t size, int num_channel,
+                     const CancelToken* cancel) {
+  ImageInfo info;
+  if (num_channel < 1 || num_channel > 4 || !probe(raw, size, &info))
+    return false;
+  size_t need = static_cast<size_t>(info.h) * info.w * num_channel;
+  if (pdata_ && pdata_.use_count() == 1 && need <= capacity_) {
+    int h, w;
+    size_t stride = static_cast<size_t>(info.w) * num_channel;
+    if (!decodeInto(raw, size, pdata_.get(), stride, info.h, info.w,
+                    num_channel, &h, &w, cancel))
+      return false;
+    h_ = h;
+    w_ = w;
+    c_ = num_channel;
+    return true;
+  }
+  Image image(info.h, info.w, num_channel);
+  if (!decodeInto(raw, size, image.get(), image.w() * image.c(), image.h(),
+                  image.w(), num_channel, nullptr, nullptr, cancel))
+    return false;
+  swap(image);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// vector 데이터를 dst 에 decode.
+//------------------------------------------------------------------------------
+bool Image::decodeInto(const std::vector<uint8_t>& raw,
+                       uint8_t* dst, size_t stride, int h, int w,
+                       int num_channel, int* out_h, int* out_w,
+                       const CancelToken* cancel) {
+  return decodeInto(raw.data(), raw.size(), dst, stride, h, w, num_channel,
+                    out_h, out_w, cancel);
+}
+
+//------------------------------------------------------------------------------
+// raw pointer 데이터를 dst 에 decode.
+//------------------------------------------------------------------------------
+bool Image::decodeInto(const uint8_t* raw, size_t size,
+                       uint8_t* dst, size_t stride, int h, int w,
+                       int num_channel, int* out_h, int* out_w,
+                       const CancelToken* cancel) {
+  assert(dst);
+  const size_t max_int = static_cast<size_t>(std::numeric_limits<int>::max());
+  if (!raw || size == 0 || size > max_int || stride > max_int ||
+      h <= 0 || w <= 0)
+    return false;
+  int x, y, c;
+  StbCancelScope scope(cancel);
+  StbLoadOptionsScope options_scope((LoadOptions(num_channel)));
+  if (!::stbi_load_from_memory_into(raw, static_cast<int>(size), dst,
+                                    static_cast<int>(stride), w, h,
+                                    &x, &y, &c, num_channel, 0, 0))
+    return false;
+  if (out_h) *out_h = y;
+  if (out_w) *out_w = x;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// stbi__context 의 header 정보. reset 은 context 를 입력의 처음으로 되돌린다.
+// stbi__info_main 과 같은 순서로 형식을 확인하고, 형식별로 header 를 다시
+// 읽어 bit depth, progressive, interlace 를 구한다.
+//------------------------------------------------------------------------------
+static bool stb_probe(const std::function<void(stbi__context*)>& reset,
+                      ImageInfo* info) {
+  stbi__context s;
+  int w, h, c;
+  ImageInfo result;
+  reset(&s);
+  if (stbi__jpeg_info(&s, &w, &h, &c))
+    result.format = ImageFormat::kJpeg;
+  else if (stbi__png_info(&s, &w, &h, &c))
+    result.format = ImageFormat::kPng;
+  else if (stbi__gif_info(&s, &w, &h, &c))
+    result.format = ImageFormat::kGif;
+  else if (stbi__bmp_info(&s, &w, &h, &c))
+    result.format = ImageFormat::kBmp;
+  else if (stbi__psd_info(&s, &w, &h, &c))
+    result.format = ImageFormat::kPsd;
+  else if (stbi__pic_info(&s, &w, &h, &c))
+    result.format = ImageFormat::kPic;
+  else if (stbi__pnm_info(&s, &w, &h, &c))
+    result.format = ImageFormat::kPnm;
+  else if (stbi__hdr_info(&s, &w, &h, &c))
+    result.format = ImageFormat::kHdr;
+  else if (stbi__tga_info(&s, &w, &h, &c))
+    result.format = ImageFormat::kTga;
+  else
+    return false;
+  if (h <= 0 || w <= 0 || c <= 0)
+    return false;
+  result.h = h;
+  result.w = w;
+  result.c = c;
+  result.bit_depth = 8;
+
+  reset(&s);
+  switch (result.format) {
+    case ImageFormat::kJpeg: {
+      // SOF marker 까지만 읽는다.
+      std::unique_ptr<stbi__jpeg, decltype(&free)> j(
+          static_cast<stbi__jpeg*>(malloc(sizeof(stbi__jpeg))), &free);
+      if (!j)
+        return false;
+      j->s = &s;
+      if (!stbi__decode_jpeg_header(j.get(), STBI__SCAN_header))
+        return false;
+      result.progressive = j->progressive != 0;
+      break;
+    }
+    case ImageFormat::kPng: {
+      // IHDR 까지 chunk 를 건너뛴다. (iPhone PNG 는 CgBI chunk 가 먼저 온다)
+      // width, height 다음이 bit depth, color type, compression, filter,
+      // interlace 이다. palette PNG 는 index 가 아니라 palette 의 8bit 값이
+      // 출력되므로 bit_depth 를 8 로 둔다.
+      if (!stbi__check_png_header(&s))
+        return false;
+      for (;;) {
+        stbi__pngchunk chunk = stbi__get_chunk_header(&s);
+        if (stbi__at_eof(&s))
+          return false;
+        if (chunk.type == STBI__PNG_TYPE('I','H','D','R'))
+          break;
+        if (chunk.type != STBI__PNG_TYPE('C','g','B','I'))
+          return false;
+        stbi__skip(&s, static_cast<int>(chunk.length));
+        stbi__get32be(&s);  // CRC
+      }
+      stbi__skip(&s, 8);
+      int depth = stbi__get8(&s);
+      int color = stbi__get8(&s);
+      stbi__skip(&s, 2);
+      result.bit_depth = color == 3 ? 8 : depth;
+      result.interlaced = stbi__get8(&s) == 1;
+      break;
+    }
+    case ImageFormat::kHdr:
+      result.bit_depth = 32;
+      break;
+    default:
+      if (stbi__is_16_main(&s))
+        result.bit_depth = 16;
+      break;
+  }
+  *info = result;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// 파일의 header 정보. 파일은 header 까지만 읽는다.
+//------------------------------------------------------------------------------
+bool Image::probe(const std::string& filename, ImageInfo* info) {
+  assert(info);
+  std::unique_ptr<FILE, decltype(&fclose)> f(
+      stbi__fopen(filename.c_str(), "rb"), &fclose);
+  if (!f)
+    return false;
+  return stb_probe([&](stbi__context* s) {
+    fseek(f.get(), 0, SEEK_SET);
+    stbi__start_file(s, f.get());
+  }, info);
+}
+
+//------------------------------------------------------------------------------
+// vector 데이터의 header 정보.
+//------------------------------------------------------------------------------
+bool Image::probe(const std::vector<uint8_t>& raw, ImageInfo* info) {
+  return probe(raw.data(), raw.size(), info);
+}
+
+//------------------------------------------------------------------------------
+// raw pointer 데이터의 header 정보.
+//------------------------------------------------------------------------------
+bool Image::probe(const uint8_t* raw, size_t size, ImageInfo* info) {
+  assert(info);
+  if (!raw || size == 0 ||
+      size > static_cast<size_t>(std::numeric_limits<int>::max()))
+    return false;
+  return stb_probe([&](stbi__context* s) {
+    stbi__start_mem(s, raw, static_cast<int>(size));
+  }, info);
+}
+
 //------------------------------------------------------------------------------
 // 이미지 정보를 문자열로 출력.
 //------------------------------------------------------------------------------
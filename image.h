@@ -13,8 +13,119 @@
 
 #include <iostream>
 
+#include "resize.h"
+
 namespace sas {
 
+//------------------------------------------------------------------------------
+// @struct GridSpec
+//------------------------------------------------------------------------------
+// Image::compose() 에서 사용하는 grid 배치 정보.
+// (rows x cols) 개의 cell 을 padding 간격으로 배치하며,
+// 각 cell 의 크기는 (cell_h, cell_w), 빈 영역은 background 값으로 채운다.
+//------------------------------------------------------------------------------
+struct GridSpec {
+  int rows;
+  int cols;
+  int cell_h;
+  int cell_w;
+  int padding;
+  int channel;
+  uint8_t background;
+  bool keep_ratio;  // true 이면 비율을 유지하여 cell 중앙에 배치한다.
+  ResizeOptions resize;  // cell 크기로 resize 할 때의 설정.
+
+  GridSpec(int rows, int cols, int cell_h, int cell_w, int padding=0,
+           uint8_t background=0xFF)
+      : rows{rows}, cols{cols}, cell_h{cell_h}, cell_w{cell_w},
+        padding{padding}, channel{3}, background{background},
+        keep_ratio{false}, resize{} {}
+};
+
+//------------------------------------------------------------------------------
+// Image::buildPyramid() 에서 사용하는 2x 축소 필터.
+//------------------------------------------------------------------------------
+enum class PyramidFilter {
+  kBox,       // 2x2 평균.
+  kGaussian,  // [1 3 3 1]/8 separable 필터. aliasing 이 적다.
+};
+
+//------------------------------------------------------------------------------
+// 이미지 파일 형식. (stb_image 가 읽을 수 있는 형식)
+//------------------------------------------------------------------------------
+enum class ImageFormat {
+  kUnknown,
+  kJpeg,
+  kPng,
+  kGif,
+  kBmp,
+  kPsd,
+  kPic,
+  kPnm,
+  kHdr,
+  kTga,
+};
+
+//------------------------------------------------------------------------------
+// @struct ImageInfo
+//------------------------------------------------------------------------------
+// Image::probe() 가 header 에서 읽은 정보. c 는 파일의 channel 수이며
+// (palette PNG 는 palette 의 channel 수), bit_depth 는 channel 당 bit 수이다.
+// (HDR 은 32, palette PNG 는 index bit 수와 관계없이 palette 값의 8)
+//------------------------------------------------------------------------------
+struct ImageInfo {
+  ImageFormat format;
+  int h;
+  int w;
+  int c;
+  int bit_depth;
+  bool progressive;  // progressive JPEG.
+  bool interlaced;   // Adam7 interlaced PNG.
+
+  ImageInfo()
+      : format{ImageFormat::kUnknown}, h{0}, w{0}, c{0}, bit_depth{0},
+        progressive{false}, interlaced{false} {}
+};
+
+//------------------------------------------------------------------------------
+// @struct LoadOptions
+//------------------------------------------------------------------------------
+// Image::load() 의 decode 설정. stb_image 의 전역 설정 대신 호출마다
+// 적용되므로, 여러 thread 가 서로 다른 설정으로 동시에 load 할 수 있다.
+// (min_h, min_w) 는 thumbnail 용 축소 decode 의 최소 크기이다. (0 이면 원래 크기)
+//------------------------------------------------------------------------------
+struct LoadOptions {
+  int num_channel;
+  int min_h;
+  int min_w;
+  bool flip_vertically;     // 아래 row 부터 저장한다.
+  bool convert_iphone_png;  // iPhone 용 PNG (CgBI) 의 BGR 을 RGB 로 바꾼다.
+  bool unpremultiply;       // convert_iphone_png 일 때 alpha 를 곱하기 전 값으로.
+
+  LoadOptions(int num_channel=3)
+      : num_channel{num_channel}, min_h{0}, min_w{0}, flip_vertically{false},
+        convert_iphone_png{false}, unpremultiply{false} {}
+};
+
+//------------------------------------------------------------------------------
+// @struct SaveOptions
+//------------------------------------------------------------------------------
+// Image::savePng(), saveJpg() 의 encode 설정. stb_image_write 의 전역 설정
+// 대신 호출마다 적용된다.
+//------------------------------------------------------------------------------
+struct SaveOptions {
+  int jpg_quality;            // 1 ~ 100.
+  int png_compression_level;  // zlib level. 클수록 작고 느리다.
+  int png_filter;             // 0 ~ 4 이면 모든 row 에 사용, -1 이면 row 마다 선택.
+  int jpg_restart_interval;   // 0 이 아니면 8x8 MCU 마다 RSTn marker 를 넣는다.
+                              // (load 시 marker 단위로 병렬 decode 된다)
+  bool flip_vertically;       // 아래 row 부터 저장한다.
+
+  SaveOptions()
+      : jpg_quality{100}, png_compression_level{8}, png_filter{-1},
+        jpg_restart_interval{0}, flip_vertically{false} {}
+};
+
 //------------------------------------------------------------------------------
 // @class Image
 //------------------------------------------------------------------------------
@@ -31,6 +142,9 @@ struct Image {
   // shared_ptr 포맷을 쓰도록 한다. 실제로는 uint8_t array 포인터이다.
   // pdata_를 array 포인터로 사용하기 위해 연결마다 deleter를 설정해준다.
   std::shared_ptr<uint8_t> pdata_;
+  // pdata_ 에 할당된 byte 수. loadInto 는 크기가 작은 이미지를 load 한
+  // 뒤에도 이 크기까지 buffer 를 재사용한다.
+  size_t capacity_;
 
  public:
   Image();
@@ -83,25 +197,65 @@ struct Image {
 
  public:
   bool isSameSize(const Image& img) const;
-  void resize(int new_h, int new_w);  // height, width 길이를 변경한다.
-  void resizeHeight(int new_h);  // height 길이를 변경한다.
-  void resizeWidth(int new_w);  // width 길이를 변경한다.
+  // options 로 필터, 가장자리 처리, 색 공간을 정한다. (ResizeOptions 참고)
+  // 미리보기처럼 품질보다 속도가 중요하면 ResizeOptions::fast() 를 사용한다.
+  // cancel 이 취소되면 이미지를 바꾸지 않고 false 를 반환한다.
+  bool resize(int new_h, int new_w,  // height, width 길이를 변경한다.
+              const ResizeOptions& options=ResizeOptions(),
+              const CancelToken* cancel=nullptr);
+  bool resizeHeight(int new_h,  // height 길이를 변경한다.
+                    const ResizeOptions& options=ResizeOptions(),
+                    const CancelToken* cancel=nullptr);
+  bool resizeWidth(int new_w,  // width 길이를 변경한다.
+                   const ResizeOptions& options=ResizeOptions(),
+                   const CancelToken* cancel=nullptr);
 
-  bool resizeTo(Image* target) const;  // target 크기로 resize 하여 전
+  bool resizeTo(Image* target,
+                const ResizeOptions& options=ResizeOptions(),
+                const CancelToken* cancel=nullptr) const;  // target 크기로 resize 하여 전
 
   // w/h 중 작은 쪽을 기준으로 new_size 크기로 변경한다.
-  void resizeOnSmallerSide(int new_size);
+  bool resizeOnSmallerSide(int new_size,
+                           const ResizeOptions& options=ResizeOptions(),
+                           const CancelToken* cancel=nullptr);
 
   // w/h 중 큰 쪽을 기준으로 new_size 크기로 변경한다.
-  void resizeOnLargerSide(int new_size);
+  bool resizeOnLargerSide(int new_size,
+                          const ResizeOptions& options=ResizeOptions(),
+                          const CancelToken* cancel=nullptr);
+
+  // 1/2, 1/4, ... 크기의 이미지를 levels 개 만들어 반환한다. (mip-chain)
+  // 각 level 은 이전 level 로부터 2x 축소되며, 모든 level 의 데이터는
+  // 하나의 연속된 메모리를 공유한다. 1x1 에 도달하면 더 만들지 않는다.
+  std::vector<Image> buildPyramid(
+      int levels, PyramidFilter filter=PyramidFilter::kBox) const;
 
  public:
   // Image 크기가 (w_, h_, 1)인 이미지 채널별 이미지 feature 를 반환.
   Image layer(int z) const;
   std::vector<Image> layers() const;
 
+ public:
+  // 세로(kernel_h), 가로(kernel_w) 1D kernel 로 separable convolution 수행.
+  // kernel 의 중심은 size/2 위치이다. 고정소수점으로 계산하며, 정밀도는
+  // kernel 의 계수 크기에 맞춰 정한다. (sharpen 처럼 절대값 합이 큰 kernel 포함)
+  // kernel 이 비어 있으면 false 를 반환한다.
+  bool convolve(const std::vector<float>& kernel_h,
+                const std::vector<float>& kernel_w,
+                EdgeMode edge=EdgeMode::kClamp);
+  bool gaussianBlur(float sigma, EdgeMode edge=EdgeMode::kClamp);
+
+  // src + amount * (src - blur). 차이가 threshold 미만인 pixel 은 유지한다.
+  bool unsharpMask(float sigma, float amount, int threshold=0,
+                   EdgeMode edge=EdgeMode::kClamp);
+
  public:
   void stamp(const Image& img, int x, int y);
+
+  // images 를 spec 의 grid 에 맞게 resize 하여 하나의 이미지로 합친다.
+  // cell 단위로 병렬 처리되며, i 번째 이미지는 (i / cols, i % cols) 에 놓인다.
+  static Image compose(const GridSpec& spec, const std::vector<Image>& images);
+
   void addBorder(int h_border, int w_border, uint8_t pxl=0x00);
   void addBoxBorder(int border, uint8_t pxl=0x00);
   bool crop(int h, int w, int x, int y);
@@ -112,17 +266,117 @@ struct Image {
   float aspectRatio() const;
 
  public:
-  bool savePng(const std::string& filename) const;
-  bool savePng(std::vector<uint8_t>* buffer) const;
-  bool savePng(uint8_t* buffer, int size) const;
-  bool saveJpg(const std::string& filename) const;
-  bool saveJpg(std::vector<uint8_t>* buffer) const;
-  bool saveJpg(uint8_t* buffer, int size) const;
+  // cancel 이 취소되면 encode 를 row 단위에서 멈추고 false 를 반환한다.
+  // (파일에 저장하던 경우 기록 중이던 파일은 지운다)
+  bool savePng(const std::string& filename,
+               const CancelToken* cancel=nullptr) const;
+  bool savePng(std::vector<uint8_t>* buffer,
+               const CancelToken* cancel=nullptr) const;
+  bool savePng(uint8_t* buffer, int size,
+               const CancelToken* cancel=nullptr) const;
+  bool saveJpg(const std::string& filename,
+               const CancelToken* cancel=nullptr) const;
+  bool saveJpg(std::vector<uint8_t>* buffer,
+               const CancelToken* cancel=nullptr) const;
+  bool saveJpg(uint8_t* buffer, int size,
+               const CancelToken* cancel=nullptr) const;
+
+  // options 로 encode 설정을 정한다. (SaveOptions 참고)
+  // buffer 크기 인자가 있는 경우 결과가 size 보다 크면 false.
+  bool savePng(const std::string& filename, const SaveOptions& options,
+               const CancelToken* cancel=nullptr) const;
+  bool savePng(std::vector<uint8_t>* buffer, const SaveOptions& options,
+               const CancelToken* cancel=nullptr) const;
+  bool savePng(uint8_t* buffer, int size, const SaveOptions& options,
+               const CancelToken* cancel=nullptr) const;
+  bool saveJpg(const std::string& filename, const SaveOptions& options,
+               const CancelToken* cancel=nullptr) const;
+  bool saveJpg(std::vector<uint8_t>* buffer, const SaveOptions& options,
+               const CancelToken* cancel=nullptr) const;
+  bool saveJpg(uint8_t* buffer, int size, const SaveOptions& options,
+               const CancelToken* cancel=nullptr) const;
+
+  // cancel 이 취소되면 decode 를 row (JPEG 는 MCU row) 단위에서 멈추고
+  // decode buffer 를 해제한 뒤 false 를 반환한다. 이미지는 바뀌지 않는다.
+  // interlace 되지 않은 PNG 는 압축 해제한 전체 data 를 만들지 않고,
+  // row 묶음 단위로 다음 묶음의 inflate 와 현재 묶음의 unfilter 를
+  // ThreadPool 에서 동시에 처리한다.
+  bool load(const std::string& filename, int num_channel=3,
+            const CancelToken* cancel=nullptr);
+  bool load(const std::vector<uint8_t>& raw,  int num_channel=3,
+            const CancelToken* cancel=nullptr);
+  bool load(const uint8_t* raw, size_t size, int num_channel=3,
+            const CancelToken* cancel=nullptr);
+
+  // thumbnail 용 load. JPEG 는 크기가 (min_h, min_w) 이상인 가장 작은
+  // 1/2, 1/4, 1/8 배율로 decode 하며 (8x8 IDCT 대신 4x4, 2x2, DC 만 계산),
+  // 결과 크기는 입력 크기를 배율로 나누어 올림한 값이다.
+  // 다른 형식은 원래 크기로 load 한다. 정확한 크기가 필요하면 이후 resize 한다.
+  bool load(const std::string& filename, int min_h, int min_w,
+            int num_channel=3, const CancelToken* cancel=nullptr);
+  bool load(const std::vector<uint8_t>& raw, int min_h, int min_w,
+            int num_channel=3, const CancelToken* cancel=nullptr);
+  bool load(const uint8_t* raw, size_t size, int min_h, int min_w,
+            int num_channel=3, const CancelToken* cancel=nullptr);
+
+  // options 로 channel 수, 축소 decode 크기, decode 설정을 정한다.
+  // (LoadOptions 참고) 다른 load 함수는 기본 설정 (LoadOptions) 을 사용한다.
+  bool load(const std::string& filename, const LoadOptions& options,
+            const CancelToken* cancel=nullptr);
+  bool load(const std::vector<uint8_t>& raw, const LoadOptions& options,
+            const CancelToken* cancel=nullptr);
+  bool load(const uint8_t* raw, size_t size, const LoadOptions& options,
+            const CancelToken* cancel=nullptr);
+
+  // 현재 thread 에서 마지막으로 실패한 load 의 이유. (stb 의 failure reason)
+  // load 가 false 를 반환한 직후에만 의미가 있다. 다른 thread 의 load 에
+  // 영향을 받지 않는다.
+  static const char* lastError();
+
+  // stream 이나 file descriptor 에서 읽으면서 decode 한다. (pipe, socket 처럼
+  // 크기를 미리 알 수 없는 입력) 입력은 read_buffer byte 단위로 읽으며,
+  // decode 후 stream 과 fd 의 위치는 이미지의 끝보다 뒤일 수 있다.
+  // memory 입력과 달리 JPEG restart interval 을 병렬로 decode 하지 않는다.
+  static const size_t kReadBufferSize = 64 * 1024;
+  bool load(std::istream& stream, int num_channel=3,
+            const CancelToken* cancel=nullptr,
+            size_t read_buffer=kReadBufferSize);
+  bool loadFd(int fd, int num_channel=3, const CancelToken* cancel=nullptr,
+              size_t read_buffer=kReadBufferSize);
+
+  // load 와 같지만 이미지의 buffer 를 재사용한다. 다른 Image 와 공유하지 않는
+  // buffer 의 할당 크기가 결과보다 크거나 같으면 새로 할당하지 않고 그 자리에 decode 한다.
+  // (요청마다 같은 Image 를 재사용하는 경우) 실패하면 크기는 그대로이지만
+  // pixel 값은 정해지지 않는다.
+  bool loadInto(const std::string& filename, int num_channel=3,
+                const CancelToken* cancel=nullptr);
+  bool loadInto(const std::vector<uint8_t>& raw, int num_channel=3,
+                const CancelToken* cancel=nullptr);
+  bool loadInto(const uint8_t* raw, size_t size, int num_channel=3,
+                const CancelToken* cancel=nullptr);
 
+  // dst 에 직접 decode 한다. dst 는 stride byte 간격의 row h 개이며 각 row 에
+  // w * num_channel byte 이상이 있어야 한다. (batch tensor 의 slice 등)
+  // 이미지는 왼쪽 위에 놓이고 나머지 영역의 값은 정해지지 않는다.
+  // 이미지가 (h, w) 보다 크면 false. decode 한 크기는 out_h, out_w 에 저장한다.
+  // JPEG 는 decoder 가 dst 에 바로 쓰고, 다른 형식은 decode 후 한 번 복사한다.
+  static bool decodeInto(const std::vector<uint8_t>& raw,
+                         uint8_t* dst, size_t stride, int h, int w,
+                         int num_channel=3, int* out_h=nullptr,
+                         int* out_w=nullptr,
+                         const CancelToken* cancel=nullptr);
+  static bool decodeInto(const uint8_t* raw, size_t size,
+                         uint8_t* dst, size_t stride, int h, int w,
+                         int num_channel=3, int* out_h=nullptr,
+                         int* out_w=nullptr,
+                         const CancelToken* cancel=nullptr);
 
-  bool load(const std::string& filename, int num_channel=3);
-  bool load(const std::vector<uint8_t>& raw,  int num_channel=3);
-  bool load(const uint8_t* raw, size_t size, int num_channel=3);
+  // header 만 읽어 형식, 크기, channel, bit depth 를 확인한다.
+  // pixel data 는 decode 하지 않으므로 load 전에 요청을 거르는 데 사용한다.
+  // 읽을 수 없는 형식이거나 header 가 잘못되었으면 false.
+  static bool probe(const std::string& filename, ImageInfo* info);
+  static bool probe(const std::vector<uint8_t>& raw, ImageInfo* info);
+  static bool probe(const uint8_t* raw, size_t size, ImageInfo* info);
 
  public:
   std::string str() const;
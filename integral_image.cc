@@ -0,0 +1,148 @@
+//------------------------------------------------------------------------------
+// @file integral_image.cc
+//------------------------------------------------------------------------------
+#include "integral_image.h"
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace sas {
+
+//------------------------------------------------------------------------------
+// 빈 table 을 생성한다.
+//------------------------------------------------------------------------------
+template <typename T>
+BasicIntegralImage<T>::BasicIntegralImage() : h_{0}, w_{0}, c_{0} {
+}
+
+//------------------------------------------------------------------------------
+// image 로부터 table 을 생성한다.
+//------------------------------------------------------------------------------
+template <typename T>
+BasicIntegralImage<T>::BasicIntegralImage(const Image& image)
+    : h_{0}, w_{0}, c_{0} {
+  build(image);
+}
+
+//------------------------------------------------------------------------------
+// table 초기화
+//------------------------------------------------------------------------------
+template <typename T>
+void BasicIntegralImage<T>::clear() {
+  h_ = w_ = c_ = 0;
+  table_.clear();
+}
+
+//------------------------------------------------------------------------------
+// summed-area table 생성.
+// 이미지를 row band 로 나누어 band 마다 독립적으로 table 을 만든 뒤,
+// 앞선 band 들의 마지막 row 합(carry)을 각 band 에 더해 완성한다.
+// carry 계산은 band 수 만큼의 row 연산이므로 전체 비용에 비해 작다.
+//------------------------------------------------------------------------------
+template <typename T>
+bool BasicIntegralImage<T>::build(const Image& image) {
+  clear();
+  if (image.empty())
+    return false;
+
+  h_ = image.h();
+  w_ = image.w();
+  c_ = image.c();
+  const size_t stride = static_cast<size_t>(w_ + 1) * c_;
+  const size_t in_stride = static_cast<size_t>(w_) * c_;
+  table_.assign(stride * (h_ + 1), 0);
+
+  auto& pool = ThreadPool::instance();
+  // band 가 너무 작으면 carry 를 더하는 비용이 상대적으로 커진다.
+  static const int min_band_rows = 64;
+  int num_bands = std::max(1, std::min(pool.concurrency(), h_ / min_band_rows));
+  int band_rows = (h_ + num_bands - 1) / num_bands;
+  num_bands = (h_ + band_rows - 1) / band_rows;
+
+  const uint8_t* src = image.get();
+  T* table = table_.data();
+
+  // 1) band 별 local table. band 의 첫 row 는 0 row 를 위로 가정한다.
+  pool.parallelFor(num_bands, [&](int b) {
+    auto x0 = b * band_rows;
+    auto x1 = std::min(h_, x0 + band_rows);
+    std::vector<T> acc(c_);
+    for (int x=x0; x<x1; x++) {
+      const uint8_t* in = src + x * in_stride;
+      T* out = table + (x + 1) * stride + c_;
+      std::fill(acc.begin(), acc.end(), 0);
+      for (size_t i=0; i<in_stride; i+=c_) {
+        for (int z=0; z<c_; z++) {
+          acc[z] += in[i + z];
+          out[i + z] = acc[z];
+        }
+      }
+      if (x > x0) {
+        const T* up = out - stride;
+        for (size_t i=0; i<in_stride; i++)
+          out[i] += up[i];
+      }
+    }
+  });
+  if (num_bands == 1)
+    return true;
+
+  // 2) band 별 carry. band b 의 carry 는 band 0..b-1 의 마지막 row 합이다.
+  std::vector<T> carries(stride * num_bands, 0);
+  for (int b=1; b<num_bands; b++) {
+    const T* last = table + static_cast<size_t>(b * band_rows) * stride;
+    const T* prev = carries.data() + (b - 1) * stride;
+    T* carry = carries.data() + b * stride;
+    for (size_t i=0; i<stride; i++)
+      carry[i] = prev[i] + last[i];
+  }
+
+  // 3) carry 를 band 의 모든 row 에 더한다.
+  pool.parallelFor(num_bands - 1, [&](int i) {
+    auto b = i + 1;
+    auto x0 = b * band_rows;
+    auto x1 = std::min(h_, x0 + band_rows);
+    const T* carry = carries.data() + b * stride;
+    for (int x=x0; x<x1; x++) {
+      T* out = table + (x + 1) * stride;
+      for (size_t k=0; k<stride; k++)
+        out[k] += carry[k];
+    }
+  });
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// (x, y) 에서 시작하는 (h, w) 영역의 z 채널 합. (범위 밖은 잘라낸다)
+//------------------------------------------------------------------------------
+template <typename T>
+T BasicIntegralImage<T>::sum(int x, int y, int h, int w, int z) const {
+  if (empty() || z < 0 || z >= c_)
+    return 0;
+  auto x0 = std::max(x, 0);
+  auto y0 = std::max(y, 0);
+  auto x1 = std::min(x + h, h_);
+  auto y1 = std::min(y + w, w_);
+  if (x0 >= x1 || y0 >= y1)
+    return 0;
+  return at(x1, y1, z) - at(x0, y1, z) - at(x1, y0, z) + at(x0, y0, z);
+}
+
+//------------------------------------------------------------------------------
+// (x, y) 에서 시작하는 (h, w) 영역의 z 채널 평균. (범위 밖은 잘라낸다)
+//------------------------------------------------------------------------------
+template <typename T>
+float BasicIntegralImage<T>::mean(int x, int y, int h, int w, int z) const {
+  auto x0 = std::max(x, 0);
+  auto y0 = std::max(y, 0);
+  auto x1 = std::min(x + h, h_);
+  auto y1 = std::min(y + w, w_);
+  if (x0 >= x1 || y0 >= y1)
+    return 0.0f;
+  auto area = static_cast<double>(x1 - x0) * (y1 - y0);
+  return static_cast<float>(sum(x0, y0, x1 - x0, y1 - y0, z) / area);
+}
+
+template class BasicIntegralImage<uint32_t>;
+template class BasicIntegralImage<uint64_t>;
+
+}  // namespace sas
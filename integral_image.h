@@ -0,0 +1,63 @@
+//------------------------------------------------------------------------------
+// @file util/integral_image.h
+//------------------------------------------------------------------------------
+#ifndef SAS_CATEGORY_UTIL_INTEGRAL_IMAGE_H_
+#define SAS_CATEGORY_UTIL_INTEGRAL_IMAGE_H_
+#include <cstdint>
+#include <vector>
+
+#include "image.h"
+
+namespace sas {
+
+//------------------------------------------------------------------------------
+// @class BasicIntegralImage
+//------------------------------------------------------------------------------
+// Image 의 summed-area table. 임의의 사각 영역 합을 O(1) 에 구한다.
+// 내부 table 은 (h+1, w+1, c) 크기이며 첫 row/column 은 0 이다.
+//
+// T 는 unsigned 누적 타입이다. 누적 중 overflow 가 나더라도 modular 연산이므로
+// 질의한 영역의 합이 T 범위 안이면 결과는 정확하다.
+// 즉, uint32_t 는 영역 넓이가 2^32/255 (약 1600만 pixel) 미만일 때 정확하다.
+//------------------------------------------------------------------------------
+template <typename T>
+class BasicIntegralImage {
+ private:
+  int h_;  // height
+  int w_;  // width
+  int c_;  // channel
+  std::vector<T> table_;
+
+ public:
+  BasicIntegralImage();
+  explicit BasicIntegralImage(const Image& image);
+
+ public:
+  bool build(const Image& image);
+  bool empty() const { return table_.empty(); }
+  void clear();
+
+  int h() const { return h_; }
+  int w() const { return w_; }
+  int c() const { return c_; }
+
+ public:
+  // (x, y) 를 시작으로 하는 (h, w) 크기 영역의 z 채널 합.
+  // 이미지 범위를 벗어나는 부분은 잘라내고 계산한다.
+  T sum(int x, int y, int h, int w, int z) const;
+
+  // sum() 과 같은 영역의 평균. 영역이 비어 있으면 0 을 반환한다.
+  float mean(int x, int y, int h, int w, int z) const;
+
+ private:
+  // table 의 (x, y, z) 위치 값. x, y 는 [0, h], [0, w] 범위이다.
+  T at(int x, int y, int z) const {
+    return table_[(static_cast<size_t>(x) * (w_ + 1) + y) * c_ + z];
+  }
+};
+
+typedef BasicIntegralImage<uint32_t> IntegralImage;
+typedef BasicIntegralImage<uint64_t> IntegralImage64;
+
+}  // namespace sas
+#endif  // SAS_CATEGORY_UTIL_INTEGRAL_IMAGE_H_
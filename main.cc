@@ -1,13 +1,59 @@
 #include "image.h"
+#include "integral_image.h"
+#include "thread_pool.h"
+
+// resize 결과를 원래 stbir 함수와 비교한다.
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#define STB_IMAGE_RESIZE_STATIC
+#include "stb_image_resize.h"
+
+// JPEG decode 결과를 병렬 decode, AVX2 kernel 이 없는 stb_image 와 비교한다.
+#define STB_IMAGE_IMPLEMENTATION
+#define STB_IMAGE_STATIC
+#define STBI_ONLY_JPEG
+#define STBI_NO_AVX2
+#include "stb_image.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <numeric>
 #include <string>
+#include <thread>
+#include <vector>
 #include <iostream>
 
 using namespace sas;
 
+//------------------------------------------------------------------------------
+// 확인 결과를 "(ok)", "(FAIL)" 로 출력한다. 하나라도 실패하면 main 은 1 을
+// 반환한다.
+//------------------------------------------------------------------------------
+static int failures = 0;
+
+static void report(const std::string& name, bool ok) {
+  std::cout << name << (ok ? " (ok)" : " (FAIL)") << std::endl;
+  if (!ok)
+    failures++;
+}
+
 int main() {
   std::string org_path = "./image.jpeg";
 
 
+  // header 정보
+  ImageInfo info;
+  if (Image::probe(org_path, &info)) {
+    std::cout << "probe " << info.h << "x" << info.w << "x" << info.c
+              << " (" << info.bit_depth << "bit)" << std::endl;
+  }
+
   // 생성
   Image img;
   img.load(org_path);
@@ -25,6 +71,381 @@ int main() {
   img.resize(200, 200);
   img.saveJpg("images/resize_200_200.jpg");
 
+  std::cout << "resize 200x300 (fast)" << std::endl;
+  Image preview(org_path);
+  preview.resize(200, 300, ResizeOptions::fast());
+  preview.saveJpg("images/resize_200_300_fast.jpg");
+
+  // 축소 decode (JPEG 1/2 ~ 1/8)
+  Image thumb;
+  thumb.load(org_path, 100, 100);
+  std::cout << "scaled load " << thumb.h() << "x" << thumb.w() << std::endl;
+  thumb.saveJpg("images/scaled_load.jpg");
+
+  // 같은 Image 에 다시 load 하면 buffer 를 재사용하고, stride 가 있는
+  // buffer 에 decode 한 결과도 load 와 같아야 한다.
+  Image loaded(org_path);
+  Image reuse;
+  reuse.loadInto(org_path);
+  const uint8_t* reuse_buf = reuse.get();
+  bool reused = reuse.loadInto(org_path) && reuse.get() == reuse_buf &&
+      std::equal(reuse.get(), reuse.get() + reuse.size(), loaded.get());
+  // 작은 이미지를 load 한 뒤에도 처음 할당한 buffer 를 계속 쓴다.
+  std::vector<uint8_t> small_png;
+  reused = reused && thumb.savePng(&small_png) &&
+      reuse.loadInto(small_png) && reuse.isSameSize(thumb) &&
+      reuse.get() == reuse_buf && reuse.loadInto(org_path) &&
+      reuse.get() == reuse_buf &&
+      std::equal(reuse.get(), reuse.get() + reuse.size(), loaded.get());
+  report("loadInto reuse", reused);
+
+  std::ifstream file(org_path, std::ios::binary);
+  std::vector<uint8_t> raw((std::istreambuf_iterator<char>(file)),
+                           std::istreambuf_iterator<char>());
+  size_t row = loaded.w() * loaded.c();
+  size_t stride = row + 64;
+  std::vector<uint8_t> slot(stride * loaded.h());
+  int dh = 0, dw = 0;
+  bool strided = Image::decodeInto(raw, slot.data(), stride, loaded.h(),
+                                   loaded.w(), 3, &dh, &dw) &&
+      dh == loaded.h() && dw == loaded.w();
+  for (int i=0; strided && i<loaded.h(); i++)
+    strided = std::equal(loaded.get() + i * row, loaded.get() + (i + 1) * row,
+                         slot.data() + i * stride);
+  report("decodeInto stride", strided);
+
+  // stream, file descriptor 에서 읽은 결과도 같아야 한다.
+  std::ifstream stream(org_path, std::ios::binary);
+  Image streamed;
+  bool stream_ok = streamed.load(stream) && streamed.size() == loaded.size() &&
+      std::equal(streamed.get(), streamed.get() + streamed.size(),
+                 loaded.get());
+  int fd = ::open(org_path.c_str(), O_RDONLY);
+  Image fd_loaded;
+  bool fd_ok = fd >= 0 && fd_loaded.loadFd(fd) &&
+      fd_loaded.size() == loaded.size() &&
+      std::equal(fd_loaded.get(), fd_loaded.get() + fd_loaded.size(),
+                 loaded.get());
+  if (fd >= 0)
+    ::close(fd);
+  report("stream, fd load", stream_ok && fd_ok);
+
+  // 설정은 load 마다 적용되므로 다른 thread 의 load 에 영향을 주지 않는다.
+  LoadOptions flip_options;
+  flip_options.flip_vertically = true;
+  Image flipped, plain;
+  std::thread flip_thread([&] { flipped.load(raw, flip_options); });
+  plain.load(raw);
+  flip_thread.join();
+  bool options_ok = flipped.isSameSize(loaded) && plain.isSameSize(loaded) &&
+      std::equal(plain.get(), plain.get() + plain.size(), loaded.get());
+  for (int i=0; options_ok && i<loaded.h(); i++)
+    options_ok = std::equal(flipped.get() + i * row,
+                            flipped.get() + (i + 1) * row,
+                            loaded.get() + (loaded.h() - 1 - i) * row);
+  // 실패한 load 는 이유를 남긴다.
+  Image reloaded;
+  options_ok = options_ok && !reloaded.load(std::vector<uint8_t>(16, 0)) &&
+      *Image::lastError() != '\0';
+  report("load, save options", options_ok);
+
+  // buffer 에 저장한 PNG, JPEG 는 encode 결과 크기이고 다시 load 할 수 있다.
+  // raw buffer 가 작으면 buffer 밖에 쓰지 않고 false 를 반환한다.
+  SaveOptions fast_png;
+  fast_png.png_compression_level = 1;
+  std::vector<uint8_t> png, jpg;
+  Image reloaded_png, reloaded_jpg;
+  bool buffer_ok = loaded.savePng(&png, fast_png) && reloaded_png.load(png) &&
+      std::equal(reloaded_png.get(), reloaded_png.get() + reloaded_png.size(),
+                 loaded.get()) &&
+      loaded.saveJpg(&jpg) && reloaded_jpg.load(jpg) &&
+      reloaded_jpg.isSameSize(loaded);
+  std::vector<uint8_t> exact(png.size() + 1, 0xA5);
+  buffer_ok = buffer_ok &&
+      loaded.savePng(exact.data(), static_cast<int>(png.size()), fast_png) &&
+      std::equal(png.begin(), png.end(), exact.begin()) &&
+      exact.back() == 0xA5;
+  std::vector<uint8_t> small(png.size() / 2 + 1, 0xA5);
+  buffer_ok = buffer_ok &&
+      !loaded.savePng(small.data(), static_cast<int>(small.size() - 1),
+                      fast_png) &&
+      small.back() == 0xA5;
+  report("save to buffer", buffer_ok);
+
+  // restart interval 이 있는 JPEG 는 marker 단위로 병렬 decode 하고, IDCT,
+  // upsampling, 색 변환은 AVX2 kernel 을 사용한다. 결과는 serial, SSE2
+  // decoder 와 같고, marker 가 없는 같은 JPEG 의 decode 결과와도 같아야 한다.
+  // (org_path 는 4:2:0 이라 h2v2 upsampling 도 확인한다)
+  bool jpeg_ok = true;
+  Image restart_src = loaded.copy();
+  jpeg_ok = restart_src.resize(333, 517);
+  std::vector<std::vector<uint8_t>> jpegs = {raw};
+  for (int interval : {0, 1, 7, 64, 1000}) {
+    SaveOptions restart_opt;
+    restart_opt.jpg_quality = 90;
+    restart_opt.jpg_restart_interval = interval;
+    std::vector<uint8_t> encoded;
+    jpeg_ok = jpeg_ok && restart_src.saveJpg(&encoded, restart_opt);
+    jpegs.push_back(encoded);
+  }
+  for (int c : {1, 3, 4}) {
+    for (size_t n=0; jpeg_ok && n<jpegs.size(); n++) {
+      Image decoded;
+      int rw = 0, rh = 0, rc = 0;
+      std::unique_ptr<uint8_t, void (*)(void*)> expect(
+          stbi_load_from_memory(jpegs[n].data(),
+                                static_cast<int>(jpegs[n].size()),
+                                &rw, &rh, &rc, c),
+          stbi_image_free);
+      jpeg_ok = expect && decoded.load(jpegs[n], c) &&
+          decoded.h() == rh && decoded.w() == rw && decoded.c() == c &&
+          std::equal(decoded.get(), decoded.get() + decoded.size(),
+                     expect.get());
+      // restart interval 은 양자화 계수를 바꾸지 않는다.
+      Image plain_jpeg;
+      jpeg_ok = jpeg_ok && (n < 2 || (plain_jpeg.load(jpegs[1], c) &&
+          std::equal(decoded.get(), decoded.get() + decoded.size(),
+                     plain_jpeg.get())));
+    }
+  }
+  report("jpeg restart, avx2 decode", jpeg_ok);
+
+  // 이미 취소된 token 이나 지난 deadline 이면 resize, load, save 는 false
+  // 를 반환하고 이미지를 바꾸지 않는다.
+  CancelToken cancelled;
+  cancelled.cancel();
+  CancelToken expired;
+  expired.setDeadline(CancelToken::Clock::now() -
+                      std::chrono::milliseconds(1));
+  bool cancel_ok = true;
+  for (const CancelToken* token : {&cancelled, &expired}) {
+    Image target(org_path);
+    const uint8_t* target_buf = target.get();
+    std::vector<uint8_t> encoded;
+    cancel_ok = cancel_ok && !target.resize(100, 150, ResizeOptions(), token) &&
+        !target.load("images/org_copy_image.png", 3, token) &&
+        !target.load(raw, 3, token) &&
+        !target.savePng(&encoded, token) && !target.saveJpg(&encoded, token) &&
+        target.get() == target_buf && target.isSameSize(loaded) &&
+        std::equal(target.get(), target.get() + target.size(), loaded.get());
+  }
+  report("cancelled resize, load, save", cancel_ok);
+
+  // 정수 resize 와 float resize 의 차이. (최대 1 이어야 한다)
+  Image float_rs(org_path);
+  Image fixed_rs(org_path);
+  ResizeOptions fixed_opt;
+  fixed_opt.backend = ResizeBackend::kFixed;
+  float_rs.resize(333, 517);
+  fixed_rs.resize(333, 517, fixed_opt);
+  int max_err = 0;
+  for (int i=0; i<float_rs.h(); i++) {
+    for (int j=0; j<float_rs.w(); j++) {
+      for (int k=0; k<float_rs.c(); k++) {
+        int e = std::abs(float_rs.pixel(i, j, k) - fixed_rs.pixel(i, j, k));
+        max_err = std::max(max_err, e);
+      }
+    }
+  }
+  report("resize fixed vs float max error " + std::to_string(max_err),
+         max_err <= 1);
+
+  // row 단위 streaming resize 는 전체 resize 와 같아야 한다.
+  Image stream_src(org_path);
+  Image stream_rs(333, 517, stream_src.c());
+  ResizeOptions stream_opt;
+  stream_opt.high_quality = true;
+  StreamingResizer streamer;
+  streamer.open(stream_src.h(), stream_src.w(), 333, 517, stream_src.c(),
+                [&](int y, const uint8_t* row) {
+                  std::copy(row, row + 517 * stream_src.c(),
+                            stream_rs.get() + y * 517 * stream_src.c());
+                }, stream_opt);
+  for (int i=0; i<stream_src.h(); i++)
+    streamer.push(stream_src.get() + i * stream_src.w() * stream_src.c());
+  stream_src.resize(333, 517, stream_opt);
+  bool same = streamer.done() &&
+      std::equal(stream_rs.get(), stream_rs.get() + stream_rs.size(),
+                 stream_src.get());
+  report("streaming resize", same);
+
+  // 큰 이미지는 출력을 row band 로 나누어 병렬 계산한다. 결과는 band 를
+  // 나누지 않는 stbir_resize_uint8 과 byte 단위로 같아야 한다.
+  bool bands_ok = true;
+  const int band_sizes[][2] = {{333, 517}, {1103, 1301}};
+  for (int c=1; c<=4; c++) {
+    Image band_src(900, 700, c);
+    uint32_t noise = 11;
+    for (int i=0; i<band_src.h(); i++) {
+      for (int j=0; j<band_src.w(); j++) {
+        for (int k=0; k<c; k++) {
+          noise = noise * 1664525u + 1013904223u;
+          band_src.pixel(i, j, k) = static_cast<uint8_t>(
+              ((i / 9) ^ (j / 13)) * 37 + k * 71 + (noise >> 29));
+        }
+      }
+    }
+    for (const auto& size : band_sizes) {
+      Image banded = band_src.copy();
+      std::vector<uint8_t> serial(static_cast<size_t>(size[0]) * size[1] * c);
+      bands_ok = bands_ok && banded.resize(size[0], size[1]) &&
+          stbir_resize_uint8(band_src.get(), band_src.w(), band_src.h(),
+                             band_src.w() * c, serial.data(), size[1],
+                             size[0], size[1] * c, c) &&
+          std::equal(serial.begin(), serial.end(), banded.get());
+    }
+  }
+  report("band resize vs stbir", bands_ok);
+
+  // sRGB resize 는 모든 channel 을 sRGB 로 보는 stbir_resize_uint8_srgb 와
+  // byte 단위로 같아야 한다.
+  bool srgb_ok = true;
+  ResizeOptions srgb_opt;
+  srgb_opt.colorspace = ColorSpace::kSRGB;
+  const int srgb_sizes[][2] = {{131, 97}, {517, 611}};
+  for (int c=1; c<=4; c++) {
+    Image srgb_src(300, 200, c);
+    for (int i=0; i<srgb_src.h(); i++) {
+      for (int j=0; j<srgb_src.w(); j++) {
+        for (int k=0; k<c; k++)
+          srgb_src.pixel(i, j, k) = static_cast<uint8_t>(
+              ((i / 3 + j / 2 + k) % 2) ? i * 7 + j * 13 + k * 50
+                                        : 0xFF - (i * j) % 97);
+      }
+    }
+    for (const auto& size : srgb_sizes) {
+      Image srgb_rs = srgb_src.copy();
+      std::vector<uint8_t> expect(static_cast<size_t>(size[0]) * size[1] * c);
+      srgb_ok = srgb_ok && srgb_rs.resize(size[0], size[1], srgb_opt) &&
+          stbir_resize_uint8_srgb(srgb_src.get(), srgb_src.w(), srgb_src.h(),
+                                  srgb_src.w() * c, expect.data(), size[1],
+                                  size[0], size[1] * c, c,
+                                  STBIR_ALPHA_CHANNEL_NONE, 0) &&
+          std::equal(expect.begin(), expect.end(), srgb_rs.get());
+    }
+  }
+  report("sRGB resize vs stbir", srgb_ok);
+
+  // alpha resize 는 색에 alpha 를 곱해 계산하므로 투명한 pixel 의 색이
+  // 번지지 않는다. 왼쪽 절반은 불투명한 색, 오른쪽 절반은 투명한 다른 색이다.
+  // 결과는 alpha channel 을 지정한 stbir_resize_uint8_generic (stbir 가
+  // 내부에서 alpha 를 곱하고 나눈다) 과 byte 단위로 같아야 한다.
+  bool alpha_ok = true;
+  const int alpha_sizes[][2] = {{71, 53}, {389, 457}};
+  for (int c : {2, 4}) {
+    Image alpha_src(150, 200, c);
+    for (int i=0; i<alpha_src.h(); i++) {
+      for (int j=0; j<alpha_src.w(); j++) {
+        bool opaque = j < alpha_src.w() / 2;
+        for (int k=0; k+1<c; k++)
+          alpha_src.pixel(i, j, k) = opaque ? 0xC8 : static_cast<uint8_t>(k);
+        alpha_src.pixel(i, j, c - 1) = opaque ? 0xFF : 0x00;
+      }
+    }
+    // 가운데 띠는 반투명한 noise 로 채워 stbir 와의 비교 범위를 넓힌다.
+    Image noisy = alpha_src.copy();
+    uint32_t noise = 5;
+    for (int i=0; i<noisy.h(); i++) {
+      for (int j=noisy.w() / 4; j<noisy.w() * 3 / 4; j++) {
+        for (int k=0; k<c; k++) {
+          noise = noise * 1664525u + 1013904223u;
+          noisy.pixel(i, j, k) = static_cast<uint8_t>(noise >> 24);
+        }
+      }
+    }
+    for (ColorSpace space : {ColorSpace::kLinear, ColorSpace::kSRGB}) {
+      ResizeOptions alpha_opt(ResizeFilter::kDefault, EdgeMode::kClamp, space);
+      alpha_opt.alpha = true;
+      for (const auto& size : alpha_sizes) {
+        Image edge_rs = alpha_src.copy();
+        alpha_ok = alpha_ok && edge_rs.resize(size[0], size[1], alpha_opt);
+        for (int i=0; alpha_ok && i<edge_rs.h(); i++) {
+          for (int j=0; j<edge_rs.w(); j++) {
+            for (int k=0; edge_rs.pixel(i, j, c - 1) && k+1<c; k++)
+              alpha_ok = alpha_ok && edge_rs.pixel(i, j, k) == 0xC8;
+          }
+        }
+        Image noisy_rs = noisy.copy();
+        std::vector<uint8_t> expect(static_cast<size_t>(size[0]) * size[1] * c);
+        alpha_ok = alpha_ok && noisy_rs.resize(size[0], size[1], alpha_opt) &&
+            stbir_resize_uint8_generic(
+                noisy.get(), noisy.w(), noisy.h(), noisy.w() * c,
+                expect.data(), size[1], size[0], size[1] * c, c, c - 1, 0,
+                STBIR_EDGE_CLAMP, STBIR_FILTER_DEFAULT,
+                static_cast<stbir_colorspace>(space), nullptr) &&
+            std::equal(expect.begin(), expect.end(), noisy_rs.get());
+      }
+    }
+  }
+  report("alpha resize", alpha_ok);
+
+  // 정수 배율 축소는 (kh x kw) 영역의 반올림 평균이다.
+  // 출력 폭은 SIMD 로 처리하고 남는 pixel 이 생기도록 홀수로 둔다.
+  bool area_ok = true;
+  const int area_scales[][2] = {{2, 2}, {3, 5}, {4, 8}, {7, 1}, {1, 3}};
+  for (int c=1; c<=5; c++) {
+    for (const auto& scale : area_scales) {
+      const int ah = 13, aw = 37;
+      Image area_src(ah * scale[0], aw * scale[1], c);
+      uint32_t noise = 3;
+      for (size_t i=0; i<area_src.size(); i++) {
+        noise = noise * 1664525u + 1013904223u;
+        area_src.get()[i] = static_cast<uint8_t>(noise >> 24);
+      }
+      Image area_rs = area_src.copy();
+      area_ok = area_ok && area_rs.resize(ah, aw);
+      const int n = scale[0] * scale[1];
+      for (int x=0; area_ok && x<ah; x++) {
+        for (int y=0; y<aw; y++) {
+          for (int k=0; k<c; k++) {
+            int sum = n / 2;
+            for (int i=0; i<scale[0]; i++) {
+              for (int j=0; j<scale[1]; j++)
+                sum += area_src.pixel(x * scale[0] + i, y * scale[1] + j, k);
+            }
+            area_ok = area_ok && area_rs.pixel(x, y, k) == sum / n;
+          }
+        }
+      }
+    }
+  }
+  report("area resize", area_ok);
+
+  // nearest resize 는 출력 pixel 마다 중심이 속한 입력 pixel
+  // ((2 * o + 1) * in / (2 * out)) 을 그대로 복사해야 한다.
+  Image mask(300, 400, 1, uint8_t(0));
+  for (int i=0; i<mask.h(); i++) {
+    for (int j=0; j<mask.w(); j++)
+      mask.pixel(i, j, 0) = static_cast<uint8_t>((i / 7 + j / 5) % 3);
+  }
+  // channel 수마다 경로가 다르므로 2, 5 channel 도 확인한다.
+  Image two(200, 150, 2), five(200, 150, 5);
+  for (Image* multi : {&two, &five}) {
+    for (int i=0; i<multi->h(); i++) {
+      for (int j=0; j<multi->w(); j++) {
+        for (int k=0; k<multi->c(); k++)
+          multi->pixel(i, j, k) = static_cast<uint8_t>(i * 31 + j * 7 + k * 53);
+      }
+    }
+  }
+  bool labels = true;
+  const int nearest_sizes[][2] = {{123, 457}, {611, 97}};
+  for (const Image& src : {mask, loaded, two, five}) {
+    for (const auto& size : nearest_sizes) {
+      Image dst = src.copy();
+      labels = labels && dst.resize(size[0], size[1], ResizeOptions::nearest());
+      for (int i=0; labels && i<dst.h(); i++) {
+        int si = (2 * i + 1) * src.h() / (2 * dst.h());
+        for (int j=0; labels && j<dst.w(); j++) {
+          int sj = (2 * j + 1) * src.w() / (2 * dst.w());
+          for (int k=0; k<dst.c(); k++)
+            labels = labels && dst.pixel(i, j, k) == src.pixel(si, sj, k);
+        }
+      }
+    }
+  }
+  report("nearest resize index", labels);
+
   // crop
   std::cout << "crop 100x50" << std::endl;  
   img.centerCrop(100, 50);
@@ -79,11 +500,185 @@ int main() {
   
   stamp_b_image.saveJpg("images/stamp_b_image_x3.jpg");
 
+  // compose
+  std::cout << "compose 2x3" << std::endl;
+  std::vector<Image> cells(6, target);
+  Image sheet = Image::compose(GridSpec(2, 3, 80, 80, 4), cells);
+  sheet.saveJpg("images/compose_2x3.jpg");
+
+  // 각 cell 은 원본을 따로 resize 한 결과와 같고, cell 밖은 background 로
+  // 남아야 한다. cell 수가 thread 수보다 많고 마지막 cell 은 비워 둔다.
+  bool compose_ok = true;
+  for (bool keep_ratio : {false, true}) {
+    GridSpec spec(3, ThreadPool::instance().concurrency() + 1, 57, 71, 3, 0x37);
+    spec.keep_ratio = keep_ratio;
+    std::vector<Image> tiles;
+    for (int i=0; i+1<spec.rows*spec.cols; i++) {
+      Image tile = loaded.copy();
+      tile.crop(40 + (i * 37) % 300, 40 + (i * 61) % 300, 200, 200);
+      tiles.push_back(tile);
+    }
+    Image grid = Image::compose(spec, tiles);
+    std::vector<bool> covered(grid.size() / grid.c(), false);
+    for (size_t i=0; compose_ok && i<tiles.size(); i++) {
+      int rh = spec.cell_h, rw = spec.cell_w;
+      if (keep_ratio) {
+        if (tiles[i].w() * spec.cell_h > tiles[i].h() * spec.cell_w)
+          rh = std::max(1, tiles[i].h() * spec.cell_w / tiles[i].w());
+        else
+          rw = std::max(1, tiles[i].w() * spec.cell_h / tiles[i].h());
+      }
+      int x = spec.padding + static_cast<int>(i) / spec.cols *
+          (spec.cell_h + spec.padding) + (spec.cell_h - rh) / 2;
+      int y = spec.padding + static_cast<int>(i) % spec.cols *
+          (spec.cell_w + spec.padding) + (spec.cell_w - rw) / 2;
+      Image expect = tiles[i].copy();
+      compose_ok = expect.resize(rh, rw, spec.resize);
+      for (int a=0; compose_ok && a<rh; a++) {
+        for (int b=0; b<rw; b++) {
+          covered[(x + a) * grid.w() + y + b] = true;
+          for (int k=0; k<grid.c(); k++)
+            compose_ok = compose_ok &&
+                grid.pixel(x + a, y + b, k) == expect.pixel(a, b, k);
+        }
+      }
+    }
+    for (size_t i=0; compose_ok && i<covered.size(); i++) {
+      for (int k=0; !covered[i] && k<grid.c(); k++)
+        compose_ok = compose_ok && grid.get()[i * grid.c() + k] == 0x37;
+    }
+  }
+  report("compose tiles", compose_ok);
+
+  // pyramid
+  std::cout << "pyramid 1/2 ~ 1/8" << std::endl;
+  Image org(org_path);
+  std::vector<Image> pyramid = org.buildPyramid(3);
+  pyramid.back().savePng("images/pyramid_1_8.png");
+
+  // 각 level 은 이전 level 을 scalar 2x2 box / [1 3 3 1] 로 줄인 값과
+  // 같아야 한다. 홀수 크기에서는 오른쪽, 아래 경계를 clamp 한다.
+  bool pyramid_ok = true;
+  for (PyramidFilter filter : {PyramidFilter::kBox, PyramidFilter::kGaussian}) {
+    for (int c=1; c<=4; c++) {
+      for (int size : {1, 37, 97}) {
+        Image src(size + 16, size, c);
+        for (int i=0; i<src.h(); i++) {
+          for (int j=0; j<src.w(); j++) {
+            for (int k=0; k<c; k++)
+              src.pixel(i, j, k) = static_cast<uint8_t>(i * 29 + j * 83 +
+                                                        k * 101 + i * j);
+          }
+        }
+        std::vector<Image> levels = src.buildPyramid(8, filter);
+        const Image* prev = &src;
+        for (const Image& level : levels) {
+          const int ph = prev->h(), pw = prev->w();
+          pyramid_ok = pyramid_ok && level.h() == std::max(1, ph / 2) &&
+                       level.w() == std::max(1, pw / 2) && level.c() == c;
+          for (int x=0; pyramid_ok && x<level.h(); x++) {
+            for (int y=0; y<level.w(); y++) {
+              for (int k=0; k<c; k++) {
+                int v = 0;
+                if (filter == PyramidFilter::kBox) {
+                  for (int i=0; i<2; i++) {
+                    for (int j=0; j<2; j++)
+                      v += prev->pixel(std::min(2 * x + i, ph - 1),
+                                       std::min(2 * y + j, pw - 1), k);
+                  }
+                  v = (v + 2) >> 2;
+                }
+                else {
+                  const int taps[4] = {1, 3, 3, 1};
+                  for (int i=0; i<4; i++) {
+                    for (int j=0; j<4; j++) {
+                      int sx = std::min(std::max(2 * x - 1 + i, 0), ph - 1);
+                      int sy = std::min(std::max(2 * y - 1 + j, 0), pw - 1);
+                      v += taps[i] * taps[j] * prev->pixel(sx, sy, k);
+                    }
+                  }
+                  v = (v + 32) >> 6;
+                }
+                pyramid_ok = pyramid_ok && level.pixel(x, y, k) == v;
+              }
+            }
+          }
+          prev = &level;
+        }
+      }
+    }
+  }
+  report("pyramid levels", pyramid_ok);
+
+  // integral image 의 영역 합은 pixel 을 직접 더한 값과 같아야 한다.
+  // 전체 합이 2^32 를 넘는 크기이므로 uint32_t table 은 누적 중 overflow 된다.
+  Image plane(4300, 4300, 1);
+  uint32_t seed = 7;
+  for (size_t i=0; i<plane.size(); i++) {
+    seed = seed * 1664525u + 1013904223u;
+    plane.get()[i] = static_cast<uint8_t>(240 + (seed >> 28));
+  }
+  IntegralImage sat32(plane);
+  IntegralImage64 sat64(plane);
+  bool sums = true;
+  for (int i=0; sums && i<300; i++) {
+    seed = seed * 1664525u + 1013904223u;
+    int qh = 1 + (seed >> 8) % 64;
+    int qw = 1 + (seed >> 16) % 64;
+    // 일부는 오른쪽 아래 구석과 범위 밖에 걸치도록 한다.
+    int qx = (i % 3 == 0) ? plane.h() - qh / 2 : (seed >> 4) % plane.h() - 16;
+    int qy = (i % 3 == 0) ? plane.w() - qw / 2 : (seed >> 12) % plane.w() - 16;
+    uint64_t expect = 0;
+    for (int x=std::max(qx, 0); x<std::min(qx + qh, plane.h()); x++) {
+      for (int y=std::max(qy, 0); y<std::min(qy + qw, plane.w()); y++)
+        expect += plane.pixel(x, y, 0);
+    }
+    sums = sat32.sum(qx, qy, qh, qw, 0) == expect &&
+           sat64.sum(qx, qy, qh, qw, 0) == expect;
+  }
+  sums = sums && sat64.sum(0, 0, plane.h(), plane.w(), 0) ==
+      std::accumulate(plane.get(), plane.get() + plane.size(), uint64_t(0));
+  report("integral image sums", sums);
+
+  // blur / sharpen
+  std::cout << "gaussian blur, unsharp mask" << std::endl;
+  Image blurred(org);
+  blurred.gaussianBlur(2.0f);
+  blurred.saveJpg("images/gaussian_blur.jpg");
+  Image sharpened(pyramid.front());
+  sharpened.unsharpMask(1.0f, 0.8f);
+  sharpened.saveJpg("images/unsharp_mask.jpg");
+
+  // sharpen kernel (절대값 합 5) 도 float 계산과 1 이내로 같아야 한다.
+  const std::vector<float> sharpen = {-1.0f, 3.0f, -1.0f};
+  Image sharp_src(pyramid.front());
+  Image sharp(sharp_src);
+  bool sharp_ok = sharp.convolve(sharpen, sharpen);
+  const int sh = sharp_src.h(), sw = sharp_src.w();
+  for (int x=0; sharp_ok && x<sh; x++) {
+    for (int y=0; sharp_ok && y<sw; y++) {
+      for (int z=0; z<sharp_src.c(); z++) {
+        float v = 0.0f;
+        for (int i=0; i<3; i++) {
+          for (int j=0; j<3; j++) {
+            int sx = std::min(std::max(x + i - 1, 0), sh - 1);
+            int sy = std::min(std::max(y + j - 1, 0), sw - 1);
+            v += sharpen[i] * sharpen[j] * sharp_src.pixel(sx, sy, z);
+          }
+        }
+        long expect = std::min(std::max(std::lround(v), 0L), 255L);
+        if (std::abs(sharp.pixel(x, y, z) - expect) > 1)
+          sharp_ok = false;
+      }
+    }
+  }
+  report("sharpen kernel", sharp_ok);
+
 
   target.clear();
   target.load(org_path);
   target.addBorder(10, 20);
   target.savePng("images/add_border.png");
 
-  return 0;
+  return failures ? 1 : 0;
 }
@@ -0,0 +1,2134 @@
+//------------------------------------------------------------------------------
+// @file resize.cc
+//------------------------------------------------------------------------------
+#include "resize.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <list>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <vector>
+
+//------------------------------------------------------------------------------
+// stb module. (don't use this in header but source)
+// stbir 내부 함수(필터 계산, scanline decode/encode 등)를 직접 사용하므로
+// implementation 은 이 파일에서만 include 한다.
+//------------------------------------------------------------------------------
+#define STB_IMAGE_RESIZE_IMPLEMENTATION
+#define STB_IMAGE_RESIZE_STATIC
+#define STB_IMAGE_RESIZE_INLINE
+#include "stb_image_resize.h"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// AVX2 kernel 은 target attribute 로 따로 compile 하고 실행 중에 선택한다.
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define SAS_RESIZE_AVX2
+#define SAS_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+namespace sas {
+
+//------------------------------------------------------------------------------
+// 병렬 처리 기준. 이보다 작은 resize 는 thread 를 나누는 비용이 더 크다.
+//------------------------------------------------------------------------------
+static const int kMinBandRows = 32;
+static const size_t kMinParallelPixels = 256 * 256;
+
+//------------------------------------------------------------------------------
+// SIMD 수직 pass 가 한 번에 처리하는 최대 row 수. 넘으면 stbir 함수를 사용한다.
+//------------------------------------------------------------------------------
+static const int kMaxVerticalTaps = 64;
+
+//------------------------------------------------------------------------------
+// decode buffer 뒤에 두는 여유 float 수. 3 channel 수평 pass 는 마지막
+// pixel 을 4 lane 으로 읽어 decode buffer 끝을 1 float 넘는다.
+//------------------------------------------------------------------------------
+static const size_t kDecodeSlack = 1;
+
+//------------------------------------------------------------------------------
+// edge 방식에 따라 범위 밖 index 를 [0, max) 로 변환. (kZero 는 -1)
+// stbir__edge_wrap 를 사용하되 n 이 이미지 크기보다 멀리 벗어난 경우를 위해
+// 결과를 한 번 더 clamp 한다.
+//------------------------------------------------------------------------------
+int edgeIndex(EdgeMode edge, int n, int max) {
+  if (n >= 0 && n < max)
+    return n;
+  if (edge == EdgeMode::kZero)
+    return -1;
+  auto i = ::stbir__edge_wrap(static_cast<stbir_edge>(edge), n, max);
+  return std::min(std::max(i, 0), max - 1);
+}
+
+//------------------------------------------------------------------------------
+// 필터 계수까지 계산된 stbir__info 와 계수 메모리.
+// stbir__resize_arbitrary / stbir__resize_allocated 가 scanline 처리 전까지
+// 하는 일과 동일하다. 입출력 pointer 와 작업 buffer 는 run() 마다 정한다.
+//------------------------------------------------------------------------------
+struct FloatPlan;
+struct FixedPlan;
+struct AreaPlan;
+struct PointPlan;
+
+struct ResizePlan::Impl {
+  stbir__info info;
+  std::vector<unsigned char> filters;
+  ResizeOptions options;
+  std::unique_ptr<FloatPlan> simd;  // kFloat backend 의 SIMD kernel 설정.
+  std::unique_ptr<FixedPlan> fixed;  // kFixed backend 인 경우에만 사용.
+  std::unique_ptr<AreaPlan> area;    // 정수 배율 축소인 경우에만 사용.
+  std::unique_ptr<PointPlan> point;  // kNearest, kBilinear 인 경우에만 사용.
+};
+
+//------------------------------------------------------------------------------
+// ResizeFilter 를 축 하나의 stbir_filter 로 변환. kFast 는 축소이면 box,
+// 확대이면 triangle 을 사용한다. (필터 폭이 1~2 pixel 로 좁다)
+// kNearest, kBilinear 는 stbir 로 계산하지 않으므로 크기 정보만 쓰인다.
+//------------------------------------------------------------------------------
+static stbir_filter to_stbir_filter(ResizeFilter filter, int in_n, int out_n) {
+  if (filter == ResizeFilter::kFast)
+    return out_n < in_n ? STBIR_FILTER_BOX : STBIR_FILTER_TRIANGLE;
+  if (filter == ResizeFilter::kNearest || filter == ResizeFilter::kBilinear)
+    return STBIR_FILTER_BOX;
+  return static_cast<stbir_filter>(filter);
+}
+
+//------------------------------------------------------------------------------
+// resize 설정과 필터 계수를 계산한다. 잘못된 인자이면 false.
+//------------------------------------------------------------------------------
+static bool setup_resize(stbir__info* info, std::vector<unsigned char>* filters,
+                         int in_w, int in_h, int out_w, int out_h,
+                         int c, int alpha_channel, stbir_uint32 flags,
+                         stbir_datatype type,
+                         stbir_filter h_filter, stbir_filter v_filter,
+                         stbir_edge h_edge, stbir_edge v_edge,
+                         stbir_colorspace colorspace) {
+  if (in_w <= 0 || in_h <= 0 || out_w <= 0 || out_h <= 0)
+    return false;
+  if (c <= 0 || c > STBIR_MAX_CHANNELS || alpha_channel >= c)
+    return false;
+  if (h_filter >= STBIR__ARRAY_SIZE(stbir__filter_info_table))
+    return false;
+  if (v_filter >= STBIR__ARRAY_SIZE(stbir__filter_info_table))
+    return false;
+
+  std::memset(info, 0, sizeof(*info));
+  ::stbir__setup(info, in_w, in_h, out_w, out_h, c);
+  ::stbir__calculate_transform(info, 0, 0, 1, 1, NULL);
+  ::stbir__choose_filter(info, h_filter, v_filter);
+  ::stbir__calculate_memory(info);
+
+  if (alpha_channel < 0)
+    flags |= STBIR_FLAG_ALPHA_USES_COLORSPACE | STBIR_FLAG_ALPHA_PREMULTIPLIED;
+
+  info->alpha_channel = alpha_channel;
+  info->flags = flags;
+  info->type = type;
+  info->edge_horizontal = h_edge;
+  info->edge_vertical = v_edge;
+  info->colorspace = colorspace;
+
+  info->horizontal_coefficient_width   = ::stbir__get_coefficient_width  (info->horizontal_filter, info->horizontal_scale);
+  info->vertical_coefficient_width     = ::stbir__get_coefficient_width  (info->vertical_filter  , info->vertical_scale  );
+  info->horizontal_filter_pixel_width  = ::stbir__get_filter_pixel_width (info->horizontal_filter, info->horizontal_scale);
+  info->vertical_filter_pixel_width    = ::stbir__get_filter_pixel_width (info->vertical_filter  , info->vertical_scale  );
+  info->horizontal_filter_pixel_margin = ::stbir__get_filter_pixel_margin(info->horizontal_filter, info->horizontal_scale);
+  info->vertical_filter_pixel_margin   = ::stbir__get_filter_pixel_margin(info->vertical_filter  , info->vertical_scale  );
+
+  info->ring_buffer_length_bytes = info->output_w * info->channels * sizeof(float);
+  info->decode_buffer_pixels = info->input_w + info->horizontal_filter_pixel_margin * 2;
+
+  // 필터 계수 메모리. (contributors, coefficients 순서)
+  filters->assign(info->horizontal_contributors_size +
+                  info->horizontal_coefficients_size +
+                  info->vertical_contributors_size +
+                  info->vertical_coefficients_size, 0);
+  auto p = filters->data();
+  info->horizontal_contributors = reinterpret_cast<stbir__contributors*>(p);
+  p += info->horizontal_contributors_size;
+  info->horizontal_coefficients = reinterpret_cast<float*>(p);
+  p += info->horizontal_coefficients_size;
+  info->vertical_contributors = reinterpret_cast<stbir__contributors*>(p);
+  p += info->vertical_contributors_size;
+  info->vertical_coefficients = reinterpret_cast<float*>(p);
+
+  ::stbir__calculate_filters(info->horizontal_contributors,
+                             info->horizontal_coefficients,
+                             info->horizontal_filter, info->horizontal_scale,
+                             info->horizontal_shift, info->input_w,
+                             info->output_w);
+  ::stbir__calculate_filters(info->vertical_contributors,
+                             info->vertical_coefficients,
+                             info->vertical_filter, info->vertical_scale,
+                             info->vertical_shift, info->input_h,
+                             info->output_h);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// stbir 가 계산한 필터를 출력 pixel 기준 (gather) 계수로 변환한다.
+// 축소 시 stbir 의 계수는 입력 pixel 기준 (scatter) 이므로 뒤집어 모은다.
+// 출력 o 는 입력 [first[o], first[o] + taps) 를 weights[o * taps] 부터의
+// 계수로 사용한다. taps 는 align 의 배수이며 남는 계수는 0 이다.
+// 출력 하나에 더해지는 입력 순서는 stbir 와 같다. (입력 index 증가 순)
+//------------------------------------------------------------------------------
+static bool gather_axis(const stbir__info& info, bool horizontal, int align,
+                        std::vector<int>* first, std::vector<float>* weights,
+                        int* taps) {
+  auto filter = static_cast<stbir_filter>(
+      horizontal ? info.horizontal_filter : info.vertical_filter);
+  auto scale = horizontal ? info.horizontal_scale : info.vertical_scale;
+  auto contributors = horizontal ? info.horizontal_contributors
+                                 : info.vertical_contributors;
+  auto coefficients = horizontal ? info.horizontal_coefficients
+                                 : info.vertical_coefficients;
+  auto in_n = horizontal ? info.input_w : info.input_h;
+  auto out_n = horizontal ? info.output_w : info.output_h;
+
+  // 출력 별 (입력 index, 계수) 목록.
+  std::vector<std::vector<std::pair<int, float>>> gather(out_n);
+  auto num = ::stbir__get_contributors(scale, filter, in_n, out_n);
+  if (::stbir__use_upsampling(scale)) {
+    for (int o=0; o<num; o++) {
+      auto& ctr = contributors[o];
+      for (int i=ctr.n0; i<=ctr.n1; i++) {
+        auto w = *::stbir__get_coefficient(coefficients, filter, scale,
+                                           o, i - ctr.n0);
+        gather[o].emplace_back(i, w);
+      }
+    }
+  }
+  else {
+    auto margin = ::stbir__get_filter_pixel_margin(filter, scale);
+    for (int j=0; j<num; j++) {
+      auto& ctr = contributors[j];
+      for (int o=ctr.n0; o<=ctr.n1; o++) {
+        auto w = *::stbir__get_coefficient(coefficients, filter, scale,
+                                           j, o - ctr.n0);
+        gather[o].emplace_back(j - margin, w);
+      }
+    }
+  }
+
+  // 출력 별 첫 입력과 가장 넓은 범위를 구한다.
+  first->assign(out_n, 0);
+  int width = 1;
+  for (int o=0; o<out_n; o++) {
+    if (gather[o].empty())
+      return false;
+    int i0 = gather[o].front().first;
+    int i1 = i0;
+    for (auto& g : gather[o]) {
+      i0 = std::min(i0, g.first);
+      i1 = std::max(i1, g.first);
+    }
+    (*first)[o] = i0;
+    width = std::max(width, i1 - i0 + 1);
+  }
+  *taps = (width + align - 1) / align * align;
+
+  weights->assign(static_cast<size_t>(out_n) * *taps, 0.0f);
+  for (int o=0; o<out_n; o++) {
+    float* w = weights->data() + static_cast<size_t>(o) * *taps;
+    for (auto& g : gather[o])
+      w[g.first - (*first)[o]] += g.second;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// float resampler 의 수평 계수. (출력 pixel 기준, gather_axis 참고)
+// 모든 출력의 입력 범위가 decode buffer [-margin, input_w + margin) 안에
+// 들도록 first 를 조정하고, 앞쪽을 0 계수로 채운다.
+// c == 1 은 출력 8 개 단위로 [tap][출력] 순서의 계수도 둔다. (vector load)
+//------------------------------------------------------------------------------
+struct FloatAxis {
+  int taps;
+  std::vector<int> first;
+  std::vector<float> coefs;
+  std::vector<float> coefs8;
+};
+
+//------------------------------------------------------------------------------
+// float resampler 의 SIMD 설정. simd 가 false 이면 stbir 함수를 사용한다.
+//------------------------------------------------------------------------------
+struct FloatPlan {
+  bool simd;
+  bool srgb;   // decode/encode 에 sRGB 변환 table 을 사용.
+  bool alpha;  // 4 channel 의 마지막 channel 이 straight alpha.
+  FloatAxis horz;
+};
+
+#ifdef SAS_RESIZE_AVX2
+//------------------------------------------------------------------------------
+// 실행 중인 CPU 의 AVX2 지원 여부.
+//------------------------------------------------------------------------------
+static bool cpu_has_avx2() {
+  return __builtin_cpu_supports("avx2");
+}
+#endif
+
+//------------------------------------------------------------------------------
+// stbir 설정으로부터 FloatPlan 을 만든다.
+// uint8, 1/3/4 channel 이고 CPU 가 AVX2 를 지원하면 SIMD 를 사용한다.
+// alpha 는 4 channel 인 경우만 처리한다.
+//------------------------------------------------------------------------------
+static void make_float_plan(const stbir__info& info, FloatPlan* plan) {
+  plan->simd = false;
+  plan->srgb = info.colorspace == STBIR_COLORSPACE_SRGB;
+  plan->alpha = info.alpha_channel >= 0;
+#ifdef SAS_RESIZE_AVX2
+  const int c = info.channels;
+  if (!cpu_has_avx2() || info.type != STBIR_TYPE_UINT8 ||
+      (c != 1 && c != 3 && c != 4))
+    return;
+  if (plan->alpha && c != 4)
+    return;
+
+  FloatAxis& axis = plan->horz;
+  std::vector<float> weights;
+  if (!gather_axis(info, true, 1, &axis.first, &weights, &axis.taps))
+    return;
+  const int lo = -info.horizontal_filter_pixel_margin;
+  const int hi = info.input_w + info.horizontal_filter_pixel_margin;
+  const int out_w = info.output_w;
+  const int taps = axis.taps;
+  if (taps > hi - lo)
+    return;
+
+  axis.coefs.assign(static_cast<size_t>(out_w) * taps, 0.0f);
+  for (int o=0; o<out_w; o++) {
+    const float* w = weights.data() + static_cast<size_t>(o) * taps;
+    int shift = std::max(0, axis.first[o] + taps - hi);
+    axis.first[o] -= shift;
+    if (axis.first[o] < lo)
+      return;
+    std::copy(w, w + taps - shift,
+              axis.coefs.begin() + static_cast<size_t>(o) * taps + shift);
+  }
+  if (c == 1) {
+    int blocks = out_w / 8;
+    axis.coefs8.assign(static_cast<size_t>(blocks) * taps * 8, 0.0f);
+    for (int b=0; b<blocks; b++) {
+      for (int k=0; k<taps; k++) {
+        for (int i=0; i<8; i++) {
+          axis.coefs8[(static_cast<size_t>(b) * taps + k) * 8 + i] =
+              axis.coefs[static_cast<size_t>(b * 8 + i) * taps + k];
+        }
+      }
+    }
+  }
+  plan->simd = true;
+#else
+  (void)info;
+#endif
+}
+
+#ifdef SAS_RESIZE_AVX2
+//------------------------------------------------------------------------------
+// AVX2 kernel. stbir 의 scalar 계산과 같은 순서로 곱하고 더하므로 결과는
+// bit 단위로 같다. FMA 는 반올림이 달라지므로 사용하지 않으며, compiler 가
+// 곱셈과 덧셈을 합치지 않도록 -ffp-contract=off 로 빌드한다. (Makefile)
+//------------------------------------------------------------------------------
+
+// 수평 pass, 1 channel. 출력 8 개를 gather 로 동시에 계산한다.
+SAS_TARGET_AVX2
+static void horizontal_c1_avx2(const FloatAxis& axis, const float* in,
+                               int out_w, float* out) {
+  const int taps = axis.taps;
+  int x = 0;
+  for (; x+8<=out_w; x+=8) {
+    const __m256i first = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i*>(axis.first.data() + x));
+    const float* w = axis.coefs8.data() + static_cast<size_t>(x) * taps;
+    __m256 acc = _mm256_setzero_ps();
+    for (int k=0; k<taps; k++) {
+      __m256i idx = _mm256_add_epi32(first, _mm256_set1_epi32(k));
+      __m256 px = _mm256_i32gather_ps(in, idx, 4);
+      acc = _mm256_add_ps(acc, _mm256_mul_ps(px, _mm256_loadu_ps(w + k * 8)));
+    }
+    _mm256_storeu_ps(out + x, acc);
+  }
+  for (; x<out_w; x++) {
+    const float* p = in + axis.first[x];
+    const float* w = axis.coefs.data() + static_cast<size_t>(x) * taps;
+    float acc = 0;
+    for (int k=0; k<taps; k++)
+      acc += p[k] * w[k];
+    out[x] = acc;
+  }
+}
+
+// 수평 pass, 3/4 channel. pixel 하나를 channel 4 개 lane 으로 계산하며
+// 출력 2 개를 하나의 256bit 에 넣는다. c == 3 이면 입력을 1 float 더 읽는다.
+template <int C>
+SAS_TARGET_AVX2
+static void horizontal_c34_avx2(const FloatAxis& axis, const float* in,
+                                int out_w, float* out) {
+  const int taps = axis.taps;
+  int x = 0;
+  // c == 3 은 4 lane 저장이 다음 pixel 을 덮으므로 마지막 pixel 은 따로 쓴다.
+  for (; x+2<out_w || (C == 4 && x+2<=out_w); x+=2) {
+    const float* p0 = in + axis.first[x] * C;
+    const float* p1 = in + axis.first[x + 1] * C;
+    const float* w0 = axis.coefs.data() + static_cast<size_t>(x) * taps;
+    const float* w1 = w0 + taps;
+    __m256 acc = _mm256_setzero_ps();
+    for (int k=0; k<taps; k++) {
+      __m256 px = _mm256_insertf128_ps(
+          _mm256_castps128_ps256(_mm_loadu_ps(p0 + k * C)),
+          _mm_loadu_ps(p1 + k * C), 1);
+      __m256 w = _mm256_insertf128_ps(
+          _mm256_castps128_ps256(_mm_set1_ps(w0[k])), _mm_set1_ps(w1[k]), 1);
+      acc = _mm256_add_ps(acc, _mm256_mul_ps(px, w));
+    }
+    _mm_storeu_ps(out + x * C, _mm256_castps256_ps128(acc));
+    _mm_storeu_ps(out + (x + 1) * C, _mm256_extractf128_ps(acc, 1));
+  }
+  for (; x<out_w; x++) {
+    const float* p = in + axis.first[x] * C;
+    const float* w = axis.coefs.data() + static_cast<size_t>(x) * taps;
+    __m128 acc = _mm_setzero_ps();
+    for (int k=0; k<taps; k++)
+      acc = _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(p + k * C),
+                                       _mm_set1_ps(w[k])));
+    if (C == 4) {
+      _mm_storeu_ps(out + x * C, acc);
+    }
+    else {
+      _mm_storel_pi(reinterpret_cast<__m64*>(out + x * C), acc);
+      _mm_store_ss(out + x * C + 2, _mm_movehl_ps(acc, acc));
+    }
+  }
+}
+
+// out[i] = sum(rows[k][i] * coefs[k]). (k 순서로 더한다)
+SAS_TARGET_AVX2
+static void vertical_sum_avx2(float* const* rows, const float* coefs, int n,
+                              int len, float* out) {
+  int i = 0;
+  for (; i+8<=len; i+=8) {
+    __m256 acc = _mm256_setzero_ps();
+    for (int k=0; k<n; k++)
+      acc = _mm256_add_ps(acc, _mm256_mul_ps(_mm256_loadu_ps(rows[k] + i),
+                                             _mm256_set1_ps(coefs[k])));
+    _mm256_storeu_ps(out + i, acc);
+  }
+  for (; i<len; i++) {
+    float acc = 0;
+    for (int k=0; k<n; k++)
+      acc += rows[k][i] * coefs[k];
+    out[i] = acc;
+  }
+}
+
+// rows[k][i] += in[i] * coefs[k]. 입력을 한 번 읽어 여러 출력 row 에 더한다.
+SAS_TARGET_AVX2
+static void vertical_scatter_avx2(float* const* rows, const float* coefs, int n,
+                                  int len, const float* in) {
+  int i = 0;
+  for (; i+8<=len; i+=8) {
+    __m256 v = _mm256_loadu_ps(in + i);
+    for (int k=0; k<n; k++) {
+      __m256 r = _mm256_loadu_ps(rows[k] + i);
+      r = _mm256_add_ps(r, _mm256_mul_ps(v, _mm256_set1_ps(coefs[k])));
+      _mm256_storeu_ps(rows[k] + i, r);
+    }
+  }
+  for (; i<len; i++) {
+    for (int k=0; k<n; k++)
+      rows[k][i] += in[i] * coefs[k];
+  }
+}
+
+// uint8 -> float. (v / 255)
+SAS_TARGET_AVX2
+static void decode_u8_avx2(const uint8_t* in, int len, float* out) {
+  const __m256 scale = _mm256_set1_ps(stbir__max_uint8_as_float);
+  int i = 0;
+  for (; i+8<=len; i+=8) {
+    __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i));
+    __m256 f = _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v));
+    _mm256_storeu_ps(out + i, _mm256_div_ps(f, scale));
+  }
+  for (; i<len; i++)
+    out[i] = in[i] / stbir__max_uint8_as_float;
+}
+
+// sRGB uint8 -> 선형 float. (stbir__srgb_uchar_to_linear_float table 을 gather)
+SAS_TARGET_AVX2
+static void decode_srgb_avx2(const uint8_t* in, int len, float* out) {
+  int i = 0;
+  for (; i+8<=len; i+=8) {
+    __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i));
+    __m256 f = _mm256_i32gather_ps(stbir__srgb_uchar_to_linear_float,
+                                   _mm256_cvtepu8_epi32(v), 4);
+    _mm256_storeu_ps(out + i, f);
+  }
+  for (; i<len; i++)
+    out[i] = stbir__srgb_uchar_to_linear_float[in[i]];
+}
+
+// float -> uint8. stbir 는 saturate(v) * 255 에 double 로 0.5 를 더해 버리므로
+// float 덧셈 대신 정수부와 소수부 (>= 0.5) 로 나누어 같은 값을 만든다.
+SAS_TARGET_AVX2
+static __m256i encode_round_avx2(__m256 v) {
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 scale = _mm256_set1_ps(stbir__max_uint8_as_float);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  v = _mm256_mul_ps(_mm256_min_ps(_mm256_max_ps(v, zero), one), scale);
+  __m256i t = _mm256_cvttps_epi32(v);
+  __m256 frac = _mm256_sub_ps(v, _mm256_cvtepi32_ps(t));
+  __m256 up = _mm256_cmp_ps(frac, half, _CMP_GE_OQ);
+  return _mm256_sub_epi32(t, _mm256_castps_si256(up));
+}
+
+// 선형 float -> sRGB uint8. stbir__linear_to_srgb_uchar 의 vector 판.
+// [2^-13, 1-eps] 로 자른 뒤 지수와 상위 가수 3 bit 로 table 을 찾고,
+// 다음 가수 8 bit 로 선형 보간한다. (NaN 은 max 에서 하한으로 바뀐다)
+SAS_TARGET_AVX2
+static __m256i encode_srgb_avx2(__m256 v) {
+  const __m256i minval = _mm256_set1_epi32((127 - 13) << 23);
+  const __m256i almostone = _mm256_set1_epi32(0x3f7fffff);
+  v = _mm256_max_ps(v, _mm256_castsi256_ps(minval));
+  v = _mm256_min_ps(v, _mm256_castsi256_ps(almostone));
+  __m256i u = _mm256_castps_si256(v);
+  __m256i index = _mm256_srli_epi32(_mm256_sub_epi32(u, minval), 20);
+  __m256i tab = _mm256_i32gather_epi32(
+      reinterpret_cast<const int*>(fp32_to_srgb8_tab4), index, 4);
+  __m256i bias = _mm256_slli_epi32(_mm256_srli_epi32(tab, 16), 9);
+  __m256i scale = _mm256_and_si256(tab, _mm256_set1_epi32(0xffff));
+  __m256i t = _mm256_and_si256(_mm256_srli_epi32(u, 12),
+                               _mm256_set1_epi32(0xff));
+  return _mm256_srli_epi32(
+      _mm256_add_epi32(bias, _mm256_mullo_epi32(scale, t)), 16);
+}
+
+// RGBA 2 pixel 을 alpha 로 곱한다. stbir 와 같이 alpha 에 epsilon 을 더해
+// alpha 가 0 인 pixel 의 색이 사라지지 않도록 한다.
+SAS_TARGET_AVX2
+static __m256 premultiply_avx2(__m256 v) {
+  __m256 a = _mm256_add_ps(_mm256_shuffle_ps(v, v, 0xff),
+                           _mm256_set1_ps(STBIR_ALPHA_EPSILON));
+  return _mm256_blend_ps(_mm256_mul_ps(v, a), a, 0x88);
+}
+
+// RGBA 2 pixel 의 색을 alpha 로 나눈다. (alpha 가 0 이면 0)
+SAS_TARGET_AVX2
+static __m256 unpremultiply_avx2(__m256 v) {
+  __m256 a = _mm256_shuffle_ps(v, v, 0xff);
+  __m256 r = _mm256_div_ps(_mm256_set1_ps(1.0f), a);
+  r = _mm256_andnot_ps(_mm256_cmp_ps(a, _mm256_setzero_ps(), _CMP_EQ_OQ), r);
+  return _mm256_blend_ps(_mm256_mul_ps(v, r), v, 0x88);
+}
+
+// [0, 255] 범위의 int32 16 개를 uint8 로 저장한다.
+SAS_TARGET_AVX2
+static void store_u8_avx2(__m256i a, __m256i b, uint8_t* out) {
+  __m256i v = _mm256_packs_epi32(a, b);   // lane 별 pack 이므로 순서 보정.
+  v = _mm256_permute4x64_epi64(v, _MM_SHUFFLE(3, 1, 2, 0));
+  __m128i u = _mm_packus_epi16(_mm256_castsi256_si128(v),
+                               _mm256_extracti128_si256(v, 1));
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), u);
+}
+
+SAS_TARGET_AVX2
+static void encode_u8_avx2(const float* in, int len, uint8_t* out) {
+  int i = 0;
+  for (; i+16<=len; i+=16) {
+    store_u8_avx2(encode_round_avx2(_mm256_loadu_ps(in + i)),
+                  encode_round_avx2(_mm256_loadu_ps(in + i + 8)), out + i);
+  }
+  for (; i<len; i++)
+    out[i] = static_cast<uint8_t>(
+        static_cast<int>(::stbir__saturate(in[i]) * stbir__max_uint8_as_float + 0.5));
+}
+
+// RGBA uint8 -> premultiplied float. 변환과 alpha 곱셈을 한 번에 한다.
+// sRGB 이면 색만 table 로 변환하고 alpha 는 선형이다.
+SAS_TARGET_AVX2
+static void decode_rgba_avx2(const uint8_t* in, int len, bool srgb,
+                             float* out) {
+  const __m256 scale = _mm256_set1_ps(stbir__max_uint8_as_float);
+  int i = 0;
+  for (; i+8<=len; i+=8) {
+    __m256i v = _mm256_cvtepu8_epi32(
+        _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + i)));
+    __m256 f = _mm256_div_ps(_mm256_cvtepi32_ps(v), scale);
+    if (srgb) {
+      f = _mm256_blend_ps(
+          _mm256_i32gather_ps(stbir__srgb_uchar_to_linear_float, v, 4), f, 0x88);
+    }
+    _mm256_storeu_ps(out + i, premultiply_avx2(f));
+  }
+  for (; i<len; i+=4) {
+    float a = in[i + 3] / stbir__max_uint8_as_float + STBIR_ALPHA_EPSILON;
+    for (int z=0; z<3; z++) {
+      out[i + z] = (srgb ? stbir__srgb_uchar_to_linear_float[in[i + z]] :
+                           in[i + z] / stbir__max_uint8_as_float) * a;
+    }
+    out[i + 3] = a;
+  }
+}
+
+// premultiplied float -> RGBA uint8. alpha 로 나눈 뒤 변환한다.
+SAS_TARGET_AVX2
+static void encode_rgba_avx2(const float* in, int len, bool srgb,
+                             uint8_t* out) {
+  auto encode = [srgb](__m256 v) {
+    v = unpremultiply_avx2(v);
+    __m256i linear = encode_round_avx2(v);
+    return srgb ? _mm256_blend_epi32(encode_srgb_avx2(v), linear, 0x88) :
+                  linear;
+  };
+  int i = 0;
+  for (; i+16<=len; i+=16) {
+    store_u8_avx2(encode(_mm256_loadu_ps(in + i)),
+                  encode(_mm256_loadu_ps(in + i + 8)), out + i);
+  }
+  for (; i<len; i+=4) {
+    float a = in[i + 3];
+    float r = a ? 1.0f / a : 0;
+    for (int z=0; z<3; z++) {
+      float v = in[i + z] * r;
+      out[i + z] = srgb ? ::stbir__linear_to_srgb_uchar(v) :
+          static_cast<uint8_t>(static_cast<int>(
+              ::stbir__saturate(v) * stbir__max_uint8_as_float + 0.5));
+    }
+    out[i + 3] = static_cast<uint8_t>(
+        static_cast<int>(::stbir__saturate(a) * stbir__max_uint8_as_float + 0.5));
+  }
+}
+
+SAS_TARGET_AVX2
+static void encode_srgb_u8_avx2(const float* in, int len, uint8_t* out) {
+  int i = 0;
+  for (; i+16<=len; i+=16) {
+    store_u8_avx2(encode_srgb_avx2(_mm256_loadu_ps(in + i)),
+                  encode_srgb_avx2(_mm256_loadu_ps(in + i + 8)), out + i);
+  }
+  for (; i<len; i++)
+    out[i] = ::stbir__linear_to_srgb_uchar(in[i]);
+}
+#endif
+
+//------------------------------------------------------------------------------
+// stbir__decode_scanline. SIMD 를 사용할 수 있으면 이미지 안쪽 pixel 을
+// 한 번에 변환하고, 가장자리 margin 만 stbir 와 같이 처리한다.
+//------------------------------------------------------------------------------
+static void decode_scanline(stbir__info* info, const FloatPlan* plan, int n) {
+#ifdef SAS_RESIZE_AVX2
+  if (plan && plan->simd) {
+    const int c = info->channels;
+    const int w = info->input_w;
+    const int margin = info->horizontal_filter_pixel_margin;
+    float* decode = ::stbir__get_decode_buffer(info);
+    if (info->edge_vertical == STBIR_EDGE_ZERO &&
+        (n < 0 || n >= info->input_h)) {
+      std::fill(decode - margin * c, decode + (w + margin) * c, 0.0f);
+      return;
+    }
+    auto row = static_cast<const uint8_t*>(info->input_data) +
+               ::stbir__edge_wrap(info->edge_vertical, n, info->input_h) *
+               static_cast<size_t>(info->input_stride_bytes);
+    if (plan->alpha)
+      decode_rgba_avx2(row, w * c, plan->srgb, decode);
+    else if (plan->srgb)
+      decode_srgb_avx2(row, w * c, decode);
+    else
+      decode_u8_avx2(row, w * c, decode);
+    auto decode_margin = [&](int x0, int x1) {
+      for (int x=x0; x<x1; x++) {
+        if (info->edge_horizontal == STBIR_EDGE_ZERO) {
+          std::fill(decode + x * c, decode + (x + 1) * c, 0.0f);
+          continue;
+        }
+        const uint8_t* p =
+            row + ::stbir__edge_wrap(info->edge_horizontal, x, w) * c;
+        if (plan->alpha) {
+          decode_rgba_avx2(p, c, plan->srgb, decode + x * c);
+          continue;
+        }
+        for (int z=0; z<c; z++) {
+          decode[x * c + z] = plan->srgb ?
+              stbir__srgb_uchar_to_linear_float[p[z]] :
+              p[z] / stbir__max_uint8_as_float;
+        }
+      }
+    };
+    decode_margin(-margin, 0);
+    decode_margin(w, w + margin);
+    return;
+  }
+#endif
+  (void)plan;
+  ::stbir__decode_scanline(info, n);
+}
+
+//------------------------------------------------------------------------------
+// 수평 pass. out 은 output_w * channel 개의 float 로 덮어쓴다.
+//------------------------------------------------------------------------------
+static void resample_horizontal(stbir__info* info, const FloatPlan* plan,
+                                float* out) {
+#ifdef SAS_RESIZE_AVX2
+  if (plan && plan->simd) {
+    const float* in = ::stbir__get_decode_buffer(info);
+    switch (info->channels) {
+      case 1: horizontal_c1_avx2(plan->horz, in, info->output_w, out); return;
+      case 3: horizontal_c34_avx2<3>(plan->horz, in, info->output_w, out); return;
+      case 4: horizontal_c34_avx2<4>(plan->horz, in, info->output_w, out); return;
+    }
+  }
+#endif
+  (void)plan;
+  std::memset(out, 0, info->output_w * info->channels * sizeof(float));
+  if (::stbir__use_width_upsampling(info))
+    ::stbir__resample_horizontal_upsample(info, out);
+  else
+    ::stbir__resample_horizontal_downsample(info, out);
+}
+
+//------------------------------------------------------------------------------
+// float row 를 출력 row 로 변환한다. (stbir__encode_scanline)
+//------------------------------------------------------------------------------
+static void encode_scanline(stbir__info* info, const FloatPlan* plan,
+                            void* out, float* in) {
+#ifdef SAS_RESIZE_AVX2
+  if (plan && plan->simd) {
+    const int len = info->output_w * info->channels;
+    if (plan->alpha)
+      encode_rgba_avx2(in, len, plan->srgb, static_cast<uint8_t*>(out));
+    else if (plan->srgb)
+      encode_srgb_u8_avx2(in, len, static_cast<uint8_t*>(out));
+    else
+      encode_u8_avx2(in, len, static_cast<uint8_t*>(out));
+    return;
+  }
+#endif
+  (void)plan;
+  int decode = STBIR__DECODE(info->type, info->colorspace);
+  ::stbir__encode_scanline(info, info->output_w, out, in, info->channels,
+                           info->alpha_channel, decode);
+}
+
+//------------------------------------------------------------------------------
+// stbir__decode_and_resample_upsample.
+//------------------------------------------------------------------------------
+static void decode_and_resample_upsample(stbir__info* info,
+                                         const FloatPlan* plan, int n) {
+  decode_scanline(info, plan, n);
+  resample_horizontal(info, plan, ::stbir__add_empty_ring_buffer_entry(info, n));
+}
+
+//------------------------------------------------------------------------------
+// stbir__decode_and_resample_downsample.
+//------------------------------------------------------------------------------
+static void decode_and_resample_downsample(stbir__info* info,
+                                           const FloatPlan* plan, int n) {
+  decode_scanline(info, plan, n);
+  resample_horizontal(info, plan, info->horizontal_buffer);
+}
+
+//------------------------------------------------------------------------------
+// stbir__resample_vertical_upsample. 출력 row n 을 만들어 기록한다.
+// SIMD 는 ring buffer 의 모든 입력 row 를 register 에서 누적한 뒤 한 번 쓴다.
+//------------------------------------------------------------------------------
+static void resample_vertical_upsample(stbir__info* info,
+                                       const FloatPlan* plan, int n) {
+#ifdef SAS_RESIZE_AVX2
+  if (plan && plan->simd) {
+    const auto& ctr = info->vertical_contributors[n];
+    const float* coefs = info->vertical_coefficients +
+                         info->vertical_coefficient_width * n;
+    float* rows[kMaxVerticalTaps];
+    int num = ctr.n1 - ctr.n0 + 1;
+    if (num <= kMaxVerticalTaps) {
+      int ring_length = info->ring_buffer_length_bytes / sizeof(float);
+      for (int k=0; k<num; k++) {
+        rows[k] = ::stbir__get_ring_buffer_scanline(
+            ctr.n0 + k, info->ring_buffer, info->ring_buffer_begin_index,
+            info->ring_buffer_first_scanline, info->ring_buffer_num_entries,
+            ring_length);
+      }
+      vertical_sum_avx2(rows, coefs, num, info->output_w * info->channels,
+                        info->encode_buffer);
+      encode_scanline(info, plan,
+                      static_cast<char*>(info->output_data) +
+                      static_cast<size_t>(n) * info->output_stride_bytes,
+                      info->encode_buffer);
+      return;
+    }
+  }
+#endif
+  (void)plan;
+  ::stbir__resample_vertical_upsample(info, n);
+}
+
+//------------------------------------------------------------------------------
+// stbir__resample_vertical_downsample. 입력 row n 을 ring buffer 의 출력 row
+// 들에 더한다. SIMD 는 입력을 한 번 읽어 모든 출력 row 에 더한다.
+//------------------------------------------------------------------------------
+static void resample_vertical_downsample(stbir__info* info,
+                                         const FloatPlan* plan, int n) {
+#ifdef SAS_RESIZE_AVX2
+  if (plan && plan->simd) {
+    int contributor = n + info->vertical_filter_pixel_margin;
+    const auto& ctr = info->vertical_contributors[contributor];
+    const float* coefs = info->vertical_coefficients +
+                         info->vertical_coefficient_width * contributor;
+    float* rows[kMaxVerticalTaps];
+    int num = ctr.n1 - ctr.n0 + 1;
+    if (num <= kMaxVerticalTaps) {
+      int ring_length = info->ring_buffer_length_bytes / sizeof(float);
+      for (int k=0; k<num; k++) {
+        rows[k] = ::stbir__get_ring_buffer_scanline(
+            ctr.n0 + k, info->ring_buffer, info->ring_buffer_begin_index,
+            info->ring_buffer_first_scanline, info->ring_buffer_num_entries,
+            ring_length);
+      }
+      vertical_scatter_avx2(rows, coefs, num, info->output_w * info->channels,
+                            info->horizontal_buffer);
+      return;
+    }
+  }
+#endif
+  (void)plan;
+  ::stbir__resample_vertical_downsample(info, n);
+}
+
+//------------------------------------------------------------------------------
+// 출력 row [y_begin, y_end) 만 계산하는 stbir__buffer_loop_upsample.
+//------------------------------------------------------------------------------
+static void buffer_loop_upsample(stbir__info* info, const FloatPlan* plan,
+                                 int y_begin, int y_end,
+                                 const CancelToken* cancel) {
+  float scale_ratio = info->vertical_scale;
+  float out_scanlines_radius =
+      stbir__filter_info_table[info->vertical_filter].support(1/scale_ratio) *
+      scale_ratio;
+
+  for (int y=y_begin; y<y_end; y++) {
+    if (isCancelled(cancel))
+      return;
+    float in_center_of_out = 0;
+    int in_first_scanline = 0;
+    int in_last_scanline = 0;
+    ::stbir__calculate_sample_range_upsample(
+        y, out_scanlines_radius, scale_ratio, info->vertical_shift,
+        &in_first_scanline, &in_last_scanline, &in_center_of_out);
+
+    if (info->ring_buffer_begin_index >= 0) {
+      // 더 이상 필요 없는 scanline 제거.
+      while (in_first_scanline > info->ring_buffer_first_scanline) {
+        if (info->ring_buffer_first_scanline == info->ring_buffer_last_scanline) {
+          info->ring_buffer_begin_index = -1;
+          info->ring_buffer_first_scanline = 0;
+          info->ring_buffer_last_scanline = 0;
+          break;
+        }
+        info->ring_buffer_first_scanline++;
+        info->ring_buffer_begin_index =
+            (info->ring_buffer_begin_index + 1) % info->ring_buffer_num_entries;
+      }
+    }
+
+    if (info->ring_buffer_begin_index < 0)
+      decode_and_resample_upsample(info, plan, in_first_scanline);
+    while (in_last_scanline > info->ring_buffer_last_scanline)
+      decode_and_resample_upsample(info, plan, info->ring_buffer_last_scanline + 1);
+
+    resample_vertical_upsample(info, plan, y);
+  }
+}
+
+//------------------------------------------------------------------------------
+// stbir__empty_ring_buffer 와 같지만 [y_begin, y_end) 범위의 row 만 기록한다.
+//------------------------------------------------------------------------------
+static void empty_ring_buffer(stbir__info* info, const FloatPlan* plan,
+                              int first_necessary_scanline,
+                              int y_begin, int y_end) {
+  int ring_buffer_length = info->ring_buffer_length_bytes / sizeof(float);
+
+  if (info->ring_buffer_begin_index < 0)
+    return;
+  while (first_necessary_scanline > info->ring_buffer_first_scanline) {
+    int y = info->ring_buffer_first_scanline;
+    if (y >= y_begin && y < y_end) {
+      float* entry = ::stbir__get_ring_buffer_entry(
+          info->ring_buffer, info->ring_buffer_begin_index, ring_buffer_length);
+      char* out = static_cast<char*>(info->output_data) +
+                  static_cast<size_t>(y) * info->output_stride_bytes;
+      encode_scanline(info, plan, out, entry);
+    }
+    if (info->ring_buffer_first_scanline == info->ring_buffer_last_scanline) {
+      info->ring_buffer_begin_index = -1;
+      info->ring_buffer_first_scanline = 0;
+      info->ring_buffer_last_scanline = 0;
+      break;
+    }
+    info->ring_buffer_first_scanline++;
+    info->ring_buffer_begin_index =
+        (info->ring_buffer_begin_index + 1) % info->ring_buffer_num_entries;
+  }
+}
+
+//------------------------------------------------------------------------------
+// 출력 row [y_begin, y_end) 만 계산하는 stbir__buffer_loop_downsample.
+// 범위에 영향을 주는 입력 row 만 decode 하며, 출력 row 마다 입력 row 를
+// 누적하는 순서는 전체를 한 번에 처리할 때와 같다.
+//------------------------------------------------------------------------------
+static void buffer_loop_downsample(stbir__info* info, const FloatPlan* plan,
+                                   int y_begin, int y_end,
+                                   const CancelToken* cancel) {
+  float scale_ratio = info->vertical_scale;
+  float in_pixels_radius =
+      stbir__filter_info_table[info->vertical_filter].support(scale_ratio) /
+      scale_ratio;
+  int pixel_margin = info->vertical_filter_pixel_margin;
+  int max_y = info->input_h + pixel_margin;
+
+  for (int y=-pixel_margin; y<max_y; y++) {
+    float out_center_of_in;
+    int out_first_scanline, out_last_scanline;
+    ::stbir__calculate_sample_range_downsample(
+        y, in_pixels_radius, scale_ratio, info->vertical_shift,
+        &out_first_scanline, &out_last_scanline, &out_center_of_in);
+
+    if (out_first_scanline >= y_end)
+      break;
+    if (out_last_scanline < y_begin)
+      continue;
+    if (isCancelled(cancel))
+      return;
+
+    empty_ring_buffer(info, plan, out_first_scanline, y_begin, y_end);
+    decode_and_resample_downsample(info, plan, y);
+
+    if (info->ring_buffer_begin_index < 0)
+      ::stbir__add_empty_ring_buffer_entry(info, out_first_scanline);
+    while (out_last_scanline > info->ring_buffer_last_scanline)
+      ::stbir__add_empty_ring_buffer_entry(info, info->ring_buffer_last_scanline + 1);
+
+    resample_vertical_downsample(info, plan, y);
+  }
+  empty_ring_buffer(info, plan, y_end, y_begin, y_end);
+}
+
+//------------------------------------------------------------------------------
+// 계산된 필터로 출력 row [y_begin, y_end) 를 만든다.
+// 필터 계수는 읽기만 하며, decode/ring/encode buffer 는 thread 별로 따로 쓴다.
+//------------------------------------------------------------------------------
+static void resize_rows(const stbir__info& setup, const FloatPlan* plan,
+                        int y_begin, int y_end, const CancelToken* cancel) {
+  stbir__info info = setup;
+  // 작업 buffer 는 thread 마다 재사용한다. (resize 마다 할당하지 않도록)
+  static thread_local std::vector<float> work;
+  size_t work_size = (info.decode_buffer_size + info.horizontal_buffer_size +
+                      info.ring_buffer_size + info.encode_buffer_size) /
+                     sizeof(float) + kDecodeSlack;
+  if (work.size() < work_size)
+    work.resize(work_size);
+  float* p = work.data();
+  info.decode_buffer = p;
+  p += info.decode_buffer_size / sizeof(float) + kDecodeSlack;
+  if (::stbir__use_height_upsampling(&info)) {
+    info.horizontal_buffer = NULL;
+    info.ring_buffer = p;
+    p += info.ring_buffer_size / sizeof(float);
+    info.encode_buffer = p;
+  }
+  else {
+    info.horizontal_buffer = p;
+    p += info.horizontal_buffer_size / sizeof(float);
+    info.ring_buffer = p;
+    info.encode_buffer = NULL;
+  }
+  // ring buffer 가 비어 있음을 표시.
+  info.ring_buffer_begin_index = -1;
+  info.ring_buffer_first_scanline = 0;
+  info.ring_buffer_last_scanline = 0;
+
+  if (::stbir__use_height_upsampling(&info))
+    buffer_loop_upsample(&info, plan, y_begin, y_end, cancel);
+  else
+    buffer_loop_downsample(&info, plan, y_begin, y_end, cancel);
+}
+
+//------------------------------------------------------------------------------
+// 출력 row [0, out_h) 를 band 로 나누어 fn(y_begin, y_end) 를 병렬 실행한다.
+// 작은 resize 는 thread 를 나누지 않고 하나의 band 로 처리한다.
+//------------------------------------------------------------------------------
+static void for_each_band(size_t in_pixels, size_t out_pixels, int out_h,
+                          const std::function<void(int, int)>& fn) {
+  auto& pool = ThreadPool::instance();
+  int num_bands = 1;
+  if (std::max(in_pixels, out_pixels) >= kMinParallelPixels)
+    num_bands = std::max(1, std::min(pool.concurrency(), out_h / kMinBandRows));
+  int band_h = (out_h + num_bands - 1) / num_bands;
+  num_bands = (out_h + band_h - 1) / band_h;
+
+  pool.parallelFor(num_bands, [&](int b) {
+    fn(b * band_h, std::min(out_h, (b + 1) * band_h));
+  });
+}
+
+//------------------------------------------------------------------------------
+// 출력을 row band 로 나누어 병렬로 resize 한다.
+// 각 band 는 필요한 입력 row (필터 크기 만큼의 overlap 포함) 만 읽는다.
+//------------------------------------------------------------------------------
+static void resize_bands(const stbir__info& setup, const FloatPlan* plan,
+                         const CancelToken* cancel) {
+  auto in_pixels = static_cast<size_t>(setup.input_w) * setup.input_h;
+  auto out_pixels = static_cast<size_t>(setup.output_w) * setup.output_h;
+  for_each_band(in_pixels, out_pixels, setup.output_h, [&](int y0, int y1) {
+    resize_rows(setup, plan, y0, y1, cancel);
+  });
+}
+
+//------------------------------------------------------------------------------
+// 정수 resampler 의 고정 소수점 설정. (Image::convolve 와 같은 구성)
+// 계수는 Q14 이며, 수평 pass 결과는 Q6 int16 으로 저장한다.
+// 계수 절대값 합이 2 이하이면 중간값이 int16 범위를 넘지 않는다.
+//------------------------------------------------------------------------------
+static const int kFixedCoefBits = 14;
+static const int kFixedInterBits = 6;
+static const int kFixedHorzShift = kFixedCoefBits - kFixedInterBits;
+static const int kFixedVertShift = kFixedCoefBits + kFixedInterBits;
+
+//------------------------------------------------------------------------------
+// 축 하나의 정수 필터. 출력 i 는 입력 [first[i], first[i] + taps) 를 사용하며
+// 범위 밖 입력은 edge 방식으로 처리한다. 모든 출력의 taps 는 같다.
+//------------------------------------------------------------------------------
+struct FixedAxis {
+  int taps;
+  int lo;  // 참조하는 입력 index 의 최소값. (범위 밖일 수 있다)
+  int hi;  // 참조하는 입력 index 의 최대값 + 1.
+  std::vector<int> first;
+  std::vector<int16_t> coefs;  // 출력 i 의 계수는 coefs[i * taps] 부터.
+};
+
+//------------------------------------------------------------------------------
+// stbir 필터를 출력 pixel 기준 계수로 바꾸어 정수화한다.
+// 출력 하나의 계수 합은 정확히 1 << kFixedCoefBits 가 되도록 보정한다.
+// taps 는 align 의 배수로 맞추며, 남는 계수는 0 이다.
+//------------------------------------------------------------------------------
+static bool make_fixed_axis(const stbir__info& info, bool horizontal,
+                            int align, FixedAxis* axis) {
+  std::vector<float> weights;
+  if (!gather_axis(info, horizontal, align, &axis->first, &weights,
+                   &axis->taps))
+    return false;
+  const int out_n = static_cast<int>(axis->first.size());
+  axis->lo = axis->first.front();
+  axis->hi = axis->first.front() + axis->taps;
+  for (int o=0; o<out_n; o++) {
+    axis->lo = std::min(axis->lo, axis->first[o]);
+    axis->hi = std::max(axis->hi, axis->first[o] + axis->taps);
+  }
+
+  // Q14 정수화. 반올림 오차는 가장 큰 계수에 더한다.
+  const int one = 1 << kFixedCoefBits;
+  axis->coefs.assign(static_cast<size_t>(out_n) * axis->taps, 0);
+  for (int o=0; o<out_n; o++) {
+    const float* w = weights.data() + static_cast<size_t>(o) * axis->taps;
+    int16_t* q = axis->coefs.data() + static_cast<size_t>(o) * axis->taps;
+    float abs_sum = 0;
+    int sum = 0;
+    int peak = 0;
+    for (int k=0; k<axis->taps; k++) {
+      abs_sum += std::fabs(w[k]);
+      q[k] = static_cast<int16_t>(std::lround(w[k] * one));
+      sum += q[k];
+      if (std::abs(q[k]) > std::abs(q[peak]))
+        peak = k;
+    }
+    if (abs_sum > 2.0f)
+      return false;
+    q[peak] = static_cast<int16_t>(q[peak] + one - sum);
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// 수평 pass. row 는 입력 index lo 부터 edge 처리된 pixel 들이며,
+// 출력은 Q6 int16 이다.
+//------------------------------------------------------------------------------
+static void fixed_horizontal(const FixedAxis& axis, int c, const uint8_t* row,
+                             int out_w, int16_t* out) {
+  const int taps = axis.taps;
+  const int round = 1 << (kFixedHorzShift - 1);
+  int x = 0;
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i vround = _mm_set1_epi32(round);
+  if (c == 1) {
+    // 8 tap 씩 madd. (taps 는 8 의 배수)
+    for (; x<out_w; x++) {
+      const uint8_t* in = row + (axis.first[x] - axis.lo);
+      const int16_t* co = axis.coefs.data() + static_cast<size_t>(x) * taps;
+      __m128i acc = zero;
+      for (int k=0; k<taps; k+=8) {
+        __m128i px = _mm_unpacklo_epi8(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in + k)), zero);
+        __m128i w = _mm_loadu_si128(reinterpret_cast<const __m128i*>(co + k));
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(px, w));
+      }
+      acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(1, 0, 3, 2)));
+      acc = _mm_add_epi32(acc, _mm_shuffle_epi32(acc, _MM_SHUFFLE(2, 3, 0, 1)));
+      out[x] = static_cast<int16_t>(
+          (_mm_cvtsi128_si32(acc) + round) >> kFixedHorzShift);
+    }
+  }
+  else if (c == 3 || c == 4) {
+    // 두 pixel 을 channel 별로 interleave 하여 계수 쌍과 madd.
+    // pixel 은 4 byte 씩 읽으므로 c == 3 이면 1 byte 를 더 읽는다. (row 여유분)
+    for (; x<out_w; x++) {
+      const uint8_t* in = row + (axis.first[x] - axis.lo) * c;
+      const int16_t* co = axis.coefs.data() + static_cast<size_t>(x) * taps;
+      __m128i acc = zero;
+      for (int k=0; k<taps; k+=2) {
+        int32_t p0, p1, w;
+        std::memcpy(&p0, in + k * c, 4);
+        std::memcpy(&p1, in + (k + 1) * c, 4);
+        std::memcpy(&w, co + k, 4);
+        __m128i a = _mm_unpacklo_epi8(_mm_cvtsi32_si128(p0), zero);
+        __m128i b = _mm_unpacklo_epi8(_mm_cvtsi32_si128(p1), zero);
+        acc = _mm_add_epi32(acc, _mm_madd_epi16(_mm_unpacklo_epi16(a, b),
+                                                _mm_set1_epi32(w)));
+      }
+      acc = _mm_srai_epi32(_mm_add_epi32(acc, vround), kFixedHorzShift);
+      int16_t v[8];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(v), _mm_packs_epi32(acc, acc));
+      std::memcpy(out + x * c, v, c * sizeof(int16_t));
+    }
+  }
+#endif
+  for (; x<out_w; x++) {
+    const uint8_t* in = row + (axis.first[x] - axis.lo) * c;
+    const int16_t* co = axis.coefs.data() + static_cast<size_t>(x) * taps;
+    for (int z=0; z<c; z++) {
+      int acc = 0;
+      for (int k=0; k<taps; k++)
+        acc += in[k * c + z] * co[k];
+      out[x * c + z] = static_cast<int16_t>((acc + round) >> kFixedHorzShift);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// 수직 pass. rows[k] 에 계수 co[k] 를 곱해 더한 뒤 0 ~ 255 로 clamp 한다.
+// n 은 짝수이며 len 은 row 의 int16 개수이다.
+//------------------------------------------------------------------------------
+static void fixed_vertical(const int16_t* const* rows, const int16_t* co,
+                           int n, int len, uint8_t* out) {
+  const int round = 1 << (kFixedVertShift - 1);
+  int i = 0;
+#ifdef __SSE2__
+  const __m128i vround = _mm_set1_epi32(round);
+  for (; i+8<=len; i+=8) {
+    __m128i lo = vround;
+    __m128i hi = vround;
+    for (int k=0; k<n; k+=2) {
+      __m128i r0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k] + i));
+      __m128i r1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rows[k + 1] + i));
+      int32_t w;
+      std::memcpy(&w, co + k, 4);
+      __m128i vw = _mm_set1_epi32(w);
+      lo = _mm_add_epi32(lo, _mm_madd_epi16(_mm_unpacklo_epi16(r0, r1), vw));
+      hi = _mm_add_epi32(hi, _mm_madd_epi16(_mm_unpackhi_epi16(r0, r1), vw));
+    }
+    lo = _mm_srai_epi32(lo, kFixedVertShift);
+    hi = _mm_srai_epi32(hi, kFixedVertShift);
+    __m128i v = _mm_packs_epi32(lo, hi);
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out + i), _mm_packus_epi16(v, v));
+  }
+#endif
+  for (; i<len; i++) {
+    int acc = round;
+    for (int k=0; k<n; k++)
+      acc += rows[k][i] * co[k];
+    out[i] = static_cast<uint8_t>(std::min(std::max(acc >> kFixedVertShift, 0), 255));
+  }
+}
+
+//------------------------------------------------------------------------------
+// 정수 resampler 의 plan. (ResizeBackend::kFixed)
+//------------------------------------------------------------------------------
+struct FixedPlan {
+  EdgeMode edge;
+  FixedAxis horz;
+  FixedAxis vert;
+  std::vector<int> horz_src;  // 입력 index lo + i 의 실제 column. (kZero 는 -1)
+};
+
+//------------------------------------------------------------------------------
+// 정수 resampler 로 출력 row [y_begin, y_end) 를 만든다.
+// 수평 pass 결과는 입력 row index 를 key 로 하는 ring 에 보관하여
+// 인접한 출력 row 사이에서 재사용한다.
+//------------------------------------------------------------------------------
+static void fixed_rows(const FixedPlan& plan, int in_h, int c,
+                       const uint8_t* input, size_t in_stride,
+                       int out_w, uint8_t* output, size_t out_stride,
+                       int y_begin, int y_end, const CancelToken* cancel) {
+  const FixedAxis& horz = plan.horz;
+  const FixedAxis& vert = plan.vert;
+  const int ring_size = vert.taps;
+  const size_t row_len = static_cast<size_t>(out_w) * c;
+  const size_t ring_stride = (row_len + 7) / 8 * 8 + 8;
+
+  static thread_local std::vector<uint8_t> padded;
+  static thread_local std::vector<int16_t> ring;
+  static thread_local std::vector<int> ring_rows;
+  static thread_local std::vector<const int16_t*> rows;
+  padded.resize(static_cast<size_t>(horz.hi - horz.lo) * c + 16);
+  ring.resize(ring_stride * ring_size);
+  ring_rows.assign(ring_size, INT32_MIN);
+  rows.resize(vert.taps);
+
+  auto fill_row = [&](int n, int16_t* dst) {
+    auto r = edgeIndex(plan.edge, n, in_h);
+    if (r < 0)
+      return false;
+    const uint8_t* src = input + static_cast<size_t>(r) * in_stride;
+    uint8_t* p = padded.data();
+    for (int i=0; i<horz.hi-horz.lo; ) {
+      auto s = plan.horz_src[i];
+      if (s < 0) {
+        std::memset(p + i * c, 0, c);
+        i++;
+        continue;
+      }
+      // 연속된 column 은 한 번에 복사.
+      int j = i + 1;
+      while (j < horz.hi - horz.lo && plan.horz_src[j] == s + (j - i))
+        j++;
+      std::memcpy(p + i * c, src + s * c, static_cast<size_t>(j - i) * c);
+      i = j;
+    }
+    fixed_horizontal(horz, c, p, out_w, dst);
+    return true;
+  };
+
+  for (int y=y_begin; y<y_end; y++) {
+    if (isCancelled(cancel))
+      return;
+    auto first = vert.first[y];
+    for (int k=0; k<vert.taps; k++) {
+      auto n = first + k;
+      auto slot = ((n % ring_size) + ring_size) % ring_size;
+      int16_t* dst = ring.data() + ring_stride * slot;
+      if (ring_rows[slot] != n) {
+        ring_rows[slot] = n;
+        if (!fill_row(n, dst))  // kZero 의 범위 밖 row.
+          std::fill(dst, dst + ring_stride, 0);
+      }
+      rows[k] = dst;
+    }
+    const int16_t* co = vert.coefs.data() + static_cast<size_t>(y) * vert.taps;
+    fixed_vertical(rows.data(), co, vert.taps, static_cast<int>(row_len),
+                   output + static_cast<size_t>(y) * out_stride);
+  }
+}
+
+//------------------------------------------------------------------------------
+// 정수 배율 축소. 출력 pixel 은 입력 (kh x kw) 영역의 반올림 평균이며
+// 입력의 각 pixel 은 정확히 한 번 읽는다.
+// 1) 출력 row 하나에 해당하는 kh 개의 입력 row 를 uint16 으로 누적하고
+// 2) 누적 row 에서 kw pixel 씩 더해 n = kh * kw 로 나눈다.
+// 나눗셈은 inv = ceil(2^32 / n) 곱셈으로 대신하며, n < 4096 이면
+// (합 + n/2) / n 과 정확히 같다.
+//------------------------------------------------------------------------------
+static const int kMaxAreaRows = 257;      // 257 * 255 <= uint16 최대값.
+static const int kMaxAreaPixels = 4095;
+
+struct AreaPlan {
+  int kh;
+  int kw;
+  uint64_t inv;
+};
+
+//------------------------------------------------------------------------------
+// acc[i] += in[i]
+//------------------------------------------------------------------------------
+static void area_add_row(const uint8_t* in, size_t len, uint16_t* acc) {
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i zero = _mm_setzero_si128();
+  for (; i+16<=len; i+=16) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in + i));
+    __m128i* a = reinterpret_cast<__m128i*>(acc + i);
+    _mm_storeu_si128(a, _mm_add_epi16(_mm_loadu_si128(a),
+                                      _mm_unpacklo_epi8(v, zero)));
+    _mm_storeu_si128(a + 1, _mm_add_epi16(_mm_loadu_si128(a + 1),
+                                          _mm_unpackhi_epi8(v, zero)));
+  }
+#endif
+  for (; i<len; i++)
+    acc[i] += in[i];
+}
+
+#ifdef __SSE2__
+//------------------------------------------------------------------------------
+// uint32 합 4 개의 반올림 평균. ((합 + half) * inv) >> 32 를 pmuludq 로
+// 짝수 lane 과 홀수 lane 으로 나누어 계산한다. (scalar 와 같은 값)
+//------------------------------------------------------------------------------
+static inline __m128i area_divide(__m128i sum, __m128i half, __m128i inv) {
+  const __m128i odd_mask = _mm_set_epi32(-1, 0, -1, 0);
+  sum = _mm_add_epi32(sum, half);
+  __m128i even = _mm_srli_epi64(_mm_mul_epu32(sum, inv), 32);
+  __m128i odd = _mm_mul_epu32(_mm_srli_epi64(sum, 32), inv);
+  return _mm_or_si128(even, _mm_and_si128(odd, odd_mask));
+}
+
+//------------------------------------------------------------------------------
+// 출력 값 4 개의 uint32 합. lane l 은 출력 pixel x + l / c 의 channel l % c
+// 이며, 3 channel 은 pixel 하나에 4 lane 을 쓰고 마지막 lane 은 버린다.
+//------------------------------------------------------------------------------
+template <int KW>
+static inline __m128i area_sum4(const uint16_t* acc, int x, int c, int kw) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i sum = zero;
+  if (c >= 3) {
+    const uint16_t* p = acc + static_cast<size_t>(x) * kw * c;
+    for (int i=0; i<kw; i++) {
+      __m128i v = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(p + i * c));
+      sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(v, zero));
+    }
+  }
+  else if (c == 2) {
+    const uint16_t* p0 = acc + static_cast<size_t>(x) * kw * 2;
+    const uint16_t* p1 = p0 + kw * 2;
+    for (int i=0; i<kw; i++) {
+      int32_t a, b;
+      std::memcpy(&a, p0 + i * 2, 4);
+      std::memcpy(&b, p1 + i * 2, 4);
+      __m128i v = _mm_unpacklo_epi32(_mm_cvtsi32_si128(a),
+                                     _mm_cvtsi32_si128(b));
+      sum = _mm_add_epi32(sum, _mm_unpacklo_epi16(v, zero));
+    }
+  }
+  else {
+    const uint16_t* p = acc + static_cast<size_t>(x) * kw;
+    for (int i=0; i<kw; i++) {
+      __m128i v = _mm_cvtsi32_si128(p[i]);
+      v = _mm_insert_epi16(v, p[kw + i], 2);
+      v = _mm_insert_epi16(v, p[2 * kw + i], 4);
+      v = _mm_insert_epi16(v, p[3 * kw + i], 6);
+      sum = _mm_add_epi32(sum, v);
+    }
+  }
+  return sum;
+}
+#endif
+
+//------------------------------------------------------------------------------
+// 누적 row 를 kw pixel 씩 더해 평균을 구한다. KW 가 0 이면 kw 를 사용한다.
+// (2x, 3x, 4x, 8x 는 KW 를 고정하여 compiler 가 loop 를 풀도록 한다)
+// SSE2 에서는 출력 16 byte 씩 더하고 나누어 pack 한다.
+//------------------------------------------------------------------------------
+template <int KW>
+static void area_reduce_row(const uint16_t* acc, int out_w, int c, int kw,
+                            const AreaPlan& plan, uint8_t* out) {
+  if (KW)
+    kw = KW;
+  const uint32_t half = static_cast<uint32_t>(plan.kh * kw) / 2;
+  int x = 0;
+#ifdef __SSE2__
+  // 한 번에 처리하는 출력 pixel 수. 3 channel 은 pixel 마다 4 byte 를
+  // 겹쳐 쓰므로 다음 pixel 이 남아 있을 때만 vector 로 처리한다.
+  // (5 channel 이상은 scalar)
+  const int step = c >= 3 ? 4 : 16 / c;
+  const int vec_w = c > 4 ? 0 : c == 3 ? out_w - 1 : out_w;
+  const int lanes = c >= 3 ? 1 : 4 / c;
+  const __m128i half4 = _mm_set1_epi32(static_cast<int32_t>(half));
+  const __m128i inv4 = _mm_set1_epi32(static_cast<int32_t>(plan.inv));
+  for (; x + step <= vec_w; x += step) {
+    __m128i q[4];
+    for (int k=0; k<4; k++) {
+      q[k] = area_divide(area_sum4<KW>(acc, x + k * lanes, c, kw), half4,
+                         inv4);
+    }
+    __m128i packed = _mm_packus_epi16(_mm_packs_epi32(q[0], q[1]),
+                                      _mm_packs_epi32(q[2], q[3]));
+    if (c == 3) {
+      uint32_t word[4];
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(word), packed);
+      for (int k=0; k<4; k++)
+        std::memcpy(out + (x + k) * 3, word + k, 4);
+    }
+    else {
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * c), packed);
+    }
+  }
+#endif
+  for (; x<out_w; x++) {
+    const uint16_t* p = acc + static_cast<size_t>(x) * kw * c;
+    for (int z=0; z<c; z++) {
+      uint32_t sum = half;
+      for (int i=0; i<kw; i++)
+        sum += p[i * c + z];
+      out[x * c + z] = static_cast<uint8_t>((sum * plan.inv) >> 32);
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// 정수 배율 축소로 출력 row [y_begin, y_end) 를 만든다.
+//------------------------------------------------------------------------------
+static void area_rows(const AreaPlan& plan, int in_w, int c,
+                      const uint8_t* input, size_t in_stride,
+                      int out_w, uint8_t* output, size_t out_stride,
+                      int y_begin, int y_end, const CancelToken* cancel) {
+  static thread_local std::vector<uint16_t> acc;
+  const size_t len = static_cast<size_t>(in_w) * c;
+  acc.resize(len);
+  for (int y=y_begin; y<y_end; y++) {
+    if (isCancelled(cancel))
+      return;
+    std::fill(acc.begin(), acc.end(), 0);
+    for (int r=0; r<plan.kh; r++) {
+      area_add_row(input + (static_cast<size_t>(y) * plan.kh + r) * in_stride,
+                   len, acc.data());
+    }
+    uint8_t* out = output + static_cast<size_t>(y) * out_stride;
+    switch (plan.kw) {
+      case 1: area_reduce_row<1>(acc.data(), out_w, c, 1, plan, out); break;
+      case 2: area_reduce_row<2>(acc.data(), out_w, c, 2, plan, out); break;
+      case 3: area_reduce_row<3>(acc.data(), out_w, c, 3, plan, out); break;
+      case 4: area_reduce_row<4>(acc.data(), out_w, c, 4, plan, out); break;
+      case 8: area_reduce_row<8>(acc.data(), out_w, c, 8, plan, out); break;
+      default:
+        area_reduce_row<0>(acc.data(), out_w, c, plan.kw, plan, out);
+        break;
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// options 와 크기가 정수 배율 축소 조건에 맞으면 plan 을 만든다.
+//------------------------------------------------------------------------------
+static bool make_area_plan(int in_h, int in_w, int out_h, int out_w,
+                           const ResizeOptions& options, AreaPlan* plan) {
+  if (options.high_quality || options.colorspace != ColorSpace::kLinear)
+    return false;
+  if (options.filter != ResizeFilter::kDefault &&
+      options.filter != ResizeFilter::kBox &&
+      options.filter != ResizeFilter::kFast)
+    return false;
+  if (in_h % out_h != 0 || in_w % out_w != 0)
+    return false;
+  plan->kh = in_h / out_h;
+  plan->kw = in_w / out_w;
+  auto n = static_cast<int64_t>(plan->kh) * plan->kw;
+  if (n <= 1 || n > kMaxAreaPixels || plan->kh > kMaxAreaRows)
+    return false;
+  plan->inv = ((uint64_t{1} << 32) + n - 1) / n;
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// nearest / bilinear resize. 출력 좌표마다 입력 위치 (pixel 중심 기준) 를
+// 미리 계산해 두고 필터 없이 1 개 또는 2x2 개의 입력 pixel 만 읽는다.
+// 입력 위치는 항상 [0, 크기) 안에 있으므로 EdgeMode 는 사용하지 않는다.
+// bilinear 가중치는 Q7 이며 수평 pass 결과는 int16 으로 둔다.
+// (255 * 128 * 128 이 int32 범위 안이다)
+//------------------------------------------------------------------------------
+static const int kPointBits = 7;
+static const int kPointOne = 1 << kPointBits;
+
+//------------------------------------------------------------------------------
+// 축 하나의 입력 위치. 출력 i 는 입력 first[i] 와 second[i] 를
+// (kPointOne - weights[i], weights[i]) 로 섞는다. nearest 는 first 만 쓴다.
+//------------------------------------------------------------------------------
+struct PointAxis {
+  std::vector<int> first;
+  std::vector<int> second;
+  std::vector<int16_t> weights;
+};
+
+struct PointPlan {
+  bool bilinear;
+  PointAxis horz;          // 수평 index 는 byte offset (pixel index * c).
+  PointAxis vert;
+  int gather_w;            // 4 byte gather 가 row 밖을 읽지 않는 출력 폭.
+};
+
+//------------------------------------------------------------------------------
+// in 개의 입력을 out 개로 줄이거나 늘릴 때의 입력 위치.
+// nearest 는 출력 pixel 중심이 속한 입력 pixel 이며 정수로만 계산한다.
+//------------------------------------------------------------------------------
+static void make_point_axis(int in, int out, bool bilinear, int scale,
+                            PointAxis* axis) {
+  axis->first.resize(out);
+  if (!bilinear) {
+    for (int o=0; o<out; o++) {
+      auto i = (2 * static_cast<int64_t>(o) + 1) * in / (2 * static_cast<int64_t>(out));
+      axis->first[o] = static_cast<int>(std::min<int64_t>(i, in - 1)) * scale;
+    }
+    return;
+  }
+  axis->second.resize(out);
+  axis->weights.resize(out);
+  const double ratio = static_cast<double>(in) / out;
+  for (int o=0; o<out; o++) {
+    double s = std::max(0.0, (o + 0.5) * ratio - 0.5);
+    auto i = static_cast<int>(s);
+    auto w = static_cast<int>(std::lround((s - i) * kPointOne));
+    if (w == kPointOne) {
+      i++;
+      w = 0;
+    }
+    if (i >= in - 1) {
+      i = in - 1;
+      w = 0;
+    }
+    axis->first[o] = i * scale;
+    axis->second[o] = std::min(i + 1, in - 1) * scale;
+    axis->weights[o] = static_cast<int16_t>(w);
+  }
+}
+
+//------------------------------------------------------------------------------
+// nearest 수평 pass. 입력 pixel 을 그대로 복사하므로 label 값이 보존된다.
+//------------------------------------------------------------------------------
+template <int C>
+static void nearest_row(const int* offsets, int begin, int end, int c,
+                        const uint8_t* in, uint8_t* out) {
+  if (C)
+    c = C;
+  for (int x=begin; x<end; x++) {
+    const uint8_t* p = in + offsets[x];
+    for (int z=0; z<c; z++)
+      out[x * c + z] = p[z];
+  }
+}
+
+#ifdef SAS_RESIZE_AVX2
+//------------------------------------------------------------------------------
+// nearest 수평 pass (AVX2, 1/3/4 channel). 8 pixel 의 4 byte 를 gather 한 뒤
+// 앞의 c byte 만 모은다. [0, end) 의 offset + 4 는 row 길이 이하여야 한다.
+//------------------------------------------------------------------------------
+SAS_TARGET_AVX2
+static int nearest_row_avx2(const int* offsets, int end, int c,
+                            const uint8_t* in, uint8_t* out) {
+  const __m256i pack1 = _mm256_setr_epi8(
+      0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+      0, 4, 8, 12, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+  const __m256i pack3 = _mm256_setr_epi8(
+      0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+      0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  const __m256i lanes1 = _mm256_setr_epi32(0, 4, 1, 1, 1, 1, 1, 1);
+  const __m256i lanes3 = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 3);
+  const int* base = reinterpret_cast<const int*>(in);
+  int x = 0;
+  for (; x+8<=end; x+=8) {
+    __m256i idx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(offsets + x));
+    __m256i v = _mm256_i32gather_epi32(base, idx, 1);
+    if (c == 4) {
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + x * 4), v);
+    } else if (c == 3) {
+      v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, pack3), lanes3);
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(out + x * 3),
+                       _mm256_castsi256_si128(v));
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x * 3 + 16),
+                       _mm256_extracti128_si256(v, 1));
+    } else {
+      v = _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, pack1), lanes1);
+      _mm_storel_epi64(reinterpret_cast<__m128i*>(out + x),
+                       _mm256_castsi256_si128(v));
+    }
+  }
+  return x;
+}
+#endif
+
+//------------------------------------------------------------------------------
+// bilinear 수평 pass. out[x] = in[first] * (1 - w) + in[second] * w (Q7)
+//------------------------------------------------------------------------------
+template <int C>
+static void bilinear_row(const PointAxis& axis, int out_w, int c,
+                         const uint8_t* in, int16_t* out) {
+  if (C)
+    c = C;
+  const int* first = axis.first.data();
+  const int* second = axis.second.data();
+  const int16_t* weights = axis.weights.data();
+  for (int x=0; x<out_w; x++) {
+    const uint8_t* a = in + first[x];
+    const uint8_t* b = in + second[x];
+    const int w1 = weights[x];
+    const int w0 = kPointOne - w1;
+    for (int z=0; z<c; z++)
+      out[x * c + z] = static_cast<int16_t>(a[z] * w0 + b[z] * w1);
+  }
+}
+
+//------------------------------------------------------------------------------
+// bilinear 수직 pass. 두 수평 결과를 (1 - w, w) 로 섞고 반올림한다.
+//------------------------------------------------------------------------------
+static void bilinear_blend(const int16_t* r0, const int16_t* r1, int w1,
+                           size_t len, uint8_t* out) {
+  const int w0 = kPointOne - w1;
+  const int shift = 2 * kPointBits;
+  const int round = 1 << (shift - 1);
+  size_t i = 0;
+#ifdef __SSE2__
+  const __m128i w = _mm_set1_epi32((w1 << 16) | w0);
+  const __m128i r = _mm_set1_epi32(round);
+  for (; i+16<=len; i+=16) {
+    __m128i res[2];
+    for (int k=0; k<2; k++) {
+      __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r0 + i + k * 8));
+      __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(r1 + i + k * 8));
+      __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi16(a, b), w);
+      __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi16(a, b), w);
+      lo = _mm_srai_epi32(_mm_add_epi32(lo, r), shift);
+      hi = _mm_srai_epi32(_mm_add_epi32(hi, r), shift);
+      res[k] = _mm_packs_epi32(lo, hi);
+    }
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                     _mm_packus_epi16(res[0], res[1]));
+  }
+#endif
+  for (; i<len; i++)
+    out[i] = static_cast<uint8_t>((r0[i] * w0 + r1[i] * w1 + round) >> shift);
+}
+
+//------------------------------------------------------------------------------
+// nearest / bilinear 로 출력 row [y_begin, y_end) 를 만든다.
+// bilinear 의 수평 결과는 입력 row 번호와 함께 두 개까지 보관하여
+// 확대 시 같은 입력 row 를 다시 계산하지 않는다.
+//------------------------------------------------------------------------------
+static void point_rows(const PointPlan& plan, int c,
+                       const uint8_t* input, size_t in_stride,
+                       int out_w, uint8_t* output, size_t out_stride,
+                       int y_begin, int y_end, const CancelToken* cancel) {
+  const size_t len = static_cast<size_t>(out_w) * c;
+  if (!plan.bilinear) {
+    const int* offsets = plan.horz.first.data();
+#ifdef SAS_RESIZE_AVX2
+    const bool simd = (c == 1 || c == 3 || c == 4) && cpu_has_avx2();
+#endif
+    for (int y=y_begin; y<y_end; y++) {
+      if (isCancelled(cancel))
+        return;
+      const uint8_t* in = input + plan.vert.first[y] * in_stride;
+      uint8_t* out = output + static_cast<size_t>(y) * out_stride;
+      int x = 0;
+#ifdef SAS_RESIZE_AVX2
+      if (simd)
+        x = nearest_row_avx2(offsets, plan.gather_w, c, in, out);
+#endif
+      switch (c) {
+        case 1: nearest_row<1>(offsets, x, out_w, 1, in, out); break;
+        case 3: nearest_row<3>(offsets, x, out_w, 3, in, out); break;
+        case 4: nearest_row<4>(offsets, x, out_w, 4, in, out); break;
+        default: nearest_row<0>(offsets, x, out_w, c, in, out); break;
+      }
+    }
+    return;
+  }
+
+  static thread_local std::vector<int16_t> rows[2];
+  int cached[2] = {-1, -1};
+  rows[0].resize(len);
+  rows[1].resize(len);
+  auto horizontal = [&](int src) -> const int16_t* {
+    for (int k=0; k<2; k++) {
+      if (cached[k] == src)
+        return rows[k].data();
+    }
+    // 현재 y 에서 쓰지 않는 slot 을 덮어쓴다. (src 는 증가한다)
+    int k = cached[0] < cached[1] ? 0 : 1;
+    const uint8_t* in = input + src * in_stride;
+    switch (c) {
+      case 1: bilinear_row<1>(plan.horz, out_w, 1, in, rows[k].data()); break;
+      case 3: bilinear_row<3>(plan.horz, out_w, 3, in, rows[k].data()); break;
+      case 4: bilinear_row<4>(plan.horz, out_w, 4, in, rows[k].data()); break;
+      default: bilinear_row<0>(plan.horz, out_w, c, in, rows[k].data()); break;
+    }
+    cached[k] = src;
+    return rows[k].data();
+  };
+  for (int y=y_begin; y<y_end; y++) {
+    if (isCancelled(cancel))
+      return;
+    const int w1 = plan.vert.weights[y];
+    const int16_t* r0 = horizontal(plan.vert.first[y]);
+    const int16_t* r1 = w1 ? horizontal(plan.vert.second[y]) : r0;
+    bilinear_blend(r0, r1, w1, len,
+                   output + static_cast<size_t>(y) * out_stride);
+  }
+}
+
+//------------------------------------------------------------------------------
+// kNearest, kBilinear 필터의 plan 을 만든다.
+//------------------------------------------------------------------------------
+static bool make_point_plan(int in_h, int in_w, int out_h, int out_w, int c,
+                            const ResizeOptions& options, PointPlan* plan) {
+  if (options.filter != ResizeFilter::kNearest &&
+      options.filter != ResizeFilter::kBilinear)
+    return false;
+  plan->bilinear = options.filter == ResizeFilter::kBilinear;
+  make_point_axis(in_w, out_w, plan->bilinear, c, &plan->horz);
+  make_point_axis(in_h, out_h, plan->bilinear, 1, &plan->vert);
+  const int row_len = in_w * c;
+  plan->gather_w = 0;
+  if (!plan->bilinear) {
+    while (plan->gather_w < out_w &&
+           plan->horz.first[plan->gather_w] + 4 <= row_len)
+      plan->gather_w++;
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// plan cache 의 key. (입력 크기, 출력 크기, channel, options)
+//------------------------------------------------------------------------------
+struct ResizePlanKey {
+  int in_h;
+  int in_w;
+  int out_h;
+  int out_w;
+  int c;
+  ResizeFilter filter;
+  EdgeMode edge;
+  ColorSpace colorspace;
+  ResizeBackend backend;
+  bool high_quality;
+  bool alpha;
+
+  bool operator<(const ResizePlanKey& key) const {
+    return std::tie(in_h, in_w, out_h, out_w, c,
+                    filter, edge, colorspace, backend, high_quality, alpha) <
+           std::tie(key.in_h, key.in_w, key.out_h, key.out_w, key.c,
+                    key.filter, key.edge, key.colorspace, key.backend,
+                    key.high_quality, key.alpha);
+  }
+};
+
+//------------------------------------------------------------------------------
+// ResizePlan LRU cache. 가장 최근에 사용한 plan 이 list 의 앞에 있다.
+//------------------------------------------------------------------------------
+struct ResizePlanCache {
+  typedef std::pair<ResizePlanKey, std::shared_ptr<const ResizePlan>> Entry;
+
+  std::mutex mutex;
+  size_t capacity;
+  std::list<Entry> lru;
+  std::map<ResizePlanKey, std::list<Entry>::iterator> index;
+
+  ResizePlanCache() : capacity{64} {}
+
+  // capacity 를 넘는 오래된 plan 제거. (mutex 를 잡은 상태에서 호출)
+  void evict() {
+    while (lru.size() > capacity) {
+      index.erase(lru.back().first);
+      lru.pop_back();
+    }
+  }
+};
+
+static ResizePlanCache& plan_cache() {
+  static ResizePlanCache cache;
+  return cache;
+}
+
+ResizePlan::ResizePlan() : impl_(new Impl) {
+}
+
+ResizePlan::~ResizePlan() {
+}
+
+//------------------------------------------------------------------------------
+// options 에 따른 plan 생성. (stbir_resize_uint8_generic 과 같은 설정)
+//------------------------------------------------------------------------------
+std::shared_ptr<const ResizePlan> ResizePlan::create(
+    int in_h, int in_w, int out_h, int out_w, int c,
+    const ResizeOptions& options) {
+  if (options.filter < ResizeFilter::kDefault ||
+      options.filter > ResizeFilter::kBilinear)
+    return nullptr;
+  if (options.edge < EdgeMode::kClamp || options.edge > EdgeMode::kZero)
+    return nullptr;
+  if (options.colorspace != ColorSpace::kLinear &&
+      options.colorspace != ColorSpace::kSRGB)
+    return nullptr;
+  if (options.backend != ResizeBackend::kFloat &&
+      options.backend != ResizeBackend::kFixed)
+    return nullptr;
+
+  std::shared_ptr<ResizePlan> plan(new ResizePlan());
+  auto edge = static_cast<stbir_edge>(options.edge);
+  // 2/4 channel 의 마지막 channel 이 alpha 이다.
+  bool alpha = options.alpha && (c == 2 || c == 4);
+  if (!setup_resize(&plan->impl_->info, &plan->impl_->filters,
+                    in_w, in_h, out_w, out_h,
+                    c, alpha ? c - 1 : STBIR_ALPHA_CHANNEL_NONE, 0,
+                    STBIR_TYPE_UINT8,
+                    to_stbir_filter(options.filter, in_w, out_w),
+                    to_stbir_filter(options.filter, in_h, out_h),
+                    edge, edge,
+                    static_cast<stbir_colorspace>(options.colorspace)))
+    return nullptr;
+  plan->impl_->options = options;
+
+  std::unique_ptr<PointPlan> point(new PointPlan);
+  if (make_point_plan(in_h, in_w, out_h, out_w, c, options, point.get())) {
+    plan->impl_->point = std::move(point);
+    return plan;
+  }
+
+  std::unique_ptr<AreaPlan> area(new AreaPlan);
+  if (!alpha && make_area_plan(in_h, in_w, out_h, out_w, options, area.get())) {
+    plan->impl_->area = std::move(area);
+    return plan;
+  }
+
+  // 정수 backend 는 alpha 가 없는 linear 색 공간만 지원한다.
+  // (sRGB 와 alpha 는 float 로 계산)
+  if (options.backend == ResizeBackend::kFixed && !alpha &&
+      options.colorspace == ColorSpace::kLinear) {
+    std::unique_ptr<FixedPlan> fixed(new FixedPlan);
+    const auto& info = plan->impl_->info;
+    fixed->edge = options.edge;
+    if (make_fixed_axis(info, true, c == 1 ? 8 : 2, &fixed->horz) &&
+        make_fixed_axis(info, false, 2, &fixed->vert)) {
+      for (int i=fixed->horz.lo; i<fixed->horz.hi; i++)
+        fixed->horz_src.push_back(edgeIndex(options.edge, i, in_w));
+      plan->impl_->fixed = std::move(fixed);
+    }
+  }
+  if (!plan->impl_->fixed) {
+    plan->impl_->simd.reset(new FloatPlan);
+    make_float_plan(plan->impl_->info, plan->impl_->simd.get());
+  }
+  return plan;
+}
+
+//------------------------------------------------------------------------------
+// cache 에서 plan 을 찾는다. 없으면 lock 밖에서 계산한 뒤 cache 에 넣는다.
+//------------------------------------------------------------------------------
+std::shared_ptr<const ResizePlan> ResizePlan::get(
+    int in_h, int in_w, int out_h, int out_w, int c,
+    const ResizeOptions& options) {
+  auto& cache = plan_cache();
+  ResizePlanKey key = {in_h, in_w, out_h, out_w, c,
+                       options.filter, options.edge, options.colorspace,
+                       options.backend, options.high_quality,
+                       options.alpha};
+  {
+    std::lock_guard<std::mutex> lock(cache.mutex);
+    auto it = cache.index.find(key);
+    if (it != cache.index.end()) {
+      cache.lru.splice(cache.lru.begin(), cache.lru, it->second);
+      return it->second->second;
+    }
+  }
+
+  auto plan = create(in_h, in_w, out_h, out_w, c, options);
+  if (!plan)
+    return nullptr;
+
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  if (cache.capacity == 0)
+    return plan;
+  auto it = cache.index.find(key);
+  if (it != cache.index.end()) {
+    // 다른 thread 가 먼저 넣은 경우 그것을 사용.
+    cache.lru.splice(cache.lru.begin(), cache.lru, it->second);
+    return it->second->second;
+  }
+  cache.lru.emplace_front(key, plan);
+  cache.index[key] = cache.lru.begin();
+  cache.evict();
+  return plan;
+}
+
+void ResizePlan::setCacheCapacity(size_t capacity) {
+  auto& cache = plan_cache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.capacity = capacity;
+  cache.evict();
+}
+
+void ResizePlan::clearCache() {
+  auto& cache = plan_cache();
+  std::lock_guard<std::mutex> lock(cache.mutex);
+  cache.index.clear();
+  cache.lru.clear();
+}
+
+int ResizePlan::inH() const { return impl_->info.input_h; }
+int ResizePlan::inW() const { return impl_->info.input_w; }
+int ResizePlan::outH() const { return impl_->info.output_h; }
+int ResizePlan::outW() const { return impl_->info.output_w; }
+int ResizePlan::c() const { return impl_->info.channels; }
+const ResizeOptions& ResizePlan::options() const { return impl_->options; }
+
+//------------------------------------------------------------------------------
+// plan 으로 resize 실행. plan 의 상태는 바꾸지 않는다.
+//------------------------------------------------------------------------------
+bool ResizePlan::run(const uint8_t* input, int in_stride,
+                     uint8_t* output, int out_stride,
+                     const CancelToken* cancel) const {
+  if (!input || !output)
+    return false;
+  if (impl_->point) {
+    const auto& info = impl_->info;
+    const auto c = info.channels;
+    const size_t in_step = in_stride ? in_stride : c * info.input_w;
+    const size_t out_step = out_stride ? out_stride : c * info.output_w;
+    auto in_pixels = static_cast<size_t>(info.input_w) * info.input_h;
+    auto out_pixels = static_cast<size_t>(info.output_w) * info.output_h;
+    for_each_band(in_pixels, out_pixels, info.output_h, [&](int y0, int y1) {
+      point_rows(*impl_->point, c, input, in_step,
+                 info.output_w, output, out_step, y0, y1, cancel);
+    });
+    return !isCancelled(cancel);
+  }
+  if (impl_->area) {
+    const auto& info = impl_->info;
+    const auto c = info.channels;
+    const size_t in_step = in_stride ? in_stride : c * info.input_w;
+    const size_t out_step = out_stride ? out_stride : c * info.output_w;
+    auto in_pixels = static_cast<size_t>(info.input_w) * info.input_h;
+    auto out_pixels = static_cast<size_t>(info.output_w) * info.output_h;
+    for_each_band(in_pixels, out_pixels, info.output_h, [&](int y0, int y1) {
+      area_rows(*impl_->area, info.input_w, c, input, in_step,
+                info.output_w, output, out_step, y0, y1, cancel);
+    });
+    return !isCancelled(cancel);
+  }
+
+  if (impl_->fixed) {
+    const auto& info = impl_->info;
+    const auto c = info.channels;
+    const size_t in_step = in_stride ? in_stride : c * info.input_w;
+    const size_t out_step = out_stride ? out_stride : c * info.output_w;
+    auto in_pixels = static_cast<size_t>(info.input_w) * info.input_h;
+    auto out_pixels = static_cast<size_t>(info.output_w) * info.output_h;
+    for_each_band(in_pixels, out_pixels, info.output_h, [&](int y0, int y1) {
+      fixed_rows(*impl_->fixed, info.input_h, c,
+                 input, in_step, info.output_w, output, out_step, y0, y1,
+                 cancel);
+    });
+    return !isCancelled(cancel);
+  }
+
+  stbir__info info = impl_->info;
+  auto type_size = stbir__type_size[info.type];
+  info.input_data = input;
+  info.input_stride_bytes =
+      in_stride ? in_stride : info.channels * info.input_w * type_size;
+  info.output_data = output;
+  info.output_stride_bytes =
+      out_stride ? out_stride : info.channels * info.output_w * type_size;
+  resize_bands(info, impl_->simd.get(), cancel);
+  return !isCancelled(cancel);
+}
+
+//------------------------------------------------------------------------------
+// options 설정의 uint8 resize.
+//------------------------------------------------------------------------------
+bool resizeUint8(const uint8_t* input, int in_h, int in_w, int in_stride,
+                 uint8_t* output, int out_h, int out_w, int out_stride, int c,
+                 const ResizeOptions& options, const CancelToken* cancel) {
+  if (isCancelled(cancel))
+    return false;
+  auto plan = ResizePlan::get(in_h, in_w, out_h, out_w, c, options);
+  if (!plan)
+    return false;
+  return plan->run(input, in_stride, output, out_stride, cancel);
+}
+
+//------------------------------------------------------------------------------
+// StreamingResizer 의 상태.
+// 출력 row y 는 가상 입력 row [first[y], first[y] + taps) 를 weights 로 더한다.
+// 가상 row n 의 내용은 입력 row edgeIndex(n) 를 수평 resample 한 것이므로,
+// 입력 row 를 받는 즉시 수평 pass 를 하고 ring 에 입력 row 번호로 둔다.
+// need[y] 는 출력 y 에 필요한 마지막 입력 row 이다.
+//------------------------------------------------------------------------------
+struct StreamingResizer::Impl {
+  std::shared_ptr<const ResizePlan> plan;
+  stbir__info info;           // decode buffer 를 연결한 plan 의 복사본.
+  RowCallback callback;
+  int taps;
+  std::vector<int> first;
+  std::vector<float> weights;
+  std::vector<int> need;
+  int capacity;               // ring 의 row 수.
+  size_t row_len;             // 수평 resample 한 row 의 float 수.
+  std::vector<float> ring;
+  std::vector<float> decode;  // stbir decode buffer.
+  std::vector<float*> rows;  // emit() 에서 사용하는 row 와 계수.
+  std::vector<float> coefs;
+  std::vector<float> acc;
+  std::vector<uint8_t> out;
+  int rows_in;
+  int rows_out;
+
+  void emit(int y);
+};
+
+//------------------------------------------------------------------------------
+// 출력 row y 를 계산하여 callback 으로 넘긴다.
+//------------------------------------------------------------------------------
+void StreamingResizer::Impl::emit(int y) {
+  const auto& options = plan->options();
+  const int in_h = info.input_h;
+  int num = 0;
+  for (int k=0; k<taps; k++) {
+    float w = weights[static_cast<size_t>(y) * taps + k];
+    int src = edgeIndex(options.edge, first[y] + k, in_h);
+    if (w == 0.0f || src < 0)
+      continue;
+    rows[num] = ring.data() + static_cast<size_t>(src % capacity) * row_len;
+    coefs[num++] = w;
+  }
+  const FloatPlan* simd = plan->impl_->simd.get();
+#ifdef SAS_RESIZE_AVX2
+  if (simd && simd->simd) {
+    vertical_sum_avx2(rows.data(), coefs.data(), num,
+                      static_cast<int>(row_len), acc.data());
+  } else
+#endif
+  {
+    for (size_t i=0; i<row_len; i++) {
+      float sum = 0;
+      for (int k=0; k<num; k++)
+        sum += rows[k][i] * coefs[k];
+      acc[i] = sum;
+    }
+  }
+  encode_scanline(&info, simd, out.data(), acc.data());
+  callback(y, out.data());
+}
+
+StreamingResizer::StreamingResizer() {
+}
+
+StreamingResizer::~StreamingResizer() {
+}
+
+//------------------------------------------------------------------------------
+// 필터 계수와 ring 크기를 계산한다.
+//------------------------------------------------------------------------------
+bool StreamingResizer::open(int in_h, int in_w, int out_h, int out_w, int c,
+                            const RowCallback& callback,
+                            const ResizeOptions& options) {
+  close();
+  if (!callback || options.edge == EdgeMode::kWrap ||
+      options.filter == ResizeFilter::kNearest ||
+      options.filter == ResizeFilter::kBilinear)
+    return false;
+  ResizeOptions float_options = options;
+  float_options.backend = ResizeBackend::kFloat;
+  float_options.high_quality = true;
+  auto plan = ResizePlan::create(in_h, in_w, out_h, out_w, c, float_options);
+  if (!plan)
+    return false;
+
+  std::unique_ptr<Impl> impl(new Impl);
+  impl->plan = plan;
+  impl->info = plan->impl_->info;
+  impl->callback = callback;
+  if (!gather_axis(impl->info, false, 1, &impl->first, &impl->weights,
+                   &impl->taps))
+    return false;
+  impl->rows.resize(impl->taps);
+  impl->coefs.resize(impl->taps);
+
+  // 출력 y 가 필요로 하는 입력 row 범위 [lo, need]. 출력 y 를 만들 때
+  // 보관하고 있어야 하는 row 는 [y 이후 lo 의 최소값, need[y]] 이다.
+  std::vector<int> lo(out_h, in_h);
+  impl->need.assign(out_h, 0);
+  for (int y=0; y<out_h; y++) {
+    for (int k=0; k<impl->taps; k++) {
+      int src = edgeIndex(options.edge, impl->first[y] + k, in_h);
+      if (impl->weights[static_cast<size_t>(y) * impl->taps + k] == 0.0f ||
+          src < 0)
+        continue;
+      lo[y] = std::min(lo[y], src);
+      impl->need[y] = std::max(impl->need[y], src);
+    }
+  }
+  // 출력은 순서대로 내보내므로 need 를 증가하는 값으로 맞춘다.
+  for (int y=1; y<out_h; y++)
+    impl->need[y] = std::max(impl->need[y], impl->need[y - 1]);
+  impl->capacity = 1;
+  int lo_min = in_h;
+  for (int y=out_h-1; y>=0; y--) {
+    lo_min = std::min(lo_min, lo[y]);
+    impl->capacity = std::max(impl->capacity, impl->need[y] - lo_min + 1);
+  }
+
+  auto& info = impl->info;
+  impl->row_len = static_cast<size_t>(out_w) * c;
+  impl->ring.assign(impl->row_len * impl->capacity, 0.0f);
+  impl->decode.assign(info.decode_buffer_size / sizeof(float) + kDecodeSlack,
+                      0.0f);
+  impl->acc.assign(impl->row_len, 0.0f);
+  impl->out.assign(impl->row_len, 0);
+  info.decode_buffer = impl->decode.data();
+  info.horizontal_buffer = NULL;
+  info.ring_buffer = NULL;
+  info.encode_buffer = NULL;
+  // decode_scanline(0) 이 push 된 row 를 읽도록 stride 를 0 으로 둔다.
+  info.input_stride_bytes = 0;
+  impl->rows_in = 0;
+  impl->rows_out = 0;
+  impl_ = std::move(impl);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// 입력 row 를 수평 resample 하여 ring 에 넣고, 완성된 출력 row 를 내보낸다.
+//------------------------------------------------------------------------------
+bool StreamingResizer::push(const uint8_t* row) {
+  if (!impl_ || !row || impl_->rows_in >= impl_->info.input_h)
+    return false;
+  auto& info = impl_->info;
+  const FloatPlan* simd = impl_->plan->impl_->simd.get();
+  info.input_data = row;
+  decode_scanline(&info, simd, 0);
+  float* dst = impl_->ring.data() +
+               static_cast<size_t>(impl_->rows_in % impl_->capacity) *
+               impl_->row_len;
+  resample_horizontal(&info, simd, dst);
+  impl_->rows_in++;
+
+  while (impl_->rows_out < info.output_h &&
+         impl_->need[impl_->rows_out] < impl_->rows_in)
+    impl_->emit(impl_->rows_out++);
+  return true;
+}
+
+//------------------------------------------------------------------------------
+// 상태와 buffer 를 해제한다.
+//------------------------------------------------------------------------------
+void StreamingResizer::close() {
+  impl_.reset();
+}
+
+int StreamingResizer::rowsIn() const {
+  return impl_ ? impl_->rows_in : 0;
+}
+
+int StreamingResizer::rowsOut() const {
+  return impl_ ? impl_->rows_out : 0;
+}
+
+bool StreamingResizer::done() const {
+  return impl_ && impl_->rows_out == impl_->info.output_h;
+}
+
+}  // namespace sas
@@ -0,0 +1,214 @@
+//------------------------------------------------------------------------------
+// @file util/resize.h
+//------------------------------------------------------------------------------
+#ifndef SAS_CATEGORY_UTIL_RESIZE_H_
+#define SAS_CATEGORY_UTIL_RESIZE_H_
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+#include "cancel.h"
+
+namespace sas {
+
+//------------------------------------------------------------------------------
+// 이미지 범위 밖을 참조할 때의 처리 방식. (stbir_edge 와 같은 값을 사용한다)
+//------------------------------------------------------------------------------
+enum class EdgeMode {
+  kClamp   = 1,  // 가장자리 pixel 을 반복.
+  kReflect = 2,  // 가장자리를 기준으로 대칭.
+  kWrap    = 3,  // 반대편 가장자리로 이어짐.
+  kZero    = 4,  // 0 으로 채움.
+};
+
+// edge 방식에 따라 범위 밖 index n 을 [0, max) 로 변환한다. kZero 이면 -1.
+int edgeIndex(EdgeMode edge, int n, int max);
+
+//------------------------------------------------------------------------------
+// resize 필터. (kFast, kNearest, kBilinear 외에는 stbir_filter 와 같은 값)
+//------------------------------------------------------------------------------
+enum class ResizeFilter {
+  kDefault      = 0,  // 확대는 Catmull-Rom, 축소는 Mitchell.
+  kBox          = 1,  // 정수 배율에서는 box 평균과 같다.
+  kTriangle     = 2,  // 확대 시 bilinear 와 같다.
+  kCubicBSpline = 3,  // gaussian 에 가까운 부드러운 결과.
+  kCatmullRom   = 4,  // 보간형 cubic spline.
+  kMitchell     = 5,  // Mitchell-Netravali (B=1/3, C=1/3).
+  kFast         = 6,  // 축소는 box, 확대는 triangle. (미리보기용)
+  kNearest      = 7,  // 가장 가까운 pixel 복사. 값이 보존되어 mask 에 사용.
+  kBilinear     = 8,  // 2x2 pixel 선형 보간. (Q7 가중치, 오차 최대 2)
+};
+
+//------------------------------------------------------------------------------
+// resize 시 channel 값의 색 공간. (stbir_colorspace 와 같은 값을 사용한다)
+//------------------------------------------------------------------------------
+enum class ColorSpace {
+  kLinear = 0,
+  kSRGB   = 1,  // 선형 공간으로 변환하여 계산한 뒤 되돌린다. (모든 channel)
+                // 대비가 큰 축소에서 어두워지지 않는다.
+};
+
+//------------------------------------------------------------------------------
+// resize 계산 방식.
+//------------------------------------------------------------------------------
+enum class ResizeBackend {
+  kFloat,  // stbir 의 float 계산.
+  kFixed,  // 8bit 입력을 int16 계수 (Q14) 로 직접 계산. float 결과와
+           // 대부분 같고 최대 1 차이이다. AVX2 가 없는 CPU 에서는 kFloat 보다
+           // 빠르다. (sRGB 는 kFloat 로 처리)
+};
+
+//------------------------------------------------------------------------------
+// @struct ResizeOptions
+//------------------------------------------------------------------------------
+// resize 필터, 가장자리 처리, 색 공간 설정.
+// 기본값은 stbir_resize_uint8 과 같다. fast() 는 폭이 좁은 필터를 사용하여
+// 큰 축소에서 기본 설정보다 몇 배 빠르다.
+//
+// 입력 크기가 출력 크기의 정수배인 축소 (예: 4000x3000 -> 1000x750) 는
+// kDefault, kBox, kFast 필터이고 linear 이면 (kh x kw) 영역의 반올림 평균으로
+// 바로 계산한다. 입력을 한 번만 읽으므로 일반 필터보다 훨씬 빠르다.
+// high_quality 가 true 이면 이 경우에도 지정한 필터를 그대로 사용한다.
+//
+// alpha 가 true 이면 2/4 channel 의 마지막 channel 을 straight alpha 로 보고
+// 색에 alpha 를 곱한 뒤 계산하고 다시 나눈다. 투명한 pixel 의 색이 주변으로
+// 번지지 않는다. (alpha 는 sRGB 변환하지 않는다)
+//
+// kNearest, kBilinear 는 필터 없이 입력 pixel 만 읽는 별도 경로이며
+// edge, colorspace, backend, alpha 설정을 사용하지 않는다.
+// kNearest 의 출력 값은 모두 입력에 있는 값이므로 label mask 에 사용할 수 있다.
+// kNearest 의 출력 o 는 출력 pixel 중심이 속한 입력 pixel
+// i = (2 * o + 1) * in / (2 * out) 이다. (축마다 정수 나눗셈)
+//------------------------------------------------------------------------------
+struct ResizeOptions {
+  ResizeFilter filter;
+  EdgeMode edge;
+  ColorSpace colorspace;
+  ResizeBackend backend;
+  bool high_quality;
+  bool alpha;
+
+  ResizeOptions(ResizeFilter filter=ResizeFilter::kDefault,
+                EdgeMode edge=EdgeMode::kClamp,
+                ColorSpace colorspace=ColorSpace::kLinear,
+                ResizeBackend backend=ResizeBackend::kFloat)
+      : filter{filter}, edge{edge}, colorspace{colorspace}, backend{backend},
+        high_quality{false}, alpha{false} {}
+
+  static ResizeOptions fast() { return ResizeOptions(ResizeFilter::kFast); }
+  static ResizeOptions nearest() {
+    return ResizeOptions(ResizeFilter::kNearest);
+  }
+  static ResizeOptions bilinear() {
+    return ResizeOptions(ResizeFilter::kBilinear);
+  }
+};
+
+//------------------------------------------------------------------------------
+// @class ResizePlan
+//------------------------------------------------------------------------------
+// (입력 크기, 출력 크기, channel, ResizeOptions) 조합에 대해 미리 계산한
+// resize 필터 계수.
+// 생성 후에는 변경되지 않으므로 여러 thread 에서 동시에 run() 할 수 있다.
+// 같은 조합이 반복되는 경우 get() 으로 LRU cache 에서 재사용한다.
+//------------------------------------------------------------------------------
+class ResizePlan {
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+
+  ResizePlan();
+  friend class StreamingResizer;
+
+ public:
+  ~ResizePlan();
+  ResizePlan(const ResizePlan&) = delete;
+  ResizePlan& operator=(const ResizePlan&) = delete;
+
+  // cache 를 거치지 않고 새로 계산한다. 잘못된 크기이면 nullptr.
+  static std::shared_ptr<const ResizePlan> create(
+      int in_h, int in_w, int out_h, int out_w, int c,
+      const ResizeOptions& options=ResizeOptions());
+  // LRU cache 에서 찾고, 없으면 계산하여 cache 에 넣는다.
+  static std::shared_ptr<const ResizePlan> get(
+      int in_h, int in_w, int out_h, int out_w, int c,
+      const ResizeOptions& options=ResizeOptions());
+  // cache 에 유지할 plan 의 최대 개수. 0 이면 cache 를 사용하지 않는다.
+  static void setCacheCapacity(size_t capacity);
+  static void clearCache();
+
+ public:
+  int inH() const;
+  int inW() const;
+  int outH() const;
+  int outW() const;
+  int c() const;
+  const ResizeOptions& options() const;
+
+  // stride 는 byte 단위이며, 0 이면 빈틈 없이 연속된 row 로 본다.
+  // cancel 이 취소되면 출력 row 경계에서 멈추고 false 를 반환한다.
+  // (이 때 출력은 일부만 기록되어 있다)
+  bool run(const uint8_t* input, int in_stride,
+           uint8_t* output, int out_stride,
+           const CancelToken* cancel=nullptr) const;
+};
+
+//------------------------------------------------------------------------------
+// uint8 이미지 resize. (h, w, c) 순서로 크기를 받고, stride 는 byte 단위이다.
+// kFloat backend 의 기본 options 는 stbir_resize_uint8, 그 외는
+// stbir_resize_uint8_generic 과 bit 단위로 같은 결과를 낸다.
+// (정수 배율 축소는 area 평균, kNearest/kBilinear 는 별도 경로. ResizeOptions 참고)
+// (1/3/4 channel 은 AVX2 지원 시 SIMD kernel 을 사용하며, sRGB 변환도 포함한다)
+// 큰 이미지는 출력을 row band 로 나누어
+// ThreadPool 에서 병렬로 계산한다.
+// 필터 계수는 ResizePlan::get() 의 cache 를 사용한다.
+// cancel 이 취소되면 false 를 반환한다. (ResizePlan::run 참고)
+//------------------------------------------------------------------------------
+bool resizeUint8(const uint8_t* input, int in_h, int in_w, int in_stride,
+                 uint8_t* output, int out_h, int out_w, int out_stride, int c,
+                 const ResizeOptions& options=ResizeOptions(),
+                 const CancelToken* cancel=nullptr);
+
+//------------------------------------------------------------------------------
+// @class StreamingResizer
+//------------------------------------------------------------------------------
+// 입력 row 를 위에서부터 하나씩 받아, 출력 row 가 완성되는 즉시 callback 으로
+// 넘긴다. 수평 resample 한 row 를 필터 높이 만큼만 보관하므로 memory 는
+// O(필터 높이 x 출력 폭) 이며, 입력과 출력 전체를 memory 에 둘 수 없는
+// 큰 이미지에 사용한다.
+// 결과는 high_quality, kFloat 설정의 resizeUint8 과 같다.
+// 위쪽 가장자리에 마지막 row 가 필요한 EdgeMode::kWrap 과
+// kNearest, kBilinear 필터는 지원하지 않는다.
+//------------------------------------------------------------------------------
+class StreamingResizer {
+ public:
+  // y 번째 출력 row. row 는 callback 안에서만 유효하다.
+  typedef std::function<void(int y, const uint8_t* row)> RowCallback;
+
+ private:
+  struct Impl;
+  std::unique_ptr<Impl> impl_;
+
+ public:
+  StreamingResizer();
+  ~StreamingResizer();
+  StreamingResizer(const StreamingResizer&) = delete;
+  StreamingResizer& operator=(const StreamingResizer&) = delete;
+
+  // 크기와 callback 을 설정한다. 잘못된 인자이면 false.
+  bool open(int in_h, int in_w, int out_h, int out_w, int c,
+            const RowCallback& callback,
+            const ResizeOptions& options=ResizeOptions());
+  // 다음 입력 row (in_w * c byte). 입력이 이미 끝났으면 false.
+  bool push(const uint8_t* row);
+  void close();
+
+  int rowsIn() const;
+  int rowsOut() const;
+  // 모든 출력 row 를 callback 으로 넘겼는지 여부.
+  bool done() const;
+};
+
+}  // namespace sas
+#endif  // SAS_CATEGORY_UTIL_RESIZE_H_
@@ -355,6 +355,11 @@ typedef struct
 
 STBIDEF stbi_uc *stbi_load_from_memory   (stbi_uc           const *buffer, int len   , int *x, int *y, int *channels_in_file, int desired_channels);
 STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk  , void *user, int *x, int *y, int *channels_in_file, int desired_channels);
+// Same as stbi_load_from_callbacks, but reads through a caller buffer of
+// buflen bytes instead of the 128 bytes in the decode context, so the
+// callbacks see few large reads. buffer must stay valid during the call;
+// buffers smaller than 128 bytes are ignored.
+STBIDEF stbi_uc *stbi_load_from_callbacks_buffered(stbi_io_callbacks const *clbk, void *user, stbi_uc *buffer, int buflen, int *x, int *y, int *channels_in_file, int desired_channels);
 #ifndef STBI_NO_GIF
 STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int **delays, int *x, int *y, int *z, int *comp, int req_comp);
 #endif
@@ -366,6 +371,23 @@ STBIDEF stbi_uc *stbi_load_from_file  (FILE *f, int *x, int *y, int *channels_in
 // for stbi_load_from_file, file pointer is left pointing immediately after image
 #endif
 
+// Same as stbi_load_from_memory / stbi_load, but JPEG images are decoded at
+// 1/2, 1/4 or 1/8 scale (the smallest one whose size is still at least
+// min_x by min_y). *x and *y report the decoded size. Other formats, and
+// min_x == min_y == 0, decode at full size.
+STBIDEF stbi_uc *stbi_load_from_memory_scaled(stbi_uc const *buffer, int len, int *x, int *y, int *channels_in_file, int desired_channels, int min_x, int min_y);
+#ifndef STBI_NO_STDIO
+STBIDEF stbi_uc *stbi_load_scaled     (char const *filename, int *x, int *y, int *channels_in_file, int desired_channels, int min_x, int min_y);
+#endif
+
+// Same as stbi_load_from_memory_scaled, but writes the pixels to a caller
+// buffer of out_h rows, out_stride bytes apart, each holding at least out_w
+// pixels of desired_channels (1..4) bytes. The image goes to the top left;
+// the rest of the buffer is unspecified afterwards. Returns 0 if the image
+// does not fit or cannot be decoded. JPEG images are written directly by the
+// decoder, other formats are decoded as usual and then copied.
+STBIDEF int      stbi_load_from_memory_into(stbi_uc const *buffer, int len, stbi_uc *out, int out_stride, int out_w, int out_h, int *x, int *y, int *channels_in_file, int desired_channels, int min_x, int min_y);
+
 ////////////////////////////////////
 //
 // 16-bits-per-channel interface
@@ -413,7 +435,8 @@ STBIDEF int      stbi_is_hdr_from_file(FILE *f);
 
 
 // get a VERY brief reason for failure
-// NOT THREADSAFE
+// the reason is kept per thread if the compiler supports thread-local
+// variables (see STBI_THREAD_LOCAL); otherwise NOT THREADSAFE
 STBIDEF const char *stbi_failure_reason  (void);
 
 // free the loaded image -- this is just free()
@@ -446,6 +469,14 @@ STBIDEF void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert);
 // flip the image vertically, so the first pixel in the output array is the bottom left
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip);
 
+// as above, but only applies to images loaded on the thread that calls the
+// function, overriding the global setting there. these functions are only
+// available if your compiler supports thread-local variables; calling them
+// will fail to link if it doesn't
+STBIDEF void stbi_set_unpremultiply_on_load_thread(int flag_true_if_should_unpremultiply);
+STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
+STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -525,6 +556,32 @@ STBIDEF int   stbi_zlib_decode_noheader_buffer(char *obuffer, int olen, const ch
 #define STBI_ASSERT(x) assert(x)
 #endif
 
+// checked once per MCU row (JPEG), scanline or 64KB of inflated data (PNG);
+// a nonzero result aborts the decode with the "cancelled" error.
+#ifndef STBI_CANCELLED
+#define STBI_CANCELLED() 0
+#endif
+
+// STBI_PARALLEL_FOR(n, fn, user) must call fn(user, i) once for every i in
+// [0, n), possibly concurrently, and return when all calls have finished.
+// When defined, large baseline JPEGs decode their restart intervals and
+// convert their output rows in parallel. (memory input only)
+// Non-interlaced PNGs always inflate and unfilter in chunks of rows through
+// a small sliding window instead of inflating the whole image first; with
+// STBI_PARALLEL_FOR the next chunk is inflated while this one is unfiltered.
+#ifdef STBI_PARALLEL_FOR
+#define STBI__PARALLEL_MIN_PIXELS   (256*256)
+#define STBI__PARALLEL_ROWS         32
+#endif
+
+// STBI_JPEG_FAST_HUFFMAN decodes JPEG entropy data with 11-bit lookup tables
+// that return a DC or AC symbol together with its extra bits, and with a
+// 64-bit bit buffer refilled several bytes at a time while none is 0xFF.
+// Valid files decode identically; the tables take about 48KB more per
+// decoder. On a corrupt stream whose scan ends before its data does, the
+// reader can stop a byte earlier than the 32-bit one, so a stuffed 0xFF00
+// right after that point may be rejected as a marker where it was not.
+
 
 #ifndef _MSC_VER
    #ifdef __cplusplus
@@ -559,6 +616,26 @@ typedef unsigned char validate_uint32[sizeof(stbi__uint32)==4 ? 1 : -1];
 #define STBI_NOTUSED(v)  (void)sizeof(v)
 #endif
 
+// failure reasons and the *_thread settings are thread-local where the
+// compiler allows it; define STBI_NO_THREAD_LOCALS to use plain globals
+#ifndef STBI_NO_THREAD_LOCALS
+   #if defined(__cplusplus) && __cplusplus >= 201103L
+      #define STBI_THREAD_LOCAL       thread_local
+   #elif defined(__GNUC__) && __GNUC__ < 5
+      #define STBI_THREAD_LOCAL       __thread
+   #elif defined(_MSC_VER)
+      #define STBI_THREAD_LOCAL       __declspec(thread)
+   #elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+      #define STBI_THREAD_LOCAL       _Thread_local
+   #endif
+
+   #ifndef STBI_THREAD_LOCAL
+      #if defined(__GNUC__)
+         #define STBI_THREAD_LOCAL    __thread
+      #endif
+   #endif
+#endif
+
 #ifdef _MSC_VER
 #define STBI_HAS_LROTL
 #endif
@@ -667,6 +744,20 @@ static int stbi__sse2_available(void)
 #endif
 #endif
 
+// AVX2 kernels are compiled with a target attribute and chosen at run time
+// in stbi__setup_jpeg, so the same binary runs on CPUs without AVX2.
+// (GCC/Clang on x64; define STBI_NO_AVX2 to leave them out)
+#if defined(STBI_SSE2) && defined(STBI__X64_TARGET) && defined(__GNUC__) && !defined(STBI_NO_AVX2)
+#define STBI_AVX2
+#define STBI__TARGET_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+
+static int stbi__avx2_available(void)
+{
+   return __builtin_cpu_supports("avx2");
+}
+#endif
+
 // ARM NEON
 #if defined(STBI_NO_SIMD) && defined(STBI_NEON)
 #undef STBI_NEON
@@ -699,9 +790,15 @@ typedef struct
    int read_from_callbacks;
    int buflen;
    stbi_uc buffer_start[128];
+   stbi_uc *buffer;            // refill buffer: buffer_start or a caller buffer
 
    stbi_uc *img_buffer, *img_buffer_end;
    stbi_uc *img_buffer_original, *img_buffer_original_end;
+
+   int jpeg_min_x, jpeg_min_y; // requested minimum size for scaled JPEG decode
+
+   stbi_uc *out_buf;           // caller output buffer (stbi_load_from_memory_into)
+   int out_stride, out_w, out_h;
 } stbi__context;
 
 
@@ -714,18 +811,29 @@ static void stbi__start_mem(stbi__context *s, stbi_uc const *buffer, int len)
    s->read_from_callbacks = 0;
    s->img_buffer = s->img_buffer_original = (stbi_uc *) buffer;
    s->img_buffer_end = s->img_buffer_original_end = (stbi_uc *) buffer+len;
+   s->jpeg_min_x = s->jpeg_min_y = 0;
+   s->out_buf = NULL;
 }
 
-// initialize a callback-based context
-static void stbi__start_callbacks(stbi__context *s, stbi_io_callbacks *c, void *user)
+// initialize a callback-based context that refills through buffer
+static void stbi__start_callbacks_buffer(stbi__context *s, stbi_io_callbacks *c, void *user, stbi_uc *buffer, int buflen)
 {
    s->io = *c;
    s->io_user_data = user;
-   s->buflen = sizeof(s->buffer_start);
+   s->buffer = buffer;
+   s->buflen = buflen;
    s->read_from_callbacks = 1;
-   s->img_buffer_original = s->buffer_start;
+   s->img_buffer_original = s->buffer;
    stbi__refill_buffer(s);
    s->img_buffer_original_end = s->img_buffer_end;
+   s->jpeg_min_x = s->jpeg_min_y = 0;
+   s->out_buf = NULL;
+}
+
+// initialize a callback-based context
+static void stbi__start_callbacks(stbi__context *s, stbi_io_callbacks *c, void *user)
+{
+   stbi__start_callbacks_buffer(s, c, user, s->buffer_start, sizeof(s->buffer_start));
 }
 
 #ifndef STBI_NO_STDIO
@@ -840,8 +948,12 @@ static void    *stbi__pnm_load(stbi__context *s, int *x, int *y, int *comp, int
 static int      stbi__pnm_info(stbi__context *s, int *x, int *y, int *comp);
 #endif
 
+#ifdef STBI_THREAD_LOCAL
+static STBI_THREAD_LOCAL const char *stbi__g_failure_reason;
+#else
 // this is not threadsafe
 static const char *stbi__g_failure_reason;
+#endif
 
 STBIDEF const char *stbi_failure_reason(void)
 {
@@ -962,13 +1074,29 @@ static float   *stbi__ldr_to_hdr(stbi_uc *data, int x, int y, int comp);
 static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp);
 #endif
 
-static int stbi__vertically_flip_on_load = 0;
+static int stbi__vertically_flip_on_load_global = 0;
 
 STBIDEF void stbi_set_flip_vertically_on_load(int flag_true_if_should_flip)
 {
-    stbi__vertically_flip_on_load = flag_true_if_should_flip;
+    stbi__vertically_flip_on_load_global = flag_true_if_should_flip;
+}
+
+#ifndef STBI_THREAD_LOCAL
+#define stbi__vertically_flip_on_load  stbi__vertically_flip_on_load_global
+#else
+static STBI_THREAD_LOCAL int stbi__vertically_flip_on_load_local, stbi__vertically_flip_on_load_set;
+
+STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip)
+{
+    stbi__vertically_flip_on_load_local = flag_true_if_should_flip;
+    stbi__vertically_flip_on_load_set = 1;
 }
 
+#define stbi__vertically_flip_on_load  (stbi__vertically_flip_on_load_set       \
+                                         ? stbi__vertically_flip_on_load_local  \
+                                         : stbi__vertically_flip_on_load_global)
+#endif // STBI_THREAD_LOCAL
+
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
    memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1179,6 +1307,20 @@ STBIDEF stbi_uc *stbi_load_from_file(FILE *f, int *x, int *y, int *comp, int req
    return result;
 }
 
+STBIDEF stbi_uc *stbi_load_scaled(char const *filename, int *x, int *y, int *comp, int req_comp, int min_x, int min_y)
+{
+   FILE *f = stbi__fopen(filename, "rb");
+   unsigned char *result;
+   stbi__context s;
+   if (!f) return stbi__errpuc("can't fopen", "Unable to open file");
+   stbi__start_file(&s,f);
+   s.jpeg_min_x = min_x;
+   s.jpeg_min_y = min_y;
+   result = stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
+   fclose(f);
+   return result;
+}
+
 STBIDEF stbi__uint16 *stbi_load_from_file_16(FILE *f, int *x, int *y, int *comp, int req_comp)
 {
    stbi__uint16 *result;
@@ -1226,6 +1368,43 @@ STBIDEF stbi_uc *stbi_load_from_memory(stbi_uc const *buffer, int len, int *x, i
    return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
 }
 
+STBIDEF stbi_uc *stbi_load_from_memory_scaled(stbi_uc const *buffer, int len, int *x, int *y, int *comp, int req_comp, int min_x, int min_y)
+{
+   stbi__context s;
+   stbi__start_mem(&s,buffer,len);
+   s.jpeg_min_x = min_x;
+   s.jpeg_min_y = min_y;
+   return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
+}
+
+STBIDEF int stbi_load_from_memory_into(stbi_uc const *buffer, int len, stbi_uc *out, int out_stride, int out_w, int out_h, int *x, int *y, int *comp, int req_comp, int min_x, int min_y)
+{
+   stbi__context s;
+   stbi_uc *result;
+   int j;
+   if (req_comp < 1 || req_comp > 4) return stbi__err("bad req_comp", "Internal error");
+   if (out_stride < out_w * req_comp) return stbi__err("bad stride", "Output stride smaller than a row");
+   stbi__start_mem(&s,buffer,len);
+   s.jpeg_min_x = min_x;
+   s.jpeg_min_y = min_y;
+   s.out_buf = out;
+   s.out_stride = out_stride;
+   s.out_w = out_w;
+   s.out_h = out_h;
+   result = stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
+   if (result == NULL) return 0;
+   if (result != out) {
+      if (*x > out_w || *y > out_h) {
+         STBI_FREE(result);
+         return stbi__err("too large", "Image does not fit the output buffer");
+      }
+      for (j=0; j < *y; ++j)
+         memcpy(out + (size_t) j * out_stride, result + (size_t) j * *x * req_comp, (size_t) *x * req_comp);
+      STBI_FREE(result);
+   }
+   return 1;
+}
+
 STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk, void *user, int *x, int *y, int *comp, int req_comp)
 {
    stbi__context s;
@@ -1233,6 +1412,18 @@ STBIDEF stbi_uc *stbi_load_from_callbacks(stbi_io_callbacks const *clbk, void *u
    return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
 }
 
+STBIDEF stbi_uc *stbi_load_from_callbacks_buffered(stbi_io_callbacks const *clbk, void *user, stbi_uc *buffer, int buflen, int *x, int *y, int *comp, int req_comp)
+{
+   stbi__context s;
+   // format detection rewinds within the first fill, so smaller buffers
+   // than the built-in one are not used
+   if (buflen < (int) sizeof(s.buffer_start))
+      stbi__start_callbacks(&s, (stbi_io_callbacks *) clbk, user);
+   else
+      stbi__start_callbacks_buffer(&s, (stbi_io_callbacks *) clbk, user, buffer, buflen);
+   return stbi__load_and_postprocess_8bit(&s,x,y,comp,req_comp);
+}
+
 #ifndef STBI_NO_GIF
 STBIDEF stbi_uc *stbi_load_gif_from_memory(stbi_uc const *buffer, int len, int **delays, int *x, int *y, int *z, int *comp, int req_comp)
 {
@@ -1389,17 +1580,17 @@ enum
 
 static void stbi__refill_buffer(stbi__context *s)
 {
-   int n = (s->io.read)(s->io_user_data,(char*)s->buffer_start,s->buflen);
+   int n = (s->io.read)(s->io_user_data,(char*)s->buffer,s->buflen);
    if (n == 0) {
       // at end of file, treat same as if from memory, but need to handle case
       // where s->img_buffer isn't pointing to safe memory, e.g. 0-byte file
       s->read_from_callbacks = 0;
-      s->img_buffer = s->buffer_start;
-      s->img_buffer_end = s->buffer_start+1;
+      s->img_buffer = s->buffer;
+      s->img_buffer_end = s->buffer+1;
       *s->img_buffer = 0;
    } else {
-      s->img_buffer = s->buffer_start;
-      s->img_buffer_end = s->buffer_start + n;
+      s->img_buffer = s->buffer;
+      s->img_buffer_end = s->buffer + n;
    }
 }
 
@@ -1684,7 +1875,17 @@ static stbi_uc *stbi__hdr_to_ldr(float   *data, int x, int y, int comp)
 #ifndef STBI_NO_JPEG
 
 // huffman decoding acceleration
+#ifdef STBI_JPEG_FAST_HUFFMAN
+#define FAST_BITS   11
+typedef unsigned long long stbi__jbuf;
+typedef stbi__int32 stbi__fastac;
+#define STBI__JBITS 64
+#else
 #define FAST_BITS   9  // larger handles more cases; smaller stomps less cache
+typedef stbi__uint32 stbi__jbuf;
+typedef stbi__int16 stbi__fastac;
+#define STBI__JBITS 32
+#endif
 
 typedef struct
 {
@@ -1703,7 +1904,10 @@ typedef struct
    stbi__huffman huff_dc[4];
    stbi__huffman huff_ac[4];
    stbi__uint16 dequant[4][64];
-   stbi__int16 fast_ac[4][1 << FAST_BITS];
+   stbi__fastac fast_ac[4][1 << FAST_BITS];
+#ifdef STBI_JPEG_FAST_HUFFMAN
+   stbi__int32 fast_dc[4][1 << FAST_BITS];
+#endif
 
 // sizes for components, interleaved MCUs
    int img_h_max, img_v_max;
@@ -1727,7 +1931,7 @@ typedef struct
       int      coeff_w, coeff_h; // number of 8x8 coefficient blocks
    } img_comp[4];
 
-   stbi__uint32   code_buffer; // jpeg entropy-coded buffer
+   stbi__jbuf     code_buffer; // jpeg entropy-coded buffer
    int            code_bits;   // number of valid bits
    unsigned char  marker;      // marker seen while filling entropy buffer
    int            nomore;      // flag if we saw a marker so must stop
@@ -1744,6 +1948,7 @@ typedef struct
 
    int scan_n, order[4];
    int restart_interval, todo;
+   int scale;   // log2 of the decode scale; blocks are (8 >> scale) pixels wide
 
 // kernels
    void (*idct_block_kernel)(stbi_uc *out, int out_stride, short data[64]);
@@ -1795,7 +2000,7 @@ static int stbi__build_huffman(stbi__huffman *h, int *count)
 
 // build a table that decodes both magnitude and value of small ACs in
 // one go.
-static void stbi__build_fast_ac(stbi__int16 *fast_ac, stbi__huffman *h)
+static void stbi__build_fast_ac(stbi__fastac *fast_ac, stbi__huffman *h)
 {
    int i;
    for (i=0; i < (1 << FAST_BITS); ++i) {
@@ -1813,15 +2018,63 @@ static void stbi__build_fast_ac(stbi__int16 *fast_ac, stbi__huffman *h)
             int m = 1 << (magbits - 1);
             if (k < m) k += (~0U << magbits) + 1;
             // if the result is small enough, we can fit it in fast_ac table
-            if (k >= -128 && k <= 127)
-               fast_ac[i] = (stbi__int16) ((k * 256) + (run * 16) + (len + magbits));
+            if (sizeof(stbi__fastac) > 2 || (k >= -128 && k <= 127))
+               fast_ac[i] = (stbi__fastac) ((k * 256) + (run * 16) + (len + magbits));
+         }
+      }
+   }
+}
+
+#ifdef STBI_JPEG_FAST_HUFFMAN
+// same for DC differences. 0 is the flag for not-accelerated, so the
+// combined length is always nonzero.
+static void stbi__build_fast_dc(stbi__int32 *fast_dc, stbi__huffman *h)
+{
+   int i;
+   for (i=0; i < (1 << FAST_BITS); ++i) {
+      stbi_uc fast = h->fast[i];
+      fast_dc[i] = 0;
+      if (fast < 255) {
+         int magbits = h->values[fast];
+         int len = h->size[fast];
+
+         if (magbits == 0)
+            fast_dc[i] = len;
+         else if (len + magbits <= FAST_BITS) {
+            int k = ((i << len) & ((1 << FAST_BITS) - 1)) >> (FAST_BITS - magbits);
+            int m = 1 << (magbits - 1);
+            if (k < m) k += (~0U << magbits) + 1;
+            fast_dc[i] = (k * 256) + (len + magbits);
          }
       }
    }
 }
+#endif
 
 static void stbi__grow_buffer_unsafe(stbi__jpeg *j)
 {
+#ifdef STBI_JPEG_FAST_HUFFMAN
+   // take as many whole bytes as fit straight from memory if none is 0xff
+   stbi_uc *p = j->s->img_buffer;
+   if (!j->nomore && j->code_bits >= 0 && j->s->img_buffer_end - p >= 8) {
+      int n = (64 - j->code_bits) >> 3;
+      stbi__jbuf v = ((stbi__jbuf) p[0] << 56) | ((stbi__jbuf) p[1] << 48) |
+                     ((stbi__jbuf) p[2] << 40) | ((stbi__jbuf) p[3] << 32) |
+                     ((stbi__jbuf) p[4] << 24) | ((stbi__jbuf) p[5] << 16) |
+                     ((stbi__jbuf) p[6] <<  8) |  (stbi__jbuf) p[7];
+      if (n < 8) v &= ~(~(stbi__jbuf) 0 >> (8 * n)); // the n bytes at the top
+      // no 0xff byte: ~v has no zero byte
+      if (n > 0 && !(((~v) - 0x0101010101010101ULL) & v & 0x8080808080808080ULL)) {
+         j->code_buffer |= v >> j->code_bits;
+         j->code_bits += 8 * n;
+         j->s->img_buffer += n;
+         return;
+      }
+   }
+#endif
+   // near a 0xff byte, read no further ahead than the 32-bit reader (up to
+   // 25 bits), so a scan that ends early stops at the same byte and the
+   // junk before the next marker is handled the same way.
    do {
       unsigned int b = j->nomore ? 0 : stbi__get8(j->s);
       if (b == 0xff) {
@@ -1833,7 +2086,7 @@ static void stbi__grow_buffer_unsafe(stbi__jpeg *j)
             return;
          }
       }
-      j->code_buffer |= b << (24 - j->code_bits);
+      j->code_buffer |= (stbi__jbuf) b << (STBI__JBITS - 8 - j->code_bits);
       j->code_bits += 8;
    } while (j->code_bits <= 24);
 }
@@ -1851,7 +2104,7 @@ stbi_inline static int stbi__jpeg_huff_decode(stbi__jpeg *j, stbi__huffman *h)
 
    // look at the top FAST_BITS and determine what symbol ID it is,
    // if the code is <= FAST_BITS
-   c = (j->code_buffer >> (32 - FAST_BITS)) & ((1 << FAST_BITS)-1);
+   c = (j->code_buffer >> (STBI__JBITS - FAST_BITS)) & ((1 << FAST_BITS)-1);
    k = h->fast[c];
    if (k < 255) {
       int s = h->size[k];
@@ -1868,7 +2121,7 @@ stbi_inline static int stbi__jpeg_huff_decode(stbi__jpeg *j, stbi__huffman *h)
    // end; in other words, regardless of the number of bits, it
    // wants to be compared against something shifted to have 16;
    // that way we don't need to shift inside the loop.
-   temp = j->code_buffer >> 16;
+   temp = (unsigned int) (j->code_buffer >> (STBI__JBITS - 16));
    for (k=FAST_BITS+1 ; ; ++k)
       if (temp < h->maxcode[k])
          break;
@@ -1882,8 +2135,8 @@ stbi_inline static int stbi__jpeg_huff_decode(stbi__jpeg *j, stbi__huffman *h)
       return -1;
 
    // convert the huffman code to the symbol id
-   c = ((j->code_buffer >> (32 - k)) & stbi__bmask[k]) + h->delta[k];
-   STBI_ASSERT((((j->code_buffer) >> (32 - h->size[c])) & stbi__bmask[h->size[c]]) == h->code[c]);
+   c = ((j->code_buffer >> (STBI__JBITS - k)) & stbi__bmask[k]) + h->delta[k];
+   STBI_ASSERT((((j->code_buffer) >> (STBI__JBITS - h->size[c])) & stbi__bmask[h->size[c]]) == h->code[c]);
 
    // convert the id to a symbol
    j->code_bits -= k;
@@ -1902,11 +2155,16 @@ stbi_inline static int stbi__extend_receive(stbi__jpeg *j, int n)
    int sgn;
    if (j->code_bits < n) stbi__grow_buffer_unsafe(j);
 
-   sgn = (stbi__int32)j->code_buffer >> 31; // sign bit is always in MSB
-   k = stbi_lrot(j->code_buffer, n);
+   sgn = (stbi__int32)(j->code_buffer >> (STBI__JBITS - 32)) >> 31; // sign bit is always in MSB
    STBI_ASSERT(n >= 0 && n < (int) (sizeof(stbi__bmask)/sizeof(*stbi__bmask)));
+#ifdef STBI_JPEG_FAST_HUFFMAN
+   k = (unsigned int) (j->code_buffer >> (64 - n)); // n > 0
+   j->code_buffer <<= n;
+#else
+   k = stbi_lrot(j->code_buffer, n);
    j->code_buffer = k & ~stbi__bmask[n];
    k &= stbi__bmask[n];
+#endif
    j->code_bits -= n;
    return k + (stbi__jbias[n] & ~sgn);
 }
@@ -1916,9 +2174,14 @@ stbi_inline static int stbi__jpeg_get_bits(stbi__jpeg *j, int n)
 {
    unsigned int k;
    if (j->code_bits < n) stbi__grow_buffer_unsafe(j);
+#ifdef STBI_JPEG_FAST_HUFFMAN
+   k = (unsigned int) (j->code_buffer >> (64 - n)); // n > 0
+   j->code_buffer <<= n;
+#else
    k = stbi_lrot(j->code_buffer, n);
    j->code_buffer = k & ~stbi__bmask[n];
    k &= stbi__bmask[n];
+#endif
    j->code_bits -= n;
    return k;
 }
@@ -1927,7 +2190,7 @@ stbi_inline static int stbi__jpeg_get_bit(stbi__jpeg *j)
 {
    unsigned int k;
    if (j->code_bits < 1) stbi__grow_buffer_unsafe(j);
-   k = j->code_buffer;
+   k = (unsigned int) (j->code_buffer >> (STBI__JBITS - 32));
    j->code_buffer <<= 1;
    --j->code_bits;
    return k & 0x80000000;
@@ -1951,19 +2214,30 @@ static const stbi_uc stbi__jpeg_dezigzag[64+15] =
 };
 
 // decode one 64-entry block--
-static int stbi__jpeg_decode_block(stbi__jpeg *j, short data[64], stbi__huffman *hdc, stbi__huffman *hac, stbi__int16 *fac, int b, stbi__uint16 *dequant)
+static int stbi__jpeg_decode_block(stbi__jpeg *j, short data[64], stbi__huffman *hdc, stbi__huffman *hac, stbi__fastac *fac, int b, stbi__uint16 *dequant)
 {
    int diff,dc,k;
    int t;
 
    if (j->code_bits < 16) stbi__grow_buffer_unsafe(j);
-   t = stbi__jpeg_huff_decode(j, hdc);
-   if (t < 0) return stbi__err("bad huffman code","Corrupt JPEG");
+#ifdef STBI_JPEG_FAST_HUFFMAN
+   t = j->fast_dc[hdc - j->huff_dc][(j->code_buffer >> (64 - FAST_BITS)) & ((1 << FAST_BITS)-1)];
+   if (t) { // fast-DC path
+      if ((t & 255) > j->code_bits) return stbi__err("bad huffman code","Corrupt JPEG");
+      j->code_buffer <<= t & 255;
+      j->code_bits -= t & 255;
+      diff = t >> 8;
+   } else
+#endif
+   {
+      t = stbi__jpeg_huff_decode(j, hdc);
+      if (t < 0) return stbi__err("bad huffman code","Corrupt JPEG");
+      diff = t ? stbi__extend_receive(j, t) : 0;
+   }
 
    // 0 all the ac values now so we can do it 32-bits at a time
    memset(data,0,64*sizeof(data[0]));
 
-   diff = t ? stbi__extend_receive(j, t) : 0;
    dc = j->img_comp[b].dc_pred + diff;
    j->img_comp[b].dc_pred = dc;
    data[0] = (short) (dc * dequant[0]);
@@ -1974,7 +2248,7 @@ static int stbi__jpeg_decode_block(stbi__jpeg *j, short data[64], stbi__huffman
       unsigned int zig;
       int c,r,s;
       if (j->code_bits < 16) stbi__grow_buffer_unsafe(j);
-      c = (j->code_buffer >> (32 - FAST_BITS)) & ((1 << FAST_BITS)-1);
+      c = (j->code_buffer >> (STBI__JBITS - FAST_BITS)) & ((1 << FAST_BITS)-1);
       r = fac[c];
       if (r) { // fast-AC path
          k += (r >> 4) & 15; // run
@@ -2030,7 +2304,7 @@ static int stbi__jpeg_decode_block_prog_dc(stbi__jpeg *j, short data[64], stbi__
 
 // @OPTIMIZE: store non-zigzagged during the decode passes,
 // and only de-zigzag when dequantizing
-static int stbi__jpeg_decode_block_prog_ac(stbi__jpeg *j, short data[64], stbi__huffman *hac, stbi__int16 *fac)
+static int stbi__jpeg_decode_block_prog_ac(stbi__jpeg *j, short data[64], stbi__huffman *hac, stbi__fastac *fac)
 {
    int k;
    if (j->spec_start == 0) return stbi__err("can't merge dc and ac", "Corrupt JPEG");
@@ -2048,7 +2322,7 @@ static int stbi__jpeg_decode_block_prog_ac(stbi__jpeg *j, short data[64], stbi__
          unsigned int zig;
          int c,r,s;
          if (j->code_bits < 16) stbi__grow_buffer_unsafe(j);
-         c = (j->code_buffer >> (32 - FAST_BITS)) & ((1 << FAST_BITS)-1);
+         c = (j->code_buffer >> (STBI__JBITS - FAST_BITS)) & ((1 << FAST_BITS)-1);
          r = fac[c];
          if (r) { // fast-AC path
             k += (r >> 4) & 15; // run
@@ -2260,6 +2534,86 @@ static void stbi__idct_block(stbi_uc *out, int out_stride, short data[64])
    }
 }
 
+// reduced IDCTs for scaled decoding. Each output pixel is the average of the
+// 2x2 / 4x4 pixels the full IDCT would produce. Averaging adjacent samples of
+// 8-point basis k yields c(k)/2 * cos(k*pi/16) * cos((2m+1)*k*pi/8), so the
+// averaged IDCT is a 4-point (or 2-point) transform of all 8 coefficients.
+// Outputs m and n-1-m share the even terms and negate the odd ones.
+// Constants are 4.12 fixed point; the column pass keeps 2 fractional bits.
+#define STBI__IDCT_AVG4(t0,t1,t2,t3, d0,d1,d2,d3,d5,d6,d7) \
+   {                                                     \
+      int e0 = 1448*(d0) + 1338*(d2) -  554*(d6);        \
+      int e1 = 1448*(d0) - 1338*(d2) +  554*(d6);        \
+      int o0 = 1856*(d1) +  652*(d3) -  435*(d5) - 369*(d7); \
+      int o1 =  769*(d1) - 1573*(d3) + 1051*(d5) - 153*(d7); \
+      t0 = e0 + o0;  t3 = e0 - o0;                       \
+      t1 = e1 + o1;  t2 = e1 - o1;                       \
+   }
+
+static void stbi__idct_4x4(stbi_uc *out, int out_stride, short data[64])
+{
+   int i, tmp[4*8];
+   // columns; written so the compiler can process all 8 at once
+   for (i=0; i < 8; ++i) {
+      short *d = data + i;
+      int t0,t1,t2,t3;
+      STBI__IDCT_AVG4(t0,t1,t2,t3, d[0],d[8],d[16],d[24],d[40],d[48],d[56])
+      tmp[   i] = (t0 + 512) >> 10;
+      tmp[ 8+i] = (t1 + 512) >> 10;
+      tmp[16+i] = (t2 + 512) >> 10;
+      tmp[24+i] = (t3 + 512) >> 10;
+   }
+   // rows
+   for (i=0; i < 4; ++i, out += out_stride) {
+      int *t = tmp + i*8;
+      int t0,t1,t2,t3;
+      STBI__IDCT_AVG4(t0,t1,t2,t3, t[0],t[1],t[2],t[3],t[5],t[6],t[7])
+      // bias for rounding and the +128 level shift
+      t0 += (128 << 14) + (1 << 13);
+      t1 += (128 << 14) + (1 << 13);
+      t2 += (128 << 14) + (1 << 13);
+      t3 += (128 << 14) + (1 << 13);
+      out[0] = stbi__clamp(t0 >> 14);
+      out[1] = stbi__clamp(t1 >> 14);
+      out[2] = stbi__clamp(t2 >> 14);
+      out[3] = stbi__clamp(t3 >> 14);
+   }
+}
+
+// same as above with pairs of pairs; only DC and odd coefficients remain
+#define STBI__IDCT_AVG2(t0,t1, d0,d1,d3,d5,d7)           \
+   {                                                     \
+      int e = 1448*(d0);                                 \
+      int o = 1312*(d1) - 461*(d3) + 308*(d5) - 261*(d7); \
+      t0 = e + o;  t1 = e - o;                           \
+   }
+
+static void stbi__idct_2x2(stbi_uc *out, int out_stride, short data[64])
+{
+   int i, tmp[2*8];
+   for (i=0; i < 8; ++i) {
+      short *d = data + i;
+      int t0,t1;
+      STBI__IDCT_AVG2(t0,t1, d[0],d[8],d[24],d[40],d[56])
+      tmp[  i] = (t0 + 512) >> 10;
+      tmp[8+i] = (t1 + 512) >> 10;
+   }
+   for (i=0; i < 2; ++i, out += out_stride) {
+      int *t = tmp + i*8;
+      int t0,t1;
+      STBI__IDCT_AVG2(t0,t1, t[0],t[1],t[3],t[5],t[7])
+      out[0] = stbi__clamp((t0 + (128 << 14) + (1 << 13)) >> 14);
+      out[1] = stbi__clamp((t1 + (128 << 14) + (1 << 13)) >> 14);
+   }
+}
+
+// the average of the 8x8 block only depends on DC
+static void stbi__idct_1x1(stbi_uc *out, int out_stride, short data[64])
+{
+   STBI_NOTUSED(out_stride);
+   out[0] = stbi__clamp((data[0] + 4 + (128 << 3)) >> 3);
+}
+
 #ifdef STBI_SSE2
 // sse2 integer IDCT. not the fastest possible implementation but it
 // produces bit-identical results to the generic C version so it's
@@ -2441,6 +2795,170 @@ static void stbi__idct_simd(stbi_uc *out, int out_stride, short data[64])
 
 #endif // STBI_SSE2
 
+#ifdef STBI_AVX2
+// avx2 version of stbi__idct_simd with the same arithmetic, so it is also
+// bit-identical to the generic C version. the 32-bit intermediates of a
+// whole row fit in one register instead of two.
+STBI__TARGET_AVX2
+static void stbi__idct_avx2(stbi_uc *out, int out_stride, short data[64])
+{
+   __m128i row0, row1, row2, row3, row4, row5, row6, row7;
+   __m128i tmp;
+
+   // dot product constant: even elems=x, odd elems=y
+   #define dct_const(x,y)  _mm256_setr_epi16((x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y),(x),(y))
+
+   // out(0) = c0[even]*x + c0[odd]*y   (c0, x, y 16-bit, out 32-bit)
+   // out(1) = c1[even]*x + c1[odd]*y
+   #define dct_rot(out0,out1, x,y,c0,c1) \
+      __m256i c0##xy = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_unpacklo_epi16((x),(y))), _mm_unpackhi_epi16((x),(y)), 1); \
+      __m256i out0 = _mm256_madd_epi16(c0##xy, c0); \
+      __m256i out1 = _mm256_madd_epi16(c0##xy, c1)
+
+   // out = in << 12  (in 16-bit, out 32-bit)
+   #define dct_widen(out, in) \
+      __m256i out = _mm256_slli_epi32(_mm256_cvtepi16_epi32(in), 12)
+
+   #define dct_wadd(out, a, b)  __m256i out = _mm256_add_epi32(a, b)
+   #define dct_wsub(out, a, b)  __m256i out = _mm256_sub_epi32(a, b)
+
+   // butterfly a/b, add bias, then shift by "s" and pack
+   #define dct_bfly32o(out0, out1, a,b,bias,s) \
+      { \
+         __m256i abiased = _mm256_add_epi32(a, bias); \
+         __m256i sum = _mm256_srai_epi32(_mm256_add_epi32(abiased, b), s); \
+         __m256i dif = _mm256_srai_epi32(_mm256_sub_epi32(abiased, b), s); \
+         __m256i sd = _mm256_permute4x64_epi64(_mm256_packs_epi32(sum, dif), 0xd8); \
+         out0 = _mm256_castsi256_si128(sd); \
+         out1 = _mm256_extracti128_si256(sd, 1); \
+      }
+
+   // 8-bit interleave step (for transposes)
+   #define dct_interleave8(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi8(a, b); \
+      b = _mm_unpackhi_epi8(tmp, b)
+
+   // 16-bit interleave step (for transposes)
+   #define dct_interleave16(a, b) \
+      tmp = a; \
+      a = _mm_unpacklo_epi16(a, b); \
+      b = _mm_unpackhi_epi16(tmp, b)
+
+   #define dct_pass(bias,shift) \
+      { \
+         /* even part */ \
+         dct_rot(t2e,t3e, row2,row6, rot0_0,rot0_1); \
+         __m128i sum04 = _mm_add_epi16(row0, row4); \
+         __m128i dif04 = _mm_sub_epi16(row0, row4); \
+         dct_widen(t0e, sum04); \
+         dct_widen(t1e, dif04); \
+         dct_wadd(x0, t0e, t3e); \
+         dct_wsub(x3, t0e, t3e); \
+         dct_wadd(x1, t1e, t2e); \
+         dct_wsub(x2, t1e, t2e); \
+         /* odd part */ \
+         dct_rot(y0o,y2o, row7,row3, rot2_0,rot2_1); \
+         dct_rot(y1o,y3o, row5,row1, rot3_0,rot3_1); \
+         __m128i sum17 = _mm_add_epi16(row1, row7); \
+         __m128i sum35 = _mm_add_epi16(row3, row5); \
+         dct_rot(y4o,y5o, sum17,sum35, rot1_0,rot1_1); \
+         dct_wadd(x4, y0o, y4o); \
+         dct_wadd(x5, y1o, y5o); \
+         dct_wadd(x6, y2o, y5o); \
+         dct_wadd(x7, y3o, y4o); \
+         dct_bfly32o(row0,row7, x0,x7,bias,shift); \
+         dct_bfly32o(row1,row6, x1,x6,bias,shift); \
+         dct_bfly32o(row2,row5, x2,x5,bias,shift); \
+         dct_bfly32o(row3,row4, x3,x4,bias,shift); \
+      }
+
+   __m256i rot0_0 = dct_const(stbi__f2f(0.5411961f), stbi__f2f(0.5411961f) + stbi__f2f(-1.847759065f));
+   __m256i rot0_1 = dct_const(stbi__f2f(0.5411961f) + stbi__f2f( 0.765366865f), stbi__f2f(0.5411961f));
+   __m256i rot1_0 = dct_const(stbi__f2f(1.175875602f) + stbi__f2f(-0.899976223f), stbi__f2f(1.175875602f));
+   __m256i rot1_1 = dct_const(stbi__f2f(1.175875602f), stbi__f2f(1.175875602f) + stbi__f2f(-2.562915447f));
+   __m256i rot2_0 = dct_const(stbi__f2f(-1.961570560f) + stbi__f2f( 0.298631336f), stbi__f2f(-1.961570560f));
+   __m256i rot2_1 = dct_const(stbi__f2f(-1.961570560f), stbi__f2f(-1.961570560f) + stbi__f2f( 3.072711026f));
+   __m256i rot3_0 = dct_const(stbi__f2f(-0.390180644f) + stbi__f2f( 2.053119869f), stbi__f2f(-0.390180644f));
+   __m256i rot3_1 = dct_const(stbi__f2f(-0.390180644f), stbi__f2f(-0.390180644f) + stbi__f2f( 1.501321110f));
+
+   // rounding biases in column/row passes, see stbi__idct_block for explanation.
+   __m256i bias_0 = _mm256_set1_epi32(512);
+   __m256i bias_1 = _mm256_set1_epi32(65536 + (128<<17));
+
+   // load
+   row0 = _mm_load_si128((const __m128i *) (data + 0*8));
+   row1 = _mm_load_si128((const __m128i *) (data + 1*8));
+   row2 = _mm_load_si128((const __m128i *) (data + 2*8));
+   row3 = _mm_load_si128((const __m128i *) (data + 3*8));
+   row4 = _mm_load_si128((const __m128i *) (data + 4*8));
+   row5 = _mm_load_si128((const __m128i *) (data + 5*8));
+   row6 = _mm_load_si128((const __m128i *) (data + 6*8));
+   row7 = _mm_load_si128((const __m128i *) (data + 7*8));
+
+   // column pass
+   dct_pass(bias_0, 10);
+
+   {
+      // 16bit 8x8 transpose
+      dct_interleave16(row0, row4);
+      dct_interleave16(row1, row5);
+      dct_interleave16(row2, row6);
+      dct_interleave16(row3, row7);
+
+      dct_interleave16(row0, row2);
+      dct_interleave16(row1, row3);
+      dct_interleave16(row4, row6);
+      dct_interleave16(row5, row7);
+
+      dct_interleave16(row0, row1);
+      dct_interleave16(row2, row3);
+      dct_interleave16(row4, row5);
+      dct_interleave16(row6, row7);
+   }
+
+   // row pass
+   dct_pass(bias_1, 17);
+
+   {
+      // pack and 8bit 8x8 transpose
+      __m128i p0 = _mm_packus_epi16(row0, row1);
+      __m128i p1 = _mm_packus_epi16(row2, row3);
+      __m128i p2 = _mm_packus_epi16(row4, row5);
+      __m128i p3 = _mm_packus_epi16(row6, row7);
+
+      dct_interleave8(p0, p2);
+      dct_interleave8(p1, p3);
+
+      dct_interleave8(p0, p1);
+      dct_interleave8(p2, p3);
+
+      dct_interleave8(p0, p2);
+      dct_interleave8(p1, p3);
+
+      // store
+      _mm_storel_epi64((__m128i *) out, p0); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p0, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p2); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p2, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p1); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p1, 0x4e)); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, p3); out += out_stride;
+      _mm_storel_epi64((__m128i *) out, _mm_shuffle_epi32(p3, 0x4e));
+   }
+
+#undef dct_const
+#undef dct_rot
+#undef dct_widen
+#undef dct_wadd
+#undef dct_wsub
+#undef dct_bfly32o
+#undef dct_interleave8
+#undef dct_interleave16
+#undef dct_pass
+}
+#endif // STBI_AVX2
+
 #ifdef STBI_NEON
 
 // NEON integer IDCT. should produce bit-identical
@@ -2683,25 +3201,163 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
-static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
-{
-   stbi__jpeg_reset(z);
-   if (!z->progressive) {
-      if (z->scan_n == 1) {
-         int i,j;
-         STBI_SIMD_ALIGN(short, data[64]);
-         int n = z->order[0];
+#ifdef STBI_PARALLEL_FOR
+// decodes baseline MCUs [first, first+count) of the current scan, which
+// must all lie in one restart interval
+static int stbi__jpeg_decode_mcus(stbi__jpeg *z, int first, int count)
+{
+   int m, bs = 8 >> z->scale;
+   STBI_SIMD_ALIGN(short, data[64]);
+   if (z->scan_n == 1) {
+      int n = z->order[0];
+      int w = (z->img_comp[n].x+7) >> 3;
+      int ha = z->img_comp[n].ha;
+      for (m=first; m < first+count; ++m) {
+         int i = m % w, j = m / w;
+         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+         z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*bs+i*bs, z->img_comp[n].w2, data);
+      }
+   } else {
+      for (m=first; m < first+count; ++m) {
+         int i = m % z->img_mcu_x, j = m / z->img_mcu_x;
+         int k,x,y;
+         for (k=0; k < z->scan_n; ++k) {
+            int n = z->order[k];
+            int ha = z->img_comp[n].ha;
+            for (y=0; y < z->img_comp[n].v; ++y) {
+               for (x=0; x < z->img_comp[n].h; ++x) {
+                  int x2 = (i*z->img_comp[n].h + x)*bs;
+                  int y2 = (j*z->img_comp[n].v + y)*bs;
+                  if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
+                  z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+               }
+            }
+         }
+      }
+   }
+   return 1;
+}
+
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi_uc **seg;    // entropy-coded data of each restart interval
+   int nseg, per_task, mcus;
+   int *ok;          // per task result
+} stbi__jpeg_restart_job;
+
+static void stbi__jpeg_restart_task(void *user, int t)
+{
+   stbi__jpeg_restart_job *job = (stbi__jpeg_restart_job *) user;
+   int k, ri = job->z->restart_interval;
+   int end = (t+1) * job->per_task < job->nseg ? (t+1) * job->per_task : job->nseg;
+   stbi__context s = *job->z->s;
+   // private copy of the decoder state; huffman and quantization tables are
+   // only read and the blocks written by each interval do not overlap
+   stbi__jpeg *j = (stbi__jpeg *) stbi__malloc(sizeof(stbi__jpeg));
+   job->ok[t] = 0;
+   if (!j) return;
+   memcpy(j, job->z, sizeof(stbi__jpeg));
+   j->s = &s;
+   for (k=t * job->per_task; k < end; ++k) {
+      int first = k * ri;
+      int count = job->mcus - first < ri ? job->mcus - first : ri;
+      if (STBI_CANCELLED()) break;
+      s.img_buffer = job->seg[k];
+      stbi__jpeg_reset(j);
+      if (!stbi__jpeg_decode_mcus(j, first, count)) break;
+   }
+   job->ok[t] = k == end;
+   STBI_FREE(j);
+}
+
+// decodes a baseline scan with restart markers by splitting it at the RSTn
+// markers and decoding the intervals concurrently. returns -1 (without
+// consuming input) if the scan is not suitable, so the caller falls back to
+// the serial decoder.
+static int stbi__jpeg_decode_restart_parallel(stbi__jpeg *z)
+{
+   stbi__jpeg_restart_job job;
+   stbi_uc *p, *end;
+   int n, t, tasks, ok = 1, marker = STBI__MARKER_none;
+
+   if (z->progressive || !z->restart_interval || z->s->read_from_callbacks) return -1;
+   if (z->s->img_x * z->s->img_y < STBI__PARALLEL_MIN_PIXELS) return -1; // <= 16 bits each
+   if (z->scan_n == 1) {
+      n = z->order[0];
+      job.mcus = ((z->img_comp[n].x+7) >> 3) * ((z->img_comp[n].y+7) >> 3);
+   } else {
+      job.mcus = z->img_mcu_x * z->img_mcu_y;
+   }
+   job.nseg = (job.mcus + z->restart_interval - 1) / z->restart_interval;
+   if (job.nseg < 2) return -1;
+
+   // index the restart intervals; the scan ends at the first other marker
+   job.seg = (stbi_uc **) stbi__malloc_mad2(job.nseg, sizeof(stbi_uc *), 0);
+   if (!job.seg) return -1;
+   p = z->s->img_buffer;
+   end = z->s->img_buffer_end;
+   job.seg[0] = p;
+   n = 1;
+   while ((p = (stbi_uc *) memchr(p, 0xff, end - p)) != NULL && p + 1 < end) {
+      int m = p[1];
+      if (m == 0x00) { p += 2; continue; }  // stuffed byte
+      if (m == 0xff) { p += 1; continue; }  // fill byte
+      if (!STBI__RESTART(m)) { marker = m; break; }
+      if (n == job.nseg) break;             // more markers than intervals
+      job.seg[n++] = p + 2;
+      p += 2;
+   }
+   if (n != job.nseg || marker == STBI__MARKER_none) {
+      STBI_FREE(job.seg);
+      return -1;
+   }
+
+   tasks = job.nseg < 64 ? job.nseg : 64;
+   job.z = z;
+   job.per_task = (job.nseg + tasks - 1) / tasks;
+   tasks = (job.nseg + job.per_task - 1) / job.per_task;
+   job.ok = (int *) stbi__malloc_mad2(tasks, sizeof(int), 0);
+   if (!job.ok) { STBI_FREE(job.seg); return -1; }
+   STBI_PARALLEL_FOR(tasks, stbi__jpeg_restart_task, &job);
+   for (t=0; t < tasks; ++t) ok &= job.ok[t];
+   STBI_FREE(job.ok);
+   STBI_FREE(job.seg);
+   if (STBI_CANCELLED()) return stbi__err("cancelled", "Operation cancelled");
+   if (!ok) return stbi__err("bad huffman code","Corrupt JPEG");
+
+   // continue after the marker that ended the scan
+   z->s->img_buffer = p + 2;
+   z->marker = (unsigned char) marker;
+   return 1;
+}
+#endif
+
+static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
+{
+   stbi__jpeg_reset(z);
+   if (!z->progressive) {
+#ifdef STBI_PARALLEL_FOR
+      int r = stbi__jpeg_decode_restart_parallel(z);
+      if (r >= 0) return r;
+#endif
+      if (z->scan_n == 1) {
+         int i,j;
+         STBI_SIMD_ALIGN(short, data[64]);
+         int n = z->order[0];
          // non-interleaved data, we just need to process one block at a time,
          // in trivial scanline order
          // number of blocks to do just depends on how many actual "pixels" this
          // component has, independent of interleaved MCU blocking and such
          int w = (z->img_comp[n].x+7) >> 3;
          int h = (z->img_comp[n].y+7) >> 3;
+         int bs = 8 >> z->scale;
          for (j=0; j < h; ++j) {
+            if (STBI_CANCELLED()) return stbi__err("cancelled", "Operation cancelled");
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
                if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*bs+i*bs, z->img_comp[n].w2, data);
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2715,8 +3371,10 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
          return 1;
       } else { // interleaved
          int i,j,k,x,y;
+         int bs = 8 >> z->scale;
          STBI_SIMD_ALIGN(short, data[64]);
          for (j=0; j < z->img_mcu_y; ++j) {
+            if (STBI_CANCELLED()) return stbi__err("cancelled", "Operation cancelled");
             for (i=0; i < z->img_mcu_x; ++i) {
                // scan an interleaved mcu... process scan_n components in order
                for (k=0; k < z->scan_n; ++k) {
@@ -2725,8 +3383,8 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                   // by the basic H and V specified for the component
                   for (y=0; y < z->img_comp[n].v; ++y) {
                      for (x=0; x < z->img_comp[n].h; ++x) {
-                        int x2 = (i*z->img_comp[n].h + x)*8;
-                        int y2 = (j*z->img_comp[n].v + y)*8;
+                        int x2 = (i*z->img_comp[n].h + x)*bs;
+                        int y2 = (j*z->img_comp[n].v + y)*bs;
                         int ha = z->img_comp[n].ha;
                         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
                         z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
@@ -2755,6 +3413,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
          int w = (z->img_comp[n].x+7) >> 3;
          int h = (z->img_comp[n].y+7) >> 3;
          for (j=0; j < h; ++j) {
+            if (STBI_CANCELLED()) return stbi__err("cancelled", "Operation cancelled");
             for (i=0; i < w; ++i) {
                short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
                if (z->spec_start == 0) {
@@ -2777,6 +3436,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
       } else { // interleaved
          int i,j,k,x,y;
          for (j=0; j < z->img_mcu_y; ++j) {
+            if (STBI_CANCELLED()) return stbi__err("cancelled", "Operation cancelled");
             for (i=0; i < z->img_mcu_x; ++i) {
                // scan an interleaved mcu... process scan_n components in order
                for (k=0; k < z->scan_n; ++k) {
@@ -2819,6 +3479,7 @@ static void stbi__jpeg_finish(stbi__jpeg *z)
    if (z->progressive) {
       // dequantize and idct the data
       int i,j,n;
+      int bs = 8 >> z->scale;
       for (n=0; n < z->s->img_n; ++n) {
          int w = (z->img_comp[n].x+7) >> 3;
          int h = (z->img_comp[n].y+7) >> 3;
@@ -2826,7 +3487,7 @@ static void stbi__jpeg_finish(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*bs+i*bs, z->img_comp[n].w2, data);
             }
          }
       }
@@ -2885,6 +3546,10 @@ static int stbi__process_marker(stbi__jpeg *z, int m)
                v[i] = stbi__get8(z->s);
             if (tc != 0)
                stbi__build_fast_ac(z->fast_ac[th], z->huff_ac + th);
+            #ifdef STBI_JPEG_FAST_HUFFMAN
+            else
+               stbi__build_fast_dc(z->fast_dc[th], z->huff_dc + th);
+            #endif
             L -= n;
          }
          return L==0;
@@ -3045,6 +3710,18 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
    z->img_mcu_x = (s->img_x + z->img_mcu_w-1) / z->img_mcu_w;
    z->img_mcu_y = (s->img_y + z->img_mcu_h-1) / z->img_mcu_h;
 
+   // scaled decode: the smallest scale that still covers the requested size
+   z->scale = 0;
+   if (s->jpeg_min_x > 0 || s->jpeg_min_y > 0) {
+      while (z->scale < 3 &&
+             (int) ((s->img_x + (2u << z->scale) - 1) >> (z->scale + 1)) >= s->jpeg_min_x &&
+             (int) ((s->img_y + (2u << z->scale) - 1) >> (z->scale + 1)) >= s->jpeg_min_y)
+         ++z->scale;
+   }
+   if (z->scale == 1) z->idct_block_kernel = stbi__idct_4x4;
+   if (z->scale == 2) z->idct_block_kernel = stbi__idct_2x2;
+   if (z->scale == 3) z->idct_block_kernel = stbi__idct_1x1;
+
    for (i=0; i < s->img_n; ++i) {
       // number of effective pixels (e.g. for non-interleaved MCU)
       z->img_comp[i].x = (s->img_x * z->img_comp[i].h + h_max-1) / h_max;
@@ -3056,8 +3733,8 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       //
       // img_mcu_x, img_mcu_y: <=17 bits; comp[i].h and .v are <=4 (checked earlier)
       // so these muls can't overflow with 32-bit ints (which we require)
-      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * 8;
-      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * 8;
+      z->img_comp[i].w2 = z->img_mcu_x * z->img_comp[i].h * (8 >> z->scale);
+      z->img_comp[i].h2 = z->img_mcu_y * z->img_comp[i].v * (8 >> z->scale);
       z->img_comp[i].coeff = 0;
       z->img_comp[i].raw_coeff = 0;
       z->img_comp[i].linebuf = NULL;
@@ -3067,10 +3744,10 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       // align blocks for idct using mmx/sse
       z->img_comp[i].data = (stbi_uc*) (((size_t) z->img_comp[i].raw_data + 15) & ~15);
       if (z->progressive) {
-         // w2, h2 are multiples of 8 (see above)
-         z->img_comp[i].coeff_w = z->img_comp[i].w2 / 8;
-         z->img_comp[i].coeff_h = z->img_comp[i].h2 / 8;
-         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].w2, z->img_comp[i].h2, sizeof(short), 15);
+         // coefficients are kept at full size even for scaled decodes
+         z->img_comp[i].coeff_w = z->img_mcu_x * z->img_comp[i].h;
+         z->img_comp[i].coeff_h = z->img_mcu_y * z->img_comp[i].v;
+         z->img_comp[i].raw_coeff = stbi__malloc_mad3(z->img_comp[i].coeff_w * 8, z->img_comp[i].coeff_h * 8, sizeof(short), 15);
          if (z->img_comp[i].raw_coeff == NULL)
             return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
          z->img_comp[i].coeff = (short*) (((size_t) z->img_comp[i].raw_coeff + 15) & ~15);
@@ -3351,6 +4028,65 @@ static stbi_uc *stbi__resample_row_hv_2_simd(stbi_uc *out, stbi_uc *in_near, stb
 }
 #endif
 
+#ifdef STBI_AVX2
+// avx2 version of stbi__resample_row_hv_2_simd, 16 pixels at a time.
+STBI__TARGET_AVX2
+static stbi_uc *stbi__resample_row_hv_2_avx2(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
+{
+   int i=0,t0,t1;
+
+   if (w == 1) {
+      out[0] = out[1] = stbi__div4(3*in_near[0] + in_far[0] + 2);
+      return out;
+   }
+
+   t1 = 3*in_near[0] + in_far[0];
+   for (; i < ((w-1) & ~15); i += 16) {
+      // vertical pass: 3*x + y = 4*x + (y - x)
+      __m256i farw  = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_far + i)));
+      __m256i nearw = _mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (in_near + i)));
+      __m256i curr  = _mm256_add_epi16(_mm256_slli_epi16(nearw, 2), _mm256_sub_epi16(farw, nearw));
+
+      // "prev" is curr shifted right by 1 pixel with t1 in front, "next" is
+      // curr shifted left by 1 pixel with the first pixel of the next block
+      __m256i lo   = _mm256_permute2x128_si256(curr, curr, 0x08); // [0, curr.lo]
+      __m256i hi   = _mm256_permute2x128_si256(curr, curr, 0x81); // [curr.hi, 0]
+      __m256i prev = _mm256_insert_epi16(_mm256_alignr_epi8(curr, lo, 14), t1, 0);
+      __m256i next = _mm256_insert_epi16(_mm256_alignr_epi8(hi, curr, 2), 3*in_near[i+16] + in_far[i+16], 15);
+
+      // horizontal pass, polyphase as in the sse2 version
+      __m256i bias = _mm256_set1_epi16(8);
+      __m256i curb = _mm256_add_epi16(_mm256_slli_epi16(curr, 2), bias);
+      __m256i even = _mm256_add_epi16(_mm256_sub_epi16(prev, curr), curb);
+      __m256i odd  = _mm256_add_epi16(_mm256_sub_epi16(next, curr), curb);
+
+      // interleave even and odd pixels, undo scaling, pack and write
+      __m256i de0 = _mm256_srli_epi16(_mm256_unpacklo_epi16(even, odd), 4);
+      __m256i de1 = _mm256_srli_epi16(_mm256_unpackhi_epi16(even, odd), 4);
+      _mm256_storeu_si256((__m256i *) (out + i*2), _mm256_packus_epi16(de0, de1));
+
+      // "previous" value for next iter
+      t1 = 3*in_near[i+15] + in_far[i+15];
+   }
+
+   t0 = t1;
+   t1 = 3*in_near[i] + in_far[i];
+   out[i*2] = stbi__div16(3*t1 + t0 + 8);
+
+   for (++i; i < w; ++i) {
+      t0 = t1;
+      t1 = 3*in_near[i]+in_far[i];
+      out[i*2-1] = stbi__div16(3*t0 + t1 + 8);
+      out[i*2  ] = stbi__div16(3*t1 + t0 + 8);
+   }
+   out[w*2-1] = stbi__div4(t1+2);
+
+   STBI_NOTUSED(hs);
+
+   return out;
+}
+#endif
+
 static stbi_uc *stbi__resample_row_generic(stbi_uc *out, stbi_uc *in_near, stbi_uc *in_far, int w, int hs)
 {
    // resample with nearest-neighbor
@@ -3525,6 +4261,97 @@ static void stbi__YCbCr_to_RGB_simd(stbi_uc *out, stbi_uc const *y, stbi_uc cons
 }
 #endif
 
+#ifdef STBI_AVX2
+// avx2 version of stbi__YCbCr_to_RGB_simd, 16 pixels at a time, for both
+// step 4 and step 3. the step 3 stores write 4 bytes past the 16 pixels, so
+// the loop stops one pixel early to stay inside the row.
+STBI__TARGET_AVX2
+static void stbi__YCbCr_to_RGB_avx2(stbi_uc *out, stbi_uc const *y, stbi_uc const *pcb, stbi_uc const *pcr, int count, int step)
+{
+   int i = 0;
+
+   if (step == 4 || step == 3) {
+      __m256i cr_const0 = _mm256_set1_epi16(   (short) ( 1.40200f*4096.0f+0.5f));
+      __m256i cr_const1 = _mm256_set1_epi16( - (short) ( 0.71414f*4096.0f+0.5f));
+      __m256i cb_const0 = _mm256_set1_epi16( - (short) ( 0.34414f*4096.0f+0.5f));
+      __m256i cb_const1 = _mm256_set1_epi16(   (short) ( 1.77200f*4096.0f+0.5f));
+      __m256i bias = _mm256_set1_epi16(128);
+      __m256i y_round = _mm256_set1_epi16(8);
+      __m256i xw = _mm256_set1_epi16(255); // alpha channel
+      // rgbx -> rgb in each 16-byte half, 4 pixels
+      __m256i pack3 = _mm256_setr_epi8(0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1,
+                                       0,1,2,4,5,6,8,9,10,12,13,14,-1,-1,-1,-1);
+      int end = step == 4 ? count : count - 1;
+
+      for (; i+15 < end; i += 16) {
+         // load and unpack to short; y*16 + 8, (c - 128) << 8
+         __m256i yws = _mm256_add_epi16(_mm256_slli_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (y+i))), 4), y_round);
+         __m256i crw = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (pcr+i))), bias), 8);
+         __m256i cbw = _mm256_slli_epi16(_mm256_sub_epi16(_mm256_cvtepu8_epi16(_mm_loadu_si128((__m128i *) (pcb+i))), bias), 8);
+
+         // color transform
+         __m256i cr0 = _mm256_mulhi_epi16(cr_const0, crw);
+         __m256i cb0 = _mm256_mulhi_epi16(cb_const0, cbw);
+         __m256i cb1 = _mm256_mulhi_epi16(cbw, cb_const1);
+         __m256i cr1 = _mm256_mulhi_epi16(crw, cr_const1);
+         __m256i rws = _mm256_add_epi16(cr0, yws);
+         __m256i gwt = _mm256_add_epi16(cb0, yws);
+         __m256i bws = _mm256_add_epi16(yws, cb1);
+         __m256i gws = _mm256_add_epi16(gwt, cr1);
+
+         // descale
+         __m256i rw = _mm256_srai_epi16(rws, 4);
+         __m256i bw = _mm256_srai_epi16(bws, 4);
+         __m256i gw = _mm256_srai_epi16(gws, 4);
+
+         // back to byte and interleave; each 128-bit lane holds 8 pixels,
+         // o0 has pixels 0-3 (8-11) and o1 pixels 4-7 (12-15) as rgbx
+         __m256i brb = _mm256_packus_epi16(rw, bw);
+         __m256i gxb = _mm256_packus_epi16(gw, xw);
+         __m256i t0 = _mm256_unpacklo_epi8(brb, gxb);
+         __m256i t1 = _mm256_unpackhi_epi8(brb, gxb);
+         __m256i o0 = _mm256_unpacklo_epi16(t0, t1);
+         __m256i o1 = _mm256_unpackhi_epi16(t0, t1);
+
+         if (step == 4) {
+            _mm256_storeu_si256((__m256i *) (out + 0), _mm256_permute2x128_si256(o0, o1, 0x20));
+            _mm256_storeu_si256((__m256i *) (out + 32), _mm256_permute2x128_si256(o0, o1, 0x31));
+            out += 64;
+         } else {
+            __m256i c0 = _mm256_shuffle_epi8(o0, pack3);
+            __m256i c1 = _mm256_shuffle_epi8(o1, pack3);
+            _mm_storeu_si128((__m128i *) (out + 0), _mm256_castsi256_si128(c0));
+            _mm_storeu_si128((__m128i *) (out + 12), _mm256_castsi256_si128(c1));
+            _mm_storeu_si128((__m128i *) (out + 24), _mm256_extracti128_si256(c0, 1));
+            _mm_storeu_si128((__m128i *) (out + 36), _mm256_extracti128_si256(c1, 1));
+            out += 48;
+         }
+      }
+   }
+
+   for (; i < count; ++i) {
+      int y_fixed = (y[i] << 20) + (1<<19); // rounding
+      int r,g,b;
+      int cr = pcr[i] - 128;
+      int cb = pcb[i] - 128;
+      r = y_fixed + cr* stbi__float2fixed(1.40200f);
+      g = y_fixed + cr*-stbi__float2fixed(0.71414f) + ((cb*-stbi__float2fixed(0.34414f)) & 0xffff0000);
+      b = y_fixed                                   +   cb* stbi__float2fixed(1.77200f);
+      r >>= 20;
+      g >>= 20;
+      b >>= 20;
+      if ((unsigned) r > 255) { if (r < 0) r = 0; else r = 255; }
+      if ((unsigned) g > 255) { if (g < 0) g = 0; else g = 255; }
+      if ((unsigned) b > 255) { if (b < 0) b = 0; else b = 255; }
+      out[0] = (stbi_uc)r;
+      out[1] = (stbi_uc)g;
+      out[2] = (stbi_uc)b;
+      out[3] = 255;
+      out += step;
+   }
+}
+#endif
+
 // set up the kernels
 static void stbi__setup_jpeg(stbi__jpeg *j)
 {
@@ -3540,6 +4367,14 @@ static void stbi__setup_jpeg(stbi__jpeg *j)
    }
 #endif
 
+#ifdef STBI_AVX2
+   if (stbi__avx2_available()) {
+      j->idct_block_kernel = stbi__idct_avx2;
+      j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_avx2;
+      j->resample_row_hv_2_kernel = stbi__resample_row_hv_2_avx2;
+   }
+#endif
+
 #ifdef STBI_NEON
    j->idct_block_kernel = stbi__idct_simd;
    j->YCbCr_to_RGB_kernel = stbi__YCbCr_to_RGB_simd;
@@ -3570,6 +4405,158 @@ static stbi_uc stbi__blinn_8x8(stbi_uc x, stbi_uc y)
    return (stbi_uc) ((t + (t >>8)) >> 8);
 }
 
+// resamples and color-converts output rows [j0, j1) into output, which
+// points at row j0 and has rows stride bytes apart. res_comp holds the
+// resampler state for row 0 and is stepped to row j0 without resampling.
+// note that 3-channel rows write one byte past their end.
+static void stbi__jpeg_output_rows(stbi__jpeg *z, stbi__resample *res_comp, stbi_uc **linebuf,
+                                   stbi_uc *output, size_t stride, int n, int decode_n, int is_rgb,
+                                   unsigned int j0, unsigned int j1)
+{
+   int k;
+   unsigned int i,j;
+   stbi_uc *coutput[4];
+   for (j=0; j < j1; ++j) {
+      stbi_uc *out = output + stride * (j - j0);
+      for (k=0; k < decode_n; ++k) {
+         stbi__resample *r = &res_comp[k];
+         if (j >= j0) {
+            int y_bot = r->ystep >= (r->vs >> 1);
+            coutput[k] = r->resample(linebuf[k],
+                                     y_bot ? r->line1 : r->line0,
+                                     y_bot ? r->line0 : r->line1,
+                                     r->w_lores, r->hs);
+         }
+         if (++r->ystep >= r->vs) {
+            r->ystep = 0;
+            r->line0 = r->line1;
+            if (++r->ypos < z->img_comp[k].y)
+               r->line1 += z->img_comp[k].w2;
+         }
+      }
+      if (j < j0) continue;
+      if (n >= 3) {
+         stbi_uc *y = coutput[0];
+         if (z->s->img_n == 3) {
+            if (is_rgb) {
+               for (i=0; i < z->s->img_x; ++i) {
+                  out[0] = y[i];
+                  out[1] = coutput[1][i];
+                  out[2] = coutput[2][i];
+                  out[3] = 255;
+                  out += n;
+               }
+            } else {
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+            }
+         } else if (z->s->img_n == 4) {
+            if (z->app14_color_transform == 0) { // CMYK
+               for (i=0; i < z->s->img_x; ++i) {
+                  stbi_uc m = coutput[3][i];
+                  out[0] = stbi__blinn_8x8(coutput[0][i], m);
+                  out[1] = stbi__blinn_8x8(coutput[1][i], m);
+                  out[2] = stbi__blinn_8x8(coutput[2][i], m);
+                  out[3] = 255;
+                  out += n;
+               }
+            } else if (z->app14_color_transform == 2) { // YCCK
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+               for (i=0; i < z->s->img_x; ++i) {
+                  stbi_uc m = coutput[3][i];
+                  out[0] = stbi__blinn_8x8(255 - out[0], m);
+                  out[1] = stbi__blinn_8x8(255 - out[1], m);
+                  out[2] = stbi__blinn_8x8(255 - out[2], m);
+                  out += n;
+               }
+            } else { // YCbCr + alpha?  Ignore the fourth channel for now
+               z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
+            }
+         } else
+            for (i=0; i < z->s->img_x; ++i) {
+               out[0] = out[1] = out[2] = y[i];
+               out[3] = 255; // not used if n==3
+               out += n;
+            }
+      } else {
+         if (is_rgb) {
+            if (n == 1)
+               for (i=0; i < z->s->img_x; ++i)
+                  *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+            else {
+               for (i=0; i < z->s->img_x; ++i, out += 2) {
+                  out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
+                  out[1] = 255;
+               }
+            }
+         } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
+            for (i=0; i < z->s->img_x; ++i) {
+               stbi_uc m = coutput[3][i];
+               stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
+               stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
+               stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
+               out[0] = stbi__compute_y(r, g, b);
+               out[1] = 255;
+               out += n;
+            }
+         } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
+            for (i=0; i < z->s->img_x; ++i) {
+               out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
+               out[1] = 255;
+               out += n;
+            }
+         } else {
+            stbi_uc *y = coutput[0];
+            if (n == 1)
+               for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
+            else
+               for (i=0; i < z->s->img_x; ++i) *out++ = y[i], *out++ = 255;
+         }
+      }
+   }
+}
+
+#ifdef STBI_PARALLEL_FOR
+typedef struct
+{
+   stbi__jpeg *z;
+   stbi__resample *res_comp;
+   stbi_uc *output;
+   size_t stride;
+   int n, decode_n, is_rgb;
+   int *ok;          // per task result
+} stbi__jpeg_output_job;
+
+static void stbi__jpeg_output_task(void *user, int t)
+{
+   stbi__jpeg_output_job *job = (stbi__jpeg_output_job *) user;
+   stbi__jpeg *z = job->z;
+   stbi__resample res_comp[4];
+   stbi_uc *linebuf[4] = { NULL, NULL, NULL, NULL };
+   size_t row = (size_t) job->n * z->s->img_x;
+   unsigned int j0 = t * STBI__PARALLEL_ROWS;
+   unsigned int j1 = j0 + STBI__PARALLEL_ROWS < z->s->img_y ? j0 + STBI__PARALLEL_ROWS : z->s->img_y;
+   stbi_uc *last = (stbi_uc *) stbi__malloc(row + 1);
+   int k;
+   job->ok[t] = last != NULL;
+   for (k=0; k < job->decode_n; ++k) {
+      linebuf[k] = (stbi_uc *) stbi__malloc(z->s->img_x + 3);
+      if (!linebuf[k]) job->ok[t] = 0;
+   }
+   if (job->ok[t]) {
+      // the last row goes through a private buffer so the byte written past
+      // its end does not land in the next task's first row
+      memcpy(res_comp, job->res_comp, sizeof(res_comp));
+      stbi__jpeg_output_rows(z, res_comp, linebuf, job->output + job->stride * j0, job->stride, job->n, job->decode_n, job->is_rgb, j0, j1 - 1);
+      memcpy(res_comp, job->res_comp, sizeof(res_comp));
+      stbi__jpeg_output_rows(z, res_comp, linebuf, last, row, job->n, job->decode_n, job->is_rgb, j1 - 1, j1);
+      memcpy(job->output + job->stride * (j1 - 1), last, row);
+   }
+   for (k=0; k < job->decode_n; ++k)
+      STBI_FREE(linebuf[k]);
+   STBI_FREE(last);
+}
+#endif
+
 static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp, int req_comp)
 {
    int n, decode_n, is_rgb;
@@ -3581,6 +4568,18 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // load a jpeg image from whichever source, but leave in YCbCr format
    if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
 
+   // the component planes of a scaled decode hold (8 >> scale) pixels per
+   // block; from here on work with the scaled sizes
+   if (z->scale) {
+      int k, round = (1 << z->scale) - 1;
+      z->s->img_x = (z->s->img_x + round) >> z->scale;
+      z->s->img_y = (z->s->img_y + round) >> z->scale;
+      for (k=0; k < z->s->img_n; ++k) {
+         z->img_comp[k].x = (z->img_comp[k].x + round) >> z->scale;
+         z->img_comp[k].y = (z->img_comp[k].y + round) >> z->scale;
+      }
+   }
+
    // determine actual number of components to generate
    n = req_comp ? req_comp : z->s->img_n >= 3 ? 3 : 1;
 
@@ -3593,10 +4592,10 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
 
    // resample and color-convert
    {
-      int k;
-      unsigned int i,j;
+      int k, into;
+      size_t stride;
       stbi_uc *output;
-      stbi_uc *coutput[4];
+      stbi_uc *linebuf[4];
 
       stbi__resample res_comp[4];
 
@@ -3607,6 +4606,7 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
          // with upsample factor of 4
          z->img_comp[k].linebuf = (stbi_uc *) stbi__malloc(z->s->img_x + 3);
          if (!z->img_comp[k].linebuf) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+         linebuf[k] = z->img_comp[k].linebuf;
 
          r->hs      = z->img_h_max / z->img_comp[k].h;
          r->vs      = z->img_v_max / z->img_comp[k].v;
@@ -3622,105 +4622,54 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
          else                               r->resample = stbi__resample_row_generic;
       }
 
-      // can't error after this so, this is safe
-      output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
-      if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+      // write straight into the caller's buffer if the image fits there and
+      // needs no postprocessing; otherwise stbi_load_from_memory_into copies
+      into = z->s->out_buf && n == req_comp && !stbi__vertically_flip_on_load &&
+             (int) z->s->img_x <= z->s->out_w && (int) z->s->img_y <= z->s->out_h;
+      if (into) {
+         output = z->s->out_buf;
+         stride = z->s->out_stride;
+      } else {
+         // can't error after this so, this is safe
+         output = (stbi_uc *) stbi__malloc_mad3(n, z->s->img_x, z->s->img_y, 1);
+         if (!output) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+         stride = (size_t) n * z->s->img_x;
+      }
 
       // now go ahead and resample
-      for (j=0; j < z->s->img_y; ++j) {
-         stbi_uc *out = output + n * z->s->img_x * j;
-         for (k=0; k < decode_n; ++k) {
-            stbi__resample *r = &res_comp[k];
-            int y_bot = r->ystep >= (r->vs >> 1);
-            coutput[k] = r->resample(z->img_comp[k].linebuf,
-                                     y_bot ? r->line1 : r->line0,
-                                     y_bot ? r->line0 : r->line1,
-                                     r->w_lores, r->hs);
-            if (++r->ystep >= r->vs) {
-               r->ystep = 0;
-               r->line0 = r->line1;
-               if (++r->ypos < z->img_comp[k].y)
-                  r->line1 += z->img_comp[k].w2;
-            }
-         }
-         if (n >= 3) {
-            stbi_uc *y = coutput[0];
-            if (z->s->img_n == 3) {
-               if (is_rgb) {
-                  for (i=0; i < z->s->img_x; ++i) {
-                     out[0] = y[i];
-                     out[1] = coutput[1][i];
-                     out[2] = coutput[2][i];
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else {
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else if (z->s->img_n == 4) {
-               if (z->app14_color_transform == 0) { // CMYK
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc m = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(coutput[0][i], m);
-                     out[1] = stbi__blinn_8x8(coutput[1][i], m);
-                     out[2] = stbi__blinn_8x8(coutput[2][i], m);
-                     out[3] = 255;
-                     out += n;
-                  }
-               } else if (z->app14_color_transform == 2) { // YCCK
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-                  for (i=0; i < z->s->img_x; ++i) {
-                     stbi_uc m = coutput[3][i];
-                     out[0] = stbi__blinn_8x8(255 - out[0], m);
-                     out[1] = stbi__blinn_8x8(255 - out[1], m);
-                     out[2] = stbi__blinn_8x8(255 - out[2], m);
-                     out += n;
-                  }
-               } else { // YCbCr + alpha?  Ignore the fourth channel for now
-                  z->YCbCr_to_RGB_kernel(out, y, coutput[1], coutput[2], z->s->img_x, n);
-               }
-            } else
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = out[1] = out[2] = y[i];
-                  out[3] = 255; // not used if n==3
-                  out += n;
-               }
-         } else {
-            if (is_rgb) {
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i)
-                     *out++ = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-               else {
-                  for (i=0; i < z->s->img_x; ++i, out += 2) {
-                     out[0] = stbi__compute_y(coutput[0][i], coutput[1][i], coutput[2][i]);
-                     out[1] = 255;
-                  }
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 0) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  stbi_uc m = coutput[3][i];
-                  stbi_uc r = stbi__blinn_8x8(coutput[0][i], m);
-                  stbi_uc g = stbi__blinn_8x8(coutput[1][i], m);
-                  stbi_uc b = stbi__blinn_8x8(coutput[2][i], m);
-                  out[0] = stbi__compute_y(r, g, b);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else if (z->s->img_n == 4 && z->app14_color_transform == 2) {
-               for (i=0; i < z->s->img_x; ++i) {
-                  out[0] = stbi__blinn_8x8(255 - coutput[0][i], coutput[3][i]);
-                  out[1] = 255;
-                  out += n;
-               }
-            } else {
-               stbi_uc *y = coutput[0];
-               if (n == 1)
-                  for (i=0; i < z->s->img_x; ++i) out[i] = y[i];
-               else
-                  for (i=0; i < z->s->img_x; ++i) *out++ = y[i], *out++ = 255;
-            }
-         }
-      }
+#ifdef STBI_PARALLEL_FOR
+      if (z->s->img_x * z->s->img_y >= STBI__PARALLEL_MIN_PIXELS) {
+         stbi__jpeg_output_job job;
+         int t, ok = 1, tasks = (z->s->img_y + STBI__PARALLEL_ROWS - 1) / STBI__PARALLEL_ROWS;
+         job.z = z;
+         job.res_comp = res_comp;
+         job.output = output;
+         job.stride = stride;
+         job.n = n;
+         job.decode_n = decode_n;
+         job.is_rgb = is_rgb;
+         job.ok = (int *) stbi__malloc_mad2(tasks, sizeof(int), 0);
+         if (!job.ok) { if (!into) STBI_FREE(output); stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+         STBI_PARALLEL_FOR(tasks, stbi__jpeg_output_task, &job);
+         for (t=0; t < tasks; ++t) ok &= job.ok[t];
+         STBI_FREE(job.ok);
+         if (!ok) { if (!into) STBI_FREE(output); stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+      } else
+#endif
+      if (into) {
+         // the byte written past the last row would be outside the caller's
+         // buffer, so that row goes through a scratch row
+         size_t row = (size_t) n * z->s->img_x;
+         stbi__resample start[4];
+         stbi_uc *last = (stbi_uc *) stbi__malloc(row + 1);
+         if (!last) { stbi__cleanup_jpeg(z); return stbi__errpuc("outofmem", "Out of memory"); }
+         memcpy(start, res_comp, sizeof(res_comp));
+         stbi__jpeg_output_rows(z, res_comp, linebuf, output, stride, n, decode_n, is_rgb, 0, z->s->img_y - 1);
+         stbi__jpeg_output_rows(z, start, linebuf, last, row, n, decode_n, is_rgb, z->s->img_y - 1, z->s->img_y);
+         memcpy(output + stride * (z->s->img_y - 1), last, row);
+         STBI_FREE(last);
+      } else
+         stbi__jpeg_output_rows(z, res_comp, linebuf, output, stride, n, decode_n, is_rgb, 0, z->s->img_y);
       stbi__cleanup_jpeg(z);
       *out_x = z->s->img_x;
       *out_y = z->s->img_y;
@@ -3882,9 +4831,21 @@ typedef struct
    char *zout_end;
    int   z_expandable;
 
+   // resumable decoding (stbi__zinflate): stop once zout reaches zout_limit
+   char *zout_limit;
+   int   zstate, zfinal, zstored;
+
    stbi__zhuffman z_length, z_distance;
 } stbi__zbuf;
 
+enum
+{
+   STBI__ZSTATE_header,
+   STBI__ZSTATE_huffman,
+   STBI__ZSTATE_stored,
+   STBI__ZSTATE_done
+};
+
 stbi_inline static stbi_uc stbi__zget8(stbi__zbuf *z)
 {
    if (z->zbuffer >= z->zbuffer_end) return 0;
@@ -3975,11 +4936,25 @@ static const int stbi__zdist_base[32] = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129
 static const int stbi__zdist_extra[32] =
 { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13};
 
+// returns 2 if decoding stopped at zout_limit. the last match may run up
+// to 258 bytes past the limit.
 static int stbi__parse_huffman_block(stbi__zbuf *a)
 {
    char *zout = a->zout;
+   int check = (int) (zout - a->zout_start);
    for(;;) {
-      int z = stbi__zhuffman_decode(a, &a->z_length);
+      int z;
+      if (zout - a->zout_start >= check) {
+         if (a->zout_limit && zout >= a->zout_limit) {
+            a->zout = zout;
+            return 2;
+         }
+         if (STBI_CANCELLED()) return stbi__err("cancelled", "Operation cancelled");
+         check = (int) (zout - a->zout_start) + (1 << 16);
+         if (a->zout_limit && a->zout_limit - a->zout_start < check)
+            check = (int) (a->zout_limit - a->zout_start);
+      }
+      z = stbi__zhuffman_decode(a, &a->z_length);
       if (z < 256) {
          if (z < 0) return stbi__err("bad huffman code","Corrupt PNG"); // error in huffman codes
          if (zout >= a->zout_end) {
@@ -4066,7 +5041,8 @@ static int stbi__compute_huffman_codes(stbi__zbuf *a)
    return 1;
 }
 
-static int stbi__parse_uncompressed_block(stbi__zbuf *a)
+// returns the length of the stored block, or -1
+static int stbi__parse_uncompressed_header(stbi__zbuf *a)
 {
    stbi_uc header[4];
    int len,nlen,k;
@@ -4085,8 +5061,15 @@ static int stbi__parse_uncompressed_block(stbi__zbuf *a)
       header[k++] = stbi__zget8(a);
    len  = header[1] * 256 + header[0];
    nlen = header[3] * 256 + header[2];
-   if (nlen != (len ^ 0xffff)) return stbi__err("zlib corrupt","Corrupt PNG");
-   if (a->zbuffer + len > a->zbuffer_end) return stbi__err("read past buffer","Corrupt PNG");
+   if (nlen != (len ^ 0xffff)) { stbi__err("zlib corrupt","Corrupt PNG"); return -1; }
+   if (a->zbuffer + len > a->zbuffer_end) { stbi__err("read past buffer","Corrupt PNG"); return -1; }
+   return len;
+}
+
+static int stbi__parse_uncompressed_block(stbi__zbuf *a)
+{
+   int len = stbi__parse_uncompressed_header(a);
+   if (len < 0) return 0;
    if (a->zout + len > a->zout_end)
       if (!stbi__zexpand(a, a->zout, len)) return 0;
    memcpy(a->zout, a->zbuffer, len);
@@ -4145,6 +5128,7 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
    a->num_bits = 0;
    a->code_buffer = 0;
    do {
+      if (STBI_CANCELLED()) return stbi__err("cancelled", "Operation cancelled");
       final = stbi__zreceive(a,1);
       type = stbi__zreceive(a,2);
       if (type == 0) {
@@ -4165,12 +5149,62 @@ static int stbi__parse_zlib(stbi__zbuf *a, int parse_header)
    return 1;
 }
 
+// resumable version of stbi__parse_zlib. decodes until zout reaches
+// zout_limit or the stream ends (zstate == STBI__ZSTATE_done). the caller
+// may move the output window between calls, keeping the last 32KB.
+static int stbi__zinflate(stbi__zbuf *a)
+{
+   for (;;) {
+      if (a->zstate == STBI__ZSTATE_header) {
+         int type;
+         if (a->zfinal) {
+            a->zstate = STBI__ZSTATE_done;
+            return 1;
+         }
+         if (STBI_CANCELLED()) return stbi__err("cancelled", "Operation cancelled");
+         a->zfinal = stbi__zreceive(a,1);
+         type = stbi__zreceive(a,2);
+         if (type == 0) {
+            a->zstored = stbi__parse_uncompressed_header(a);
+            if (a->zstored < 0) return 0;
+            a->zstate = STBI__ZSTATE_stored;
+         } else if (type == 3) {
+            return 0;
+         } else {
+            if (type == 1) {
+               if (!stbi__zbuild_huffman(&a->z_length  , stbi__zdefault_length  , 288)) return 0;
+               if (!stbi__zbuild_huffman(&a->z_distance, stbi__zdefault_distance,  32)) return 0;
+            } else {
+               if (!stbi__compute_huffman_codes(a)) return 0;
+            }
+            a->zstate = STBI__ZSTATE_huffman;
+         }
+      }
+      if (a->zstate == STBI__ZSTATE_done || a->zout >= a->zout_limit)
+         return 1;
+      if (a->zstate == STBI__ZSTATE_stored) {
+         int n = a->zstored;
+         if (n > a->zout_limit - a->zout) n = (int) (a->zout_limit - a->zout);
+         memcpy(a->zout, a->zbuffer, n);
+         a->zbuffer += n;
+         a->zout += n;
+         a->zstored -= n;
+         if (a->zstored == 0) a->zstate = STBI__ZSTATE_header;
+      } else {
+         int r = stbi__parse_huffman_block(a);
+         if (!r) return 0;
+         if (r == 1) a->zstate = STBI__ZSTATE_header;
+      }
+   }
+}
+
 static int stbi__do_zlib(stbi__zbuf *a, char *obuf, int olen, int exp, int parse_header)
 {
    a->zout_start = obuf;
    a->zout       = obuf;
    a->zout_end   = obuf + olen;
    a->z_expandable = exp;
+   a->zout_limit = NULL;
 
    return stbi__parse_zlib(a, parse_header);
 }
@@ -4326,13 +5360,14 @@ static int stbi__paeth(int a, int b, int c)
 
 static const stbi_uc stbi__depth_scale_table[9] = { 0, 0xff, 0x55, 0, 0x11, 0,0,0, 0x01 };
 
-// create the png data from post-deflated data
-static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
+// unfilters rows [j0, j1) into a->out. raw points at the filter byte of
+// row j0, and rows before j0 must already be unfiltered but not expanded.
+static int stbi__png_unfilter_rows(stbi__png *a, stbi_uc *raw, int out_n, stbi__uint32 x, stbi__uint32 j0, stbi__uint32 j1, int depth)
 {
    int bytes = (depth == 16? 2 : 1);
    stbi__context *s = a->s;
    stbi__uint32 i,j,stride = x*out_n*bytes;
-   stbi__uint32 img_len, img_width_bytes;
+   stbi__uint32 img_width_bytes = (((s->img_n * x * depth) + 7) >> 3);
    int k;
    int img_n = s->img_n; // copy it into a local for later
 
@@ -4341,19 +5376,8 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
    int width = x;
 
    STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
-   a->out = (stbi_uc *) stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
-   if (!a->out) return stbi__err("outofmem", "Out of memory");
-
-   if (!stbi__mad3sizes_valid(img_n, x, depth, 7)) return stbi__err("too large", "Corrupt PNG");
-   img_width_bytes = (((img_n * x * depth) + 7) >> 3);
-   img_len = (img_width_bytes + 1) * y;
-
-   // we used to check for exact match between raw_len and img_len on non-interlaced PNGs,
-   // but issue #276 reported a PNG in the wild that had extra data at the end (all zeros),
-   // so just check for raw_len < img_len always.
-   if (raw_len < img_len) return stbi__err("not enough pixels","Corrupt PNG");
-
-   for (j=0; j < y; ++j) {
+   for (j=j0; j < j1; ++j) {
+      if (STBI_CANCELLED()) return stbi__err("cancelled", "Operation cancelled");
       stbi_uc *cur = a->out + stride*j;
       stbi_uc *prior;
       int filter = *raw++;
@@ -4451,11 +5475,26 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
       }
    }
 
+   return 1;
+}
+
+// expands unfiltered rows [j0, j1) to 8 bits per sample, or to native byte
+// order for 16-bit images. a row can only be expanded after the row below
+// it has been unfiltered.
+static void stbi__png_expand_rows(stbi__png *a, int out_n, stbi__uint32 x, stbi__uint32 j0, stbi__uint32 j1, int depth, int color)
+{
+   int bytes = (depth == 16? 2 : 1);
+   stbi__context *s = a->s;
+   stbi__uint32 i,j,stride = x*out_n*bytes;
+   stbi__uint32 img_width_bytes = (((s->img_n * x * depth) + 7) >> 3);
+   int k;
+   int img_n = s->img_n;
+
    // we make a separate pass to expand bits to pixels; for performance,
    // this could run two scanlines behind the above code, so it won't
    // intefere with filtering but will still be in the cache.
    if (depth < 8) {
-      for (j=0; j < y; ++j) {
+      for (j=j0; j < j1; ++j) {
          stbi_uc *cur = a->out + stride*j;
          stbi_uc *in  = a->out + stride*j + x*out_n - img_width_bytes;
          // unpack 1/2/4-bit into a 8-bit buffer. allows us to keep the common 8-bit path optimal at minimal cost for 1/2/4-bit
@@ -4528,17 +5567,161 @@ static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 r
       // this is done in a separate pass due to the decoding relying
       // on the data being untouched, but could probably be done
       // per-line during decode if care is taken.
-      stbi_uc *cur = a->out;
+      stbi_uc *cur = a->out + stride*j0;
       stbi__uint16 *cur16 = (stbi__uint16*)cur;
 
-      for(i=0; i < x*y*out_n; ++i,cur16++,cur+=2) {
+      for(i=0; i < x*(j1-j0)*out_n; ++i,cur16++,cur+=2) {
          *cur16 = (cur[0] << 8) | cur[1];
       }
    }
 
+}
+
+// create the png data from post-deflated data
+static int stbi__create_png_image_raw(stbi__png *a, stbi_uc *raw, stbi__uint32 raw_len, int out_n, stbi__uint32 x, stbi__uint32 y, int depth, int color)
+{
+   int bytes = (depth == 16? 2 : 1);
+   stbi__context *s = a->s;
+   stbi__uint32 img_len, img_width_bytes;
+   int img_n = s->img_n; // copy it into a local for later
+   int output_bytes = out_n*bytes;
+
+   STBI_ASSERT(out_n == s->img_n || out_n == s->img_n+1);
+   a->out = (stbi_uc *) stbi__malloc_mad3(x, y, output_bytes, 0); // extra bytes to write off the end into
+   if (!a->out) return stbi__err("outofmem", "Out of memory");
+
+   if (!stbi__mad3sizes_valid(img_n, x, depth, 7)) return stbi__err("too large", "Corrupt PNG");
+   img_width_bytes = (((img_n * x * depth) + 7) >> 3);
+   img_len = (img_width_bytes + 1) * y;
+
+   // we used to check for exact match between raw_len and img_len on non-interlaced PNGs,
+   // but issue #276 reported a PNG in the wild that had extra data at the end (all zeros),
+   // so just check for raw_len < img_len always.
+   if (raw_len < img_len) return stbi__err("not enough pixels","Corrupt PNG");
+
+   if (!stbi__png_unfilter_rows(a, raw, out_n, x, 0, y, depth)) return 0;
+   stbi__png_expand_rows(a, out_n, x, 0, y, depth, color);
    return 1;
 }
 
+// non-interlaced images are inflated into a sliding window about
+// STBI__PNG_CHUNK bytes of rows at a time, and each chunk is unfiltered
+// while the next one is inflated. only the window is kept, not the whole
+// inflated image.
+#define STBI__PNG_CHUNK   (1 << 16)
+
+typedef struct
+{
+   stbi__png *a;
+   stbi__zbuf *z;
+   int inflate;            // inflate up to z->zout_limit
+   stbi_uc *raw;           // filtered rows [j0, j1) in the window
+   stbi__uint32 j0, j1;
+   int out_n, depth, color;
+   int ok[2];
+} stbi__png_chunk_job;
+
+static void stbi__png_chunk_task(void *user, int t)
+{
+   stbi__png_chunk_job *job = (stbi__png_chunk_job *) user;
+   stbi__png *a = job->a;
+   if (t == 0) {
+      if (job->inflate)
+         job->ok[0] = stbi__zinflate(job->z);
+   } else if (job->j0 < job->j1) {
+      // a row is expanded once the row below it has been unfiltered
+      job->ok[1] = stbi__png_unfilter_rows(a, job->raw, job->out_n, a->s->img_x, job->j0, job->j1, job->depth);
+      if (job->ok[1])
+         stbi__png_expand_rows(a, job->out_n, a->s->img_x, job->j0 ? job->j0-1 : 0, job->j1-1, job->depth, job->color);
+   }
+}
+
+static int stbi__png_decode_chunked(stbi__png *a, stbi_uc *idata, stbi__uint32 ilen, int parse_header, int out_n, int depth, int color)
+{
+   stbi__context *s = a->s;
+   stbi__uint32 x = s->img_x, y = s->img_y;
+   stbi__uint32 row, rows, j0, j1, j2;
+   size_t shift = 0, window; // shift is the stream offset of z.zout_start
+   stbi__png_chunk_job job;
+   stbi__zbuf z;
+   char *buf;
+   int ok = 1;
+
+   if (!stbi__mad3sizes_valid(s->img_n, x, depth, 7)) return stbi__err("too large", "Corrupt PNG");
+   row = (((s->img_n * x * depth) + 7) >> 3) + 1;
+   rows = row < STBI__PNG_CHUNK ? STBI__PNG_CHUNK / row : 1;
+   // 32KB of history plus the chunk being unfiltered and the one being
+   // inflated, with room to slide the window only every few chunks
+   window = 32768 + (size_t) 8 * rows * row + 512;
+   a->out = (stbi_uc *) stbi__malloc_mad3(x, y, out_n * (depth == 16 ? 2 : 1), 0);
+   if (!a->out) return stbi__err("outofmem", "Out of memory");
+   buf = (char *) stbi__malloc(window);
+   if (!buf) return stbi__err("outofmem", "Out of memory");
+
+   z.zbuffer = idata;
+   z.zbuffer_end = idata + ilen;
+   if (parse_header && !stbi__parse_zlib_header(&z)) { STBI_FREE(buf); return 0; }
+   z.num_bits = 0;
+   z.code_buffer = 0;
+   z.zout_start = z.zout = buf;
+   z.zout_end = buf + window;
+   z.z_expandable = 0;
+   z.zstate = STBI__ZSTATE_header;
+   z.zfinal = 0;
+
+   job.a = a;
+   job.z = &z;
+   job.out_n = out_n;
+   job.depth = depth;
+   job.color = color;
+   for (j0 = j1 = 0; j0 < y; j0 = j1, j1 = j2) {
+      j2 = j1 + rows < y ? j1 + rows : y;
+      if ((size_t) j2 * row - shift + 512 > window) {
+         // keep the rows not yet unfiltered and 32KB of history
+         size_t end = shift + (z.zout - z.zout_start);
+         size_t keep = end >= 32768 && end - 32768 < (size_t) j0 * row ? end - 32768 : (size_t) j0 * row;
+         if (keep > shift) {
+            memmove(buf, buf + (keep - shift), end - keep);
+            z.zout = buf + (end - keep);
+            shift = keep;
+         }
+      }
+      job.inflate = j2 > j1;
+      job.raw = (stbi_uc *) buf + ((size_t) j0 * row - shift);
+      job.j0 = j0;
+      job.j1 = j1;
+      job.ok[0] = job.ok[1] = 1;
+      z.zout_limit = buf + ((size_t) j2 * row - shift);
+      #ifdef STBI_PARALLEL_FOR
+      STBI_PARALLEL_FOR(2, stbi__png_chunk_task, &job);
+      #else
+      stbi__png_chunk_task(&job, 0);
+      stbi__png_chunk_task(&job, 1);
+      #endif
+      if (!job.ok[0] || !job.ok[1]) { ok = 0; break; }
+      if (z.zout < z.zout_limit) { ok = stbi__err("not enough pixels","Corrupt PNG"); break; }
+   }
+   if (ok)
+      stbi__png_expand_rows(a, out_n, x, y-1, y, depth, color);
+
+   // decode the rest of the stream to check it, as stbi__do_zlib would.
+   // input past the end reads as zeros, so a truncated stream may never end;
+   // once the input is used up a valid stream ends within a window.
+   while (ok && z.zstate != STBI__ZSTATE_done) {
+      int at_end = z.zbuffer >= z.zbuffer_end;
+      if (z.zout - z.zout_start > 32768) {
+         memmove(buf, z.zout - 32768, 32768);
+         z.zout = buf + 32768;
+      }
+      z.zout_limit = z.zout_end - 512;
+      ok = stbi__zinflate(&z);
+      if (ok && at_end && z.zstate != STBI__ZSTATE_done)
+         ok = stbi__err("outofdata", "Corrupt PNG");
+   }
+   STBI_FREE(buf);
+   return ok;
+}
+
 static int stbi__create_png_image(stbi__png *a, stbi_uc *image_data, stbi__uint32 image_data_len, int out_n, int depth, int color, int interlaced)
 {
    int bytes = (depth == 16 ? 2 : 1);
@@ -4670,19 +5853,46 @@ static int stbi__expand_png_palette(stbi__png *a, stbi_uc *palette, int len, int
    return 1;
 }
 
-static int stbi__unpremultiply_on_load = 0;
-static int stbi__de_iphone_flag = 0;
+static int stbi__unpremultiply_on_load_global = 0;
+static int stbi__de_iphone_flag_global = 0;
 
 STBIDEF void stbi_set_unpremultiply_on_load(int flag_true_if_should_unpremultiply)
 {
-   stbi__unpremultiply_on_load = flag_true_if_should_unpremultiply;
+   stbi__unpremultiply_on_load_global = flag_true_if_should_unpremultiply;
 }
 
 STBIDEF void stbi_convert_iphone_png_to_rgb(int flag_true_if_should_convert)
 {
-   stbi__de_iphone_flag = flag_true_if_should_convert;
+   stbi__de_iphone_flag_global = flag_true_if_should_convert;
+}
+
+#ifndef STBI_THREAD_LOCAL
+#define stbi__unpremultiply_on_load  stbi__unpremultiply_on_load_global
+#define stbi__de_iphone_flag  stbi__de_iphone_flag_global
+#else
+static STBI_THREAD_LOCAL int stbi__unpremultiply_on_load_local, stbi__unpremultiply_on_load_set;
+static STBI_THREAD_LOCAL int stbi__de_iphone_flag_local, stbi__de_iphone_flag_set;
+
+STBIDEF void stbi_set_unpremultiply_on_load_thread(int flag_true_if_should_unpremultiply)
+{
+   stbi__unpremultiply_on_load_local = flag_true_if_should_unpremultiply;
+   stbi__unpremultiply_on_load_set = 1;
 }
 
+STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert)
+{
+   stbi__de_iphone_flag_local = flag_true_if_should_convert;
+   stbi__de_iphone_flag_set = 1;
+}
+
+#define stbi__unpremultiply_on_load  (stbi__unpremultiply_on_load_set           \
+                                       ? stbi__unpremultiply_on_load_local      \
+                                       : stbi__unpremultiply_on_load_global)
+#define stbi__de_iphone_flag  (stbi__de_iphone_flag_set                         \
+                                ? stbi__de_iphone_flag_local                    \
+                                : stbi__de_iphone_flag_global)
+#endif // STBI_THREAD_LOCAL
+
 static void stbi__de_iphone(stbi__png *z)
 {
    stbi__context *s = z->s;
@@ -4843,17 +6053,22 @@ static int stbi__parse_png_file(stbi__png *z, int scan, int req_comp)
             if (first) return stbi__err("first not IHDR", "Corrupt PNG");
             if (scan != STBI__SCAN_load) return 1;
             if (z->idata == NULL) return stbi__err("no IDAT","Corrupt PNG");
-            // initial guess for decoded data size to avoid unnecessary reallocs
-            bpl = (s->img_x * z->depth + 7) / 8; // bytes per line, per component
-            raw_len = bpl * s->img_y * s->img_n /* pixels */ + s->img_y /* filter mode per row */;
-            z->expanded = (stbi_uc *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, ioff, raw_len, (int *) &raw_len, !is_iphone);
-            if (z->expanded == NULL) return 0; // zlib should set error
-            STBI_FREE(z->idata); z->idata = NULL;
             if ((req_comp == s->img_n+1 && req_comp != 3 && !pal_img_n) || has_trans)
                s->img_out_n = s->img_n+1;
             else
                s->img_out_n = s->img_n;
-            if (!stbi__create_png_image(z, z->expanded, raw_len, s->img_out_n, z->depth, color, interlace)) return 0;
+            if (!interlace) {
+               if (!stbi__png_decode_chunked(z, z->idata, ioff, !is_iphone, s->img_out_n, z->depth, color)) return 0;
+               STBI_FREE(z->idata); z->idata = NULL;
+            } else {
+               // initial guess for decoded data size to avoid unnecessary reallocs
+               bpl = (s->img_x * z->depth + 7) / 8; // bytes per line, per component
+               raw_len = bpl * s->img_y * s->img_n /* pixels */ + s->img_y /* filter mode per row */;
+               z->expanded = (stbi_uc *) stbi_zlib_decode_malloc_guesssize_headerflag((char *) z->idata, ioff, raw_len, (int *) &raw_len, !is_iphone);
+               if (z->expanded == NULL) return 0; // zlib should set error
+               STBI_FREE(z->idata); z->idata = NULL;
+               if (!stbi__create_png_image(z, z->expanded, raw_len, s->img_out_n, z->depth, color, interlace)) return 0;
+            }
             if (has_trans) {
                if (z->depth == 16) {
                   if (!stbi__compute_transparency16(z, tc16, s->img_out_n)) return 0;
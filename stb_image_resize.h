@@ -956,7 +956,7 @@ static int stbir__edge_wrap_slow(stbir_edge edge, int n, int max)
     {
         if (n < 0)
         {
-            if (n < max)
+            if (-n < max)
                 return -n;
             else
                 return max - 1;
@@ -1032,6 +1032,15 @@ static void stbir__calculate_sample_range_downsample(int n, float in_pixels_radi
     *out_last_pixel = (int)(floor(out_pixel_influence_upperbound - 0.5));
 }
 
+// The distance to the first pixel outside a filter's range is computed from
+// absolute pixel coordinates, so it can come out a few ulps short of the
+// filter support at that coordinate magnitude. The range checks below look
+// that much further out.
+static float stbir__edge_slack(float center)
+{
+    return 1e-6f * ((float)fabs(center) + 1);
+}
+
 static void stbir__calculate_coefficients_upsample(stbir_filter filter, float scale, int in_first_pixel, int in_last_pixel, float in_center_of_out, stbir__contributors* contributor, float* coefficient_group)
 {
     int i;
@@ -1061,7 +1070,7 @@ static void stbir__calculate_coefficients_upsample(stbir_filter filter, float sc
         total_filter += coefficient_group[i];
     }
 
-    STBIR_ASSERT(stbir__filter_info_table[filter].kernel((float)(in_last_pixel + 1) + 0.5f - in_center_of_out, 1/scale) == 0);
+    STBIR_ASSERT(stbir__filter_info_table[filter].kernel((float)(in_last_pixel + 1) + 0.5f - in_center_of_out + stbir__edge_slack(in_center_of_out), 1/scale) == 0);
 
     STBIR_ASSERT(total_filter > 0.9);
     STBIR_ASSERT(total_filter < 1.1f); // Make sure it's not way off.
@@ -1100,7 +1109,7 @@ static void stbir__calculate_coefficients_downsample(stbir_filter filter, float
         coefficient_group[i] = stbir__filter_info_table[filter].kernel(x, scale_ratio) * scale_ratio;
     }
 
-    STBIR_ASSERT(stbir__filter_info_table[filter].kernel((float)(out_last_pixel + 1) + 0.5f - out_center_of_in, scale_ratio) == 0);
+    STBIR_ASSERT(stbir__filter_info_table[filter].kernel((float)(out_last_pixel + 1) + 0.5f - out_center_of_in + stbir__edge_slack(out_center_of_in), scale_ratio) == 0);
 
     for (i = out_last_pixel - out_first_pixel; i >= 0; i--)
     {
@@ -1117,6 +1126,7 @@ static void stbir__normalize_downsample_coefficients(stbir__contributors* contri
     int num_contributors = stbir__get_contributors(scale_ratio, filter, input_size, output_size);
     int num_coefficients = stbir__get_coefficient_width(filter, scale_ratio);
     int i, j;
+    int j0 = 0;
     int skip;
 
     for (i = 0; i < output_size; i++)
@@ -1124,7 +1134,12 @@ static void stbir__normalize_downsample_coefficients(stbir__contributors* contri
         float scale;
         float total = 0;
 
-        for (j = 0; j < num_contributors; j++)
+        // contributors that end before output i can't touch it or any later
+        // output; skipping them keeps this pass linear instead of O(in*out).
+        while (j0 < num_contributors && contributors[j0].n1 < i)
+            j0++;
+
+        for (j = j0; j < num_contributors; j++)
         {
             if (i >= contributors[j].n0 && i <= contributors[j].n1)
             {
@@ -1135,12 +1150,14 @@ static void stbir__normalize_downsample_coefficients(stbir__contributors* contri
                 break;
         }
 
-        STBIR_ASSERT(total > 0.9f);
-        STBIR_ASSERT(total < 1.1f);
+        // the triangle filter sampled at a 0.5..1 ratio sums to 0.88..1.125
+        // (it is renormalized right below)
+        STBIR_ASSERT(total > 0.85f);
+        STBIR_ASSERT(total < 1.15f);
 
         scale = 1 / total;
 
-        for (j = 0; j < num_contributors; j++)
+        for (j = j0; j < num_contributors; j++)
         {
             if (i >= contributors[j].n0 && i <= contributors[j].n1)
                 *stbir__get_coefficient(coefficients, filter, scale_ratio, j, i - contributors[j].n0) *= scale;
@@ -66,6 +66,15 @@ USAGE:
       int stbi_write_tga_with_rle;             // defaults to true; set to 0 to disable RLE
       int stbi_write_png_compression_level;    // defaults to 8; set to higher for more compression
       int stbi_write_force_png_filter;         // defaults to -1; set to 0..5 to force a filter mode
+      int stbi_write_jpg_restart_interval;     // defaults to 0 (none); MCUs between JPEG RSTn markers
+
+   The PNG settings and the vertical flip can also be set for the calling
+   thread only, overriding the globals there (needs compiler support for
+   thread-local variables, see STBIW_THREAD_LOCAL):
+      void stbi_write_png_compression_level_thread(int level);
+      void stbi_write_force_png_filter_thread(int filter);
+      void stbi_write_jpg_restart_interval_thread(int interval);
+      void stbi_flip_vertically_on_write_thread(int flag);
 
 
    You can define STBI_WRITE_NO_STDIO to disable the file variant of these
@@ -107,6 +116,9 @@ USAGE:
    JPEG does ignore alpha channels in input data; quality is between 1 and 100.
    Higher quality looks better but results in a bigger image.
    JPEG baseline (no JPEG progressive).
+   Setting 'stbi_write_jpg_restart_interval' to N > 0 writes a DRI segment
+   and an RSTn marker after every N 8x8 MCUs, so a decoder can start at any
+   marker (and decode the segments in parallel).
 
 CREDITS:
 
@@ -165,6 +177,7 @@ LICENSE
 extern int stbi_write_tga_with_rle;
 extern int stbi_write_png_compression_level;
 extern int stbi_write_force_png_filter;
+extern int stbi_write_jpg_restart_interval;
 #endif
 
 #ifndef STBI_WRITE_NO_STDIO
@@ -185,6 +198,13 @@ STBIWDEF int stbi_write_jpg_to_func(stbi_write_func *func, void *context, int x,
 
 STBIWDEF void stbi_flip_vertically_on_write(int flip_boolean);
 
+#ifndef STBIW_NO_THREAD_LOCALS
+STBIWDEF void stbi_write_png_compression_level_thread(int level);
+STBIWDEF void stbi_write_force_png_filter_thread(int filter);
+STBIWDEF void stbi_write_jpg_restart_interval_thread(int interval);
+STBIWDEF void stbi_flip_vertically_on_write_thread(int flip_boolean);
+#endif
+
 #endif//INCLUDE_STB_IMAGE_WRITE_H
 
 #ifdef STB_IMAGE_WRITE_IMPLEMENTATION
@@ -236,6 +256,12 @@ STBIWDEF void stbi_flip_vertically_on_write(int flip_boolean);
 #define STBIW_ASSERT(x) assert(x)
 #endif
 
+// checked once per 8 rows (JPEG), scanline or 64KB of deflate input
+// (PNG); a nonzero result aborts the write and frees its buffers.
+#ifndef STBIW_CANCELLED
+#define STBIW_CANCELLED() 0
+#endif
+
 #define STBIW_UCHAR(x) (unsigned char) ((x) & 0xff)
 
 #ifdef STB_IMAGE_WRITE_STATIC
@@ -243,11 +269,13 @@ static int stbi__flip_vertically_on_write=0;
 static int stbi_write_png_compression_level = 8;
 static int stbi_write_tga_with_rle = 1;
 static int stbi_write_force_png_filter = -1;
+static int stbi_write_jpg_restart_interval = 0;
 #else
 int stbi_write_png_compression_level = 8;
 int stbi__flip_vertically_on_write=0;
 int stbi_write_tga_with_rle = 1;
 int stbi_write_force_png_filter = -1;
+int stbi_write_jpg_restart_interval = 0;
 #endif
 
 STBIWDEF void stbi_flip_vertically_on_write(int flag)
@@ -255,6 +283,67 @@ STBIWDEF void stbi_flip_vertically_on_write(int flag)
    stbi__flip_vertically_on_write = flag;
 }
 
+// per-thread overrides of the settings above, same scheme as stb_image's
+// *_thread functions
+#ifndef STBIW_NO_THREAD_LOCALS
+   #if defined(__cplusplus) && __cplusplus >= 201103L
+      #define STBIW_THREAD_LOCAL      thread_local
+   #elif defined(__GNUC__) && __GNUC__ < 5
+      #define STBIW_THREAD_LOCAL      __thread
+   #elif defined(_MSC_VER)
+      #define STBIW_THREAD_LOCAL      __declspec(thread)
+   #elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_THREADS__)
+      #define STBIW_THREAD_LOCAL      _Thread_local
+   #endif
+
+   #ifndef STBIW_THREAD_LOCAL
+      #if defined(__GNUC__)
+         #define STBIW_THREAD_LOCAL   __thread
+      #endif
+   #endif
+#endif
+
+#ifndef STBIW_THREAD_LOCAL
+#define stbiw__flip_vertically_on_write   stbi__flip_vertically_on_write
+#define stbiw__png_compression_level      stbi_write_png_compression_level
+#define stbiw__force_png_filter           stbi_write_force_png_filter
+#define stbiw__jpg_restart_interval       stbi_write_jpg_restart_interval
+#else
+static STBIW_THREAD_LOCAL int stbiw__flip_local, stbiw__flip_set;
+static STBIW_THREAD_LOCAL int stbiw__png_level_local, stbiw__png_level_set;
+static STBIW_THREAD_LOCAL int stbiw__png_filter_local, stbiw__png_filter_set;
+static STBIW_THREAD_LOCAL int stbiw__jpg_restart_local, stbiw__jpg_restart_set;
+
+STBIWDEF void stbi_flip_vertically_on_write_thread(int flag)
+{
+   stbiw__flip_local = flag;
+   stbiw__flip_set = 1;
+}
+
+STBIWDEF void stbi_write_png_compression_level_thread(int level)
+{
+   stbiw__png_level_local = level;
+   stbiw__png_level_set = 1;
+}
+
+STBIWDEF void stbi_write_force_png_filter_thread(int filter)
+{
+   stbiw__png_filter_local = filter;
+   stbiw__png_filter_set = 1;
+}
+
+STBIWDEF void stbi_write_jpg_restart_interval_thread(int interval)
+{
+   stbiw__jpg_restart_local = interval;
+   stbiw__jpg_restart_set = 1;
+}
+
+#define stbiw__flip_vertically_on_write   (stbiw__flip_set ? stbiw__flip_local : stbi__flip_vertically_on_write)
+#define stbiw__png_compression_level      (stbiw__png_level_set ? stbiw__png_level_local : stbi_write_png_compression_level)
+#define stbiw__force_png_filter           (stbiw__png_filter_set ? stbiw__png_filter_local : stbi_write_force_png_filter)
+#define stbiw__jpg_restart_interval       (stbiw__jpg_restart_set ? stbiw__jpg_restart_local : stbi_write_jpg_restart_interval)
+#endif // STBIW_THREAD_LOCAL
+
 typedef struct
 {
    stbi_write_func *func;
@@ -388,7 +477,7 @@ static void stbiw__write_pixels(stbi__write_context *s, int rgb_dir, int vdir, i
    if (y <= 0)
       return;
 
-   if (stbi__flip_vertically_on_write)
+   if (stbiw__flip_vertically_on_write)
       vdir *= -1;
 
    if (vdir < 0)
@@ -466,7 +555,7 @@ static int stbi_write_tga_core(stbi__write_context *s, int x, int y, int comp, v
 
       stbiw__writef(s, "111 221 2222 11", 0,0,format+8, 0,0,0, 0,0,x,y, (colorbytes + has_alpha) * 8, has_alpha * 8);
 
-      if (stbi__flip_vertically_on_write) {
+      if (stbiw__flip_vertically_on_write) {
          j = 0;
          jend = y;
          jdir = 1;
@@ -694,7 +783,7 @@ static int stbi_write_hdr_core(stbi__write_context *s, int x, int y, int comp, f
       s->func(s->context, buffer, len);
 
       for(i=0; i < y; i++)
-         stbiw__write_hdr_scanline(s, x, comp, scratch, data + comp*x*(stbi__flip_vertically_on_write ? y-1-i : i)*x);
+         stbiw__write_hdr_scanline(s, x, comp, scratch, data + comp*x*(stbiw__flip_vertically_on_write ? y-1-i : i)*x);
       STBIW_FREE(scratch);
       return 1;
    }
@@ -820,7 +909,7 @@ unsigned char * stbi_zlib_compress(unsigned char *data, int data_len, int *out_l
    static unsigned short distc[]   = { 1,2,3,4,5,7,9,13,17,25,33,49,65,97,129,193,257,385,513,769,1025,1537,2049,3073,4097,6145,8193,12289,16385,24577, 32768 };
    static unsigned char  disteb[]  = { 0,0,0,0,1,1,2,2,3,3,4,4,5,5,6,6,7,7,8,8,9,9,10,10,11,11,12,12,13,13 };
    unsigned int bitbuf=0;
-   int i,j, bitcount=0;
+   int i,j, bitcount=0, next_check=0;
    unsigned char *out = NULL;
    unsigned char ***hash_table = (unsigned char***) STBIW_MALLOC(stbiw__ZHASH * sizeof(char**));
    if (hash_table == NULL)
@@ -885,6 +974,16 @@ unsigned char * stbi_zlib_compress(unsigned char *data, int data_len, int *out_l
          stbiw__zlib_huffb(data[i]);
          ++i;
       }
+      if (i >= next_check) {
+         next_check = i + (1 << 16);
+         if (STBIW_CANCELLED()) {
+            for (i=0; i < stbiw__ZHASH; ++i)
+               (void) stbiw__sbfree(hash_table[i]);
+            STBIW_FREE(hash_table);
+            (void) stbiw__sbfree(out);
+            return NULL;
+         }
+      }
    }
    // write out final bytes
    for (;i < data_len; ++i)
@@ -992,8 +1091,8 @@ static void stbiw__encode_png_line(unsigned char *pixels, int stride_bytes, int
    int *mymap = (y != 0) ? mapping : firstmap;
    int i;
    int type = mymap[filter_type];
-   unsigned char *z = pixels + stride_bytes * (stbi__flip_vertically_on_write ? height-1-y : y);
-   int signed_stride = stbi__flip_vertically_on_write ? -stride_bytes : stride_bytes;
+   unsigned char *z = pixels + stride_bytes * (stbiw__flip_vertically_on_write ? height-1-y : y);
+   int signed_stride = stbiw__flip_vertically_on_write ? -stride_bytes : stride_bytes;
    for (i = 0; i < n; ++i) {
       switch (type) {
          case 0: line_buffer[i] = z[i]; break;
@@ -1020,7 +1119,7 @@ static void stbiw__encode_png_line(unsigned char *pixels, int stride_bytes, int
 
 unsigned char *stbi_write_png_to_mem(unsigned char *pixels, int stride_bytes, int x, int y, int n, int *out_len)
 {
-   int force_filter = stbi_write_force_png_filter;
+   int force_filter = stbiw__force_png_filter;
    int ctype[5] = { -1, 0, 4, 2, 6 };
    unsigned char sig[8] = { 137,80,78,71,13,10,26,10 };
    unsigned char *out,*o, *filt, *zlib;
@@ -1038,6 +1137,11 @@ unsigned char *stbi_write_png_to_mem(unsigned char *pixels, int stride_bytes, in
    line_buffer = (signed char *) STBIW_MALLOC(x * n); if (!line_buffer) { STBIW_FREE(filt); return 0; }
    for (j=0; j < y; ++j) {
       int filter_type;
+      if (STBIW_CANCELLED()) {
+         STBIW_FREE(line_buffer);
+         STBIW_FREE(filt);
+         return 0;
+      }
       if (force_filter > -1) {
          filter_type = force_filter;
          stbiw__encode_png_line(pixels, stride_bytes, x, y, j, n, force_filter, line_buffer);
@@ -1066,7 +1170,7 @@ unsigned char *stbi_write_png_to_mem(unsigned char *pixels, int stride_bytes, in
       STBIW_MEMMOVE(filt+j*(x*n+1)+1, line_buffer, x*n);
    }
    STBIW_FREE(line_buffer);
-   zlib = stbi_zlib_compress(filt, y*( x*n+1), &zlen, stbi_write_png_compression_level);
+   zlib = stbi_zlib_compress(filt, y*( x*n+1), &zlen, stbiw__png_compression_level);
    STBIW_FREE(filt);
    if (!zlib) return 0;
 
@@ -1360,12 +1464,14 @@ static int stbi_write_jpg_core(stbi__write_context *s, int width, int height, in
                                  1.0f * 2.828427125f, 0.785694958f * 2.828427125f, 0.541196100f * 2.828427125f, 0.275899379f * 2.828427125f };
 
    int row, col, i, k;
+   int restart = stbiw__jpg_restart_interval;
    float fdtbl_Y[64], fdtbl_UV[64];
    unsigned char YTable[64], UVTable[64];
 
    if(!data || !width || !height || comp > 4 || comp < 1) {
       return 0;
    }
+   restart = restart < 0 ? 0 : restart > 65535 ? 65535 : restart;
 
    quality = quality ? quality : 90;
    quality = quality < 1 ? 1 : quality > 100 ? 100 : quality;
@@ -1407,6 +1513,10 @@ static int stbi_write_jpg_core(stbi__write_context *s, int width, int height, in
       stbiw__putc(s, 0x11); // HTUACinfo
       s->func(s->context, (void*)(std_ac_chrominance_nrcodes+1), sizeof(std_ac_chrominance_nrcodes)-1);
       s->func(s->context, (void*)std_ac_chrominance_values, sizeof(std_ac_chrominance_values));
+      if (restart) {
+         const unsigned char dri[] = { 0xFF,0xDD,0,4,(unsigned char)(restart>>8),STBIW_UCHAR(restart) };
+         s->func(s->context, (void*)dri, sizeof(dri));
+      }
       s->func(s->context, (void*)head2, sizeof(head2));
    }
 
@@ -1416,15 +1526,28 @@ static int stbi_write_jpg_core(stbi__write_context *s, int width, int height, in
       const unsigned char *imageData = (const unsigned char *)data;
       int DCY=0, DCU=0, DCV=0;
       int bitBuf=0, bitCnt=0;
+      int mcus=0, marker=0;
       // comp == 2 is grey+alpha (alpha is ignored)
       int ofsG = comp > 2 ? 1 : 0, ofsB = comp > 2 ? 2 : 0;
       int x, y, pos;
       for(y = 0; y < height; y += 8) {
+         if (STBIW_CANCELLED()) return 0;
          for(x = 0; x < width; x += 8) {
             float YDU[64], UDU[64], VDU[64];
+            if (restart && mcus == restart) {
+               // byte-align with 1 bits, then RSTn; DC prediction restarts from 0
+               stbiw__jpg_writeBits(s, &bitBuf, &bitCnt, fillBits);
+               bitBuf = bitCnt = 0;
+               stbiw__putc(s, 0xFF);
+               stbiw__putc(s, (unsigned char) (0xD0 + marker));
+               marker = (marker + 1) & 7;
+               DCY = DCU = DCV = 0;
+               mcus = 0;
+            }
+            ++mcus;
             for(row = y, pos = 0; row < y+8; ++row) {
                for(col = x; col < x+8; ++col, ++pos) {
-                  int p = (stbi__flip_vertically_on_write ? height-1-row : row)*width*comp + col*comp;
+                  int p = (stbiw__flip_vertically_on_write ? height-1-row : row)*width*comp + col*comp;
                   float r, g, b;
                   if(row >= height) {
                      p -= width*comp*(row+1 - height);
@@ -0,0 +1,127 @@
+//------------------------------------------------------------------------------
+// @file thread_pool.cc
+//------------------------------------------------------------------------------
+#include "thread_pool.h"
+#include <algorithm>
+
+namespace sas {
+
+//------------------------------------------------------------------------------
+// parallelFor() 한 번에 해당하는 작업 단위.
+// next 로 task 를 하나씩 가져가고, done 이 n 이 되면 호출자를 깨운다.
+//------------------------------------------------------------------------------
+struct ThreadPool::Job {
+  const std::function<void(int)>* fn;
+  int n;
+  std::atomic<int> next;
+  std::atomic<int> done;
+  std::mutex mutex;
+  std::condition_variable cv;
+
+  Job(const std::function<void(int)>* f, int count)
+      : fn(f), n(count), next{0}, done{0} {
+  }
+};
+
+//------------------------------------------------------------------------------
+// worker thread 를 생성한다.
+//------------------------------------------------------------------------------
+ThreadPool::ThreadPool(int num_threads) : stop_{false} {
+  if (num_threads <= 0) {
+    num_threads = static_cast<int>(std::thread::hardware_concurrency()) - 1;
+  }
+  for (int i=0; i<num_threads; i++)
+    workers_.emplace_back(&ThreadPool::work, this);
+}
+
+//------------------------------------------------------------------------------
+// 남아있는 job 을 모두 처리한 뒤 worker thread 를 종료한다.
+//------------------------------------------------------------------------------
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  cv_.notify_all();
+  for (auto& worker : workers_)
+    worker.join();
+}
+
+//------------------------------------------------------------------------------
+// 기본 pool. 처음 사용할 때 생성된다.
+//------------------------------------------------------------------------------
+ThreadPool& ThreadPool::instance() {
+  static ThreadPool pool;
+  return pool;
+}
+
+//------------------------------------------------------------------------------
+// job 의 task 를 더 이상 가져갈 것이 없을 때까지 실행한다.
+//------------------------------------------------------------------------------
+void ThreadPool::run(Job* job) {
+  for (;;) {
+    int i = job->next.fetch_add(1);
+    if (i >= job->n)
+      return;
+    (*job->fn)(i);
+    if (job->done.fetch_add(1) + 1 == job->n) {
+      std::lock_guard<std::mutex> lock(job->mutex);
+      job->cv.notify_all();
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// worker thread 의 main loop.
+//------------------------------------------------------------------------------
+void ThreadPool::work() {
+  for (;;) {
+    std::shared_ptr<Job> job;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this] { return stop_ || !jobs_.empty(); });
+      if (jobs_.empty())
+        return;
+      job = jobs_.front();
+    }
+    run(job.get());
+    // 이 job 의 task 는 모두 배분되었으므로 queue 에서 제거.
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!jobs_.empty() && jobs_.front() == job)
+      jobs_.pop_front();
+  }
+}
+
+//------------------------------------------------------------------------------
+// [0, n) task 를 병렬 실행. 호출 thread 도 task 를 처리한다.
+//------------------------------------------------------------------------------
+void ThreadPool::parallelFor(int n, const std::function<void(int)>& fn) {
+  if (n <= 0)
+    return;
+  if (n == 1 || workers_.empty()) {
+    for (int i=0; i<n; i++)
+      fn(i);
+    return;
+  }
+
+  auto job = std::make_shared<Job>(&fn, n);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    jobs_.push_back(job);
+  }
+  cv_.notify_all();
+
+  run(job.get());
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = std::find(jobs_.begin(), jobs_.end(), job);
+    if (it != jobs_.end())
+      jobs_.erase(it);
+  }
+
+  // 다른 thread 가 처리중인 task 가 끝날 때까지 대기.
+  std::unique_lock<std::mutex> lock(job->mutex);
+  job->cv.wait(lock, [&job] { return job->done.load() == job->n; });
+}
+
+}  // namespace sas
@@ -0,0 +1,58 @@
+//------------------------------------------------------------------------------
+// @file util/thread_pool.h
+//------------------------------------------------------------------------------
+#ifndef SAS_CATEGORY_UTIL_THREAD_POOL_H_
+#define SAS_CATEGORY_UTIL_THREAD_POOL_H_
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace sas {
+
+//------------------------------------------------------------------------------
+// @class ThreadPool
+//------------------------------------------------------------------------------
+// 고정 개수의 worker thread 를 유지하는 pool.
+// parallelFor() 를 호출한 thread 도 작업에 참여하므로, worker 안에서
+// 다시 parallelFor() 를 호출하더라도 deadlock 이 발생하지 않는다.
+//------------------------------------------------------------------------------
+class ThreadPool {
+ private:
+  struct Job;
+
+  std::vector<std::thread> workers_;
+  std::deque<std::shared_ptr<Job>> jobs_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool stop_;
+
+ public:
+  // num_threads 가 0 이하이면 (hardware thread 수 - 1) 개를 생성한다.
+  explicit ThreadPool(int num_threads=0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // 프로세스 전역에서 공유하는 기본 pool.
+  static ThreadPool& instance();
+
+ public:
+  // 호출 thread 를 포함한 동시 실행 가능 thread 수.
+  int concurrency() const { return static_cast<int>(workers_.size()) + 1; }
+
+  // [0, n) 구간의 task 를 병렬로 실행하고, 모두 끝날 때까지 대기한다.
+  void parallelFor(int n, const std::function<void(int)>& fn);
+
+ private:
+  void work();
+  static void run(Job* job);
+};
+
+}  // namespace sas
+#endif  // SAS_CATEGORY_UTIL_THREAD_POOL_H_